@@ -15,7 +15,9 @@
 #include <omp.h>
 
 #include "string_utils.hpp"
+#include "wacky_dictionary.hpp"
 #include "wacky_math.hpp"
+#include "wacky_sparse.hpp"
 #include "wacky_misc.hpp"
 
 
@@ -24,10 +26,10 @@ void all_count_cuda(std::string results_file,
   std::set<std::string> & VERB_TRANSITIVE,
   std::set<std::string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  std::map<std::string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   std::vector< std::vector<int> > & VERB_SBJ_OBJ,
 	std::vector< std::vector<int> > & VERB_SUBJECTS,
-  std::vector< std::vector<float> > & WORD_VECTORS);
+  SparseVectors & WORD_VECTORS);
 
 
 #endif
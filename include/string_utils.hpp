@@ -24,10 +24,13 @@
 
 #include <stdlib.h>
 #include <cstdlib>
+#include <cstring>
 #include <stddef.h>
 #include <stdint.h>
 #include <limits.h>
 
+#include <boost/utility/string_ref.hpp>
+
 #ifdef _USE_GLM
 #include <glm/glm.hpp>
 #include <glm/mat4x4.hpp>
@@ -203,6 +206,92 @@ namespace s9 {
     return found != std::string::npos && found == 0;
   }
 
+  /**
+  * Zero copy tokenising for the ukwac parsing loops. The fields are views into the
+  * line, which is a view into the mapped file, so none of them may outlive it.
+  */
+
+  typedef boost::string_ref StringRef;
+
+  /// The characters isspace gives in the C locale
+  static inline bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+  }
+
+  /// Take the next line from [pos, end), moving pos past it. Either \n or \r ends a line,
+  /// as with SplitStringNewline. Returns false once there is nothing left.
+  static inline bool NextLine(const char *& pos, const char * end, StringRef & line) {
+    if (pos >= end) { return false; }
+
+    const char * nl = static_cast<const char*>(memchr(pos, '\n', end - pos));
+    if (nl == NULL) { nl = end; }
+    const char * cr = static_cast<const char*>(memchr(pos, '\r', nl - pos));
+    if (cr != NULL) { nl = cr; }
+
+    line = StringRef(pos, nl - pos);
+    pos = nl < end ? nl + 1 : end;
+    return true;
+  }
+
+  /// Split a line on whitespace as SplitStringWhitespace does, without copying. The first
+  /// max_fields fields go into fields. Returns how many fields the line has in all.
+  static inline size_t SplitFieldsWhitespace(StringRef line, StringRef * fields, size_t max_fields) {
+    size_t count = 0;
+    const char * p = line.data();
+    const char * end = p + line.size();
+
+    while (p < end) {
+      while (p < end && IsSpace(*p)) { ++p; }
+      if (p == end) { break; }
+      const char * start = p;
+      while (p < end && !IsSpace(*p)) { ++p; }
+      if (count < max_fields) { fields[count] = StringRef(start, p - start); }
+      ++count;
+    }
+    return count;
+  }
+
+  /// Lower case into a buffer we keep reusing, so once it has grown there is no allocation
+  static inline const std::string & ToLowerInto(StringRef input, std::string & buffer) {
+    buffer.assign(input.data(), input.size());
+    for (char & c : buffer) {
+      if (c >= 'A' && c <= 'Z') { c += 'a' - 'A'; }
+    }
+    return buffer;
+  }
+
+  /// StringContains for fields
+  static inline bool FieldContains(StringRef input, StringRef contains) {
+    return input.find(contains) != StringRef::npos;
+  }
+
+  /// Read an int from the start of a field as FromString<int> does, giving 0 if there isn't one
+  static inline int ParseInt(StringRef input) {
+    const char * p = input.data();
+    const char * end = p + input.size();
+    while (p < end && IsSpace(*p)) { ++p; }
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) { negative = *p == '-'; ++p; }
+
+    long value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p) {
+      value = value * 10 + (*p - '0');
+      if (value > INT_MAX) { return negative ? INT_MIN : INT_MAX; }
+    }
+    return static_cast<int>(negative ? -value : value);
+  }
+
+  /// FNV-1a, for the hash tables keyed on words
+  static inline uint64_t HashString(StringRef input) {
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : input) {
+      h ^= static_cast<unsigned char>(c);
+      h *= 1099511628211ULL;
+    }
+    return h;
+  }
+
   /**
   * Remove a char from a string - returns a copy
   */
@@ -0,0 +1,96 @@
+/**
+* @brief Per thread logs of word vector hits, applied to WORD_VECTORS without atomics
+* @file wacky_cooccurrence.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_COOCCURRENCE_HPP
+#define WACKY_COOCCURRENCE_HPP
+
+#include <vector>
+#include <omp.h>
+
+#include "wacky_sparse.hpp"
+
+//! How many groups of rows we split WORD_VECTORS into. Each has its own lock, which for
+//! sparse counts also guards the shard of SparseCounts holding those rows.
+#define COOCCURRENCE_SHARDS SPARSE_COUNT_SHARDS
+
+//! How many hits a thread holds for one shard before applying them
+#define COOCCURRENCE_LOG_SIZE 4096
+
+//! Each thread logs the (row, slot) hits it finds into its own buffer for the shard that
+//! row lives in. A full buffer is applied to its shard under that shard's lock, so instead
+//! of an atomic per hit we take one uncontended lock per COOCCURRENCE_LOG_SIZE hits.
+//! Everything is a whole count, so the order the buffers land in never changes the result.
+//! The hits land either in dense WORD_VECTORS or, for large vocabularies, in SparseCounts.
+class CooccurrenceLog {
+public:
+  CooccurrenceLog(std::vector< std::vector<float> > & WORD_VECTORS, int num_threads) :
+      word_vectors_(&WORD_VECTORS), sparse_(NULL), num_threads_(num_threads),
+      logs_(num_threads * COOCCURRENCE_SHARDS), locks_(COOCCURRENCE_SHARDS) {
+    for (omp_lock_t & lock : locks_) { omp_init_lock(&lock); }
+  }
+
+  CooccurrenceLog(SparseCounts & counts, int num_threads) :
+      word_vectors_(NULL), sparse_(&counts), num_threads_(num_threads),
+      logs_(num_threads * COOCCURRENCE_SHARDS), locks_(COOCCURRENCE_SHARDS) {
+    for (omp_lock_t & lock : locks_) { omp_init_lock(&lock); }
+  }
+
+  ~CooccurrenceLog() {
+    flush();
+    for (omp_lock_t & lock : locks_) { omp_destroy_lock(&lock); }
+  }
+
+  CooccurrenceLog(const CooccurrenceLog &) = delete;
+  CooccurrenceLog & operator=(const CooccurrenceLog &) = delete;
+
+  //! record one hit from this thread
+  inline void add(int thread, int row, int slot) {
+    int shard = row % COOCCURRENCE_SHARDS;
+    std::vector<int> & log = logs_[thread * COOCCURRENCE_SHARDS + shard];
+    log.push_back(row);
+    log.push_back(slot);
+    if (log.size() >= 2 * COOCCURRENCE_LOG_SIZE) {
+      apply(thread, shard);
+    }
+  }
+
+  //! apply everything still held. Call from outside any parallel region.
+  void flush() {
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int shard = 0; shard < COOCCURRENCE_SHARDS; ++shard) {
+      for (int thread = 0; thread < num_threads_; ++thread) {
+        apply(thread, shard);
+      }
+    }
+  }
+
+private:
+  void apply(int thread, int shard) {
+    std::vector<int> & log = logs_[thread * COOCCURRENCE_SHARDS + shard];
+    if (log.empty()) { return; }
+
+    omp_set_lock(&locks_[shard]);
+    if (sparse_ != NULL) {
+      sparse_counts_add(*sparse_, shard, log);
+    } else {
+      for (size_t i = 0; i < log.size(); i += 2) {
+        (*word_vectors_)[log[i]][log[i+1]] += 1.0;
+      }
+    }
+    omp_unset_lock(&locks_[shard]);
+    log.clear();
+  }
+
+  std::vector< std::vector<float> > * word_vectors_;
+  SparseCounts * sparse_;
+  int num_threads_;
+  std::vector< std::vector<int> > logs_;
+  std::vector<omp_lock_t> locks_;
+};
+
+#endif
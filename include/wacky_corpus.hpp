@@ -0,0 +1,135 @@
+/**
+* @brief A pre-tokenised, memory mappable version of the ukWaC text files
+* @file wacky_corpus.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_CORPUS_HPP
+#define WACKY_CORPUS_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <vector>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem.hpp>
+
+#include "string_utils.hpp"
+#include "wacky_dictionary.hpp"
+
+//! The extension we give to converted ukWaC files
+#define CORPUS_EXTENSION ".wbc"
+
+//! Bump this whenever the layout below changes
+#define CORPUS_VERSION 1
+
+//! How many chunks per thread corpus_scan cuts a file into. More chunks even out the work
+//! between threads better; each one costs a trip to the scheduler.
+#define CORPUS_CHUNKS_PER_THREAD 16
+
+//! The smallest run of a text file corpus_parse_text hands a thread of its own
+#define CORPUS_PARSE_BLOCK (1 << 20)
+
+//! The start of every .wbc file. After it come, each 8 byte aligned:
+//! uint64 sentence starts [num_sentences + 1], uint64 string starts [num_strings + 1],
+//! int32 word, lemma, pos, id, head and deprel columns [num_tokens] and finally the string bytes.
+//! word, lemma, pos and deprel are indices into the string table, id and head are the numbers
+//! MaltParser gave the token and its head within the sentence.
+struct CorpusHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t num_tokens;
+  uint64_t num_sentences;
+  uint64_t num_strings;
+  uint64_t string_bytes;
+};
+
+//! A mapped .wbc file. A sentence s covers the tokens [sentences[s], sentences[s+1]).
+struct Corpus {
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+
+  const CorpusHeader * header;
+  const uint64_t * sentences;
+  const uint64_t * strings;
+  const int32_t * word;
+  const int32_t * lemma;
+  const int32_t * pos;
+  const int32_t * id;
+  const int32_t * head;
+  const int32_t * deprel;
+  const char * string_data;
+};
+
+//! A ukwac text file parsed into the same columns, held in memory rather than mapped
+struct CorpusData {
+  CorpusHeader header;
+  std::vector<uint64_t> sentences;
+  std::vector<uint64_t> strings;
+  std::vector<int32_t> cols[6];
+  std::string string_data;
+};
+
+//! Something that wants to see every sentence of the corpus. begin_file and end_file are
+//! called from one thread; sentence is called from many threads at once. Each file is cut
+//! into corpus_scan_chunks() chunks, and each chunk is handed to one thread as an unbroken
+//! run of sentences in file order, so a consumer can keep per chunk state as well as per thread.
+class SentenceConsumer {
+public:
+  virtual ~SentenceConsumer() {}
+  virtual int begin_file(const Corpus & corpus, const std::string & name) { return 0; }
+  virtual void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) = 0;
+  virtual int end_file(const Corpus & corpus) { return 0; }
+};
+
+//! is this path one of our converted files?
+bool corpus_file(const std::string & path);
+
+//! list the converted files in a directory
+std::vector<std::string> corpus_filenames(std::string CORPUS_DIR);
+
+//! convert a set of ukwac files into our binary format
+int create_corpus(std::vector<std::string> filenames, std::string CORPUS_DIR);
+
+//! convert a single ukwac file
+int create_corpus_file(std::string filepath, std::string outpath);
+
+//! map a converted file into memory
+int corpus_open(Corpus & corpus, std::string path);
+
+//! parse a ukwac text file into memory
+int corpus_parse_text(std::string filepath, CorpusData & data, size_t block_bytes = CORPUS_PARSE_BLOCK);
+
+//! point a Corpus at parsed data
+void corpus_view(const CorpusData & data, Corpus & corpus);
+
+//! read each file once, handing every sentence to all the consumers
+int corpus_scan(std::vector<std::string> filenames, std::vector<SentenceConsumer*> & consumers);
+
+//! how many chunks corpus_scan cuts each file into
+size_t corpus_scan_chunks();
+
+//! cut the sentences into num_chunks runs of about the same number of tokens
+std::vector<uint64_t> corpus_chunks(const Corpus & corpus, size_t num_chunks);
+
+//! the text of one string in the table
+std::string corpus_string(const Corpus & corpus, int32_t idx);
+
+//! lower case every string in the table and look it up in the dictionary
+std::vector<int> corpus_dictionary_lookup(const Corpus & corpus,
+    Dictionary & DICTIONARY_FAST,
+    int missing);
+
+//! does each string in the table contain a given substring
+std::vector<char> corpus_contains(const Corpus & corpus, const std::string & contains);
+
+//! the name of the ukwac file a converted file came from
+std::string corpus_source_name(const std::string & path);
+
+#endif
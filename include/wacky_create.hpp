@@ -15,6 +15,7 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <memory>
 
 #include <omp.h>
 
@@ -25,6 +26,13 @@
 
 #include "string_utils.hpp"
 #include "wacky_misc.hpp"
+#include "wacky_corpus.hpp"
+#include "wacky_cooccurrence.hpp"
+#include "wacky_freq.hpp"
+#include "wacky_vector_file.hpp"
+#include "wacky_integers.hpp"
+#include "wacky_output.hpp"
+#include "wacky_stats.hpp"
 
 std::vector<std::string>::iterator find_in_dictionary(std::vector<std::string> & DICTIONARY, std::string s);
 
@@ -32,7 +40,7 @@ std::vector<std::string>::iterator find_in_dictionary(std::vector<std::string> &
 int create_dictionary(std::string OUTPUT_DIR,
     std::map<std::string, size_t> & FREQ, 
     std::vector< std::pair<std::string,size_t> > & FREQ_FLIPPED,
-    std::map<std::string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     std::vector<std::string> & DICTIONARY,
     size_t & VOCAB_SIZE);
 
@@ -40,7 +48,7 @@ int create_dictionary(std::string OUTPUT_DIR,
 void create_basis(std::string OUTPUT_DIR,
     std::map<std::string, size_t> & FREQ, 
     std::vector< std::pair<std::string,size_t> > & FREQ_FLIPPED,
-    std::map<std::string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     std::vector<int> & BASIS_VECTOR,
     std::set<std::string> & ALLOWED_BASIS_WORDS,
     std::set<std::string> & INSIST_WORDS,
@@ -54,14 +62,15 @@ int create_freq(std::vector<std::string> filenames,
     std::vector< std::pair<std::string,size_t> > & FREQ_FLIPPED,
     std::set<std::string> & WORD_IGNORES,
     std::set<std::string> & ALLOWED_BASIS_WORDS,
-    bool LEMMA_TIME);
+    bool LEMMA_TIME,
+    size_t FREQ_CAPACITY = 0);
 
 //! create our word vectors for later testing
 int create_word_vectors(std::vector<std::string> filenames,
     std::string OUTPUT_DIR,
     std::map<std::string, size_t> & FREQ, 
     std::vector< std::pair<std::string,size_t> > & FREQ_FLIPPED,
-    std::map<std::string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     std::vector<std::string> & DICTIONARY,
     std::vector<int> & BASIS_VECTOR,
     std::set<std::string> & WORD_IGNORES,
@@ -70,13 +79,134 @@ int create_word_vectors(std::vector<std::string> filenames,
     size_t VOCAB_SIZE,
     size_t BASIS_SIZE,
     size_t WINDOW_SIZE,
-    bool LEMMA_TIME);
+    bool LEMMA_TIME,
+    bool SPARSE = false,
+    const std::set<int> * TARGET_WORDS = NULL);
+
+//! map each dictionary index to its slot in the basis, or -1
+std::vector<int> create_basis_slots(const std::vector<int> & BASIS_VECTOR,
+    size_t BASIS_SIZE,
+    size_t VOCAB_SIZE);
+
+//! add the window counts for one sentence to the word vectors
+void count_sentence(const std::vector<int> & sentence,
+    const std::vector<int> & BASIS_SLOTS,
+    CooccurrenceLog & log,
+    int thread,
+    size_t WINDOW_SIZE,
+    std::vector<int> & slots,
+    const std::vector<char> * TARGET_ROWS = NULL);
+
+//! flag the rows of the target words, VOCAB_SIZE + 1 long
+std::vector<char> create_target_rows(const std::set<int> & TARGET_WORDS, size_t VOCAB_SIZE);
+
+//! zero the word vectors, one row per dictionary word plus UNK
+void init_word_vectors(std::vector< std::vector<float> > & WORD_VECTORS,
+    size_t VOCAB_SIZE,
+    size_t BASIS_SIZE,
+    const std::set<int> * TARGET_WORDS = NULL);
+
+//! write the word vectors to word_vectors.txt, and which rows were counted if it was targeted
+int write_word_vectors(std::string OUTPUT_DIR,
+    std::vector< std::vector<float> > & WORD_VECTORS,
+    const std::set<int> * TARGET_WORDS = NULL);
+
+//! write sparse word vectors to word_vectors.txt, and which rows were counted if it was targeted
+int write_word_vectors(std::string OUTPUT_DIR,
+    const SparseVectors & WORD_VECTORS,
+    const std::set<int> * TARGET_WORDS = NULL);
+
+//! the word vector window counts, as a pipeline stage
+class CooccurrenceCounter : public SentenceConsumer {
+public:
+  CooccurrenceCounter(Dictionary & DICTIONARY_FAST,
+      std::vector<int> & BASIS_VECTOR,
+      std::vector< std::vector<float> > & WORD_VECTORS,
+      size_t VOCAB_SIZE,
+      size_t BASIS_SIZE,
+      size_t WINDOW_SIZE,
+      bool LEMMA_TIME,
+      SparseCounts * SPARSE_COUNTS = NULL,
+      const std::set<int> * TARGET_WORDS = NULL);
+
+  int begin_file(const Corpus & corpus, const std::string & name) override;
+  void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) override;
+  int end_file(const Corpus & corpus) override;
+
+private:
+  Dictionary & dictionary_;
+  std::vector<int> & basis_;
+  std::vector< std::vector<float> > & word_vectors_;
+  size_t vocab_size_;
+  size_t basis_size_;
+  size_t window_size_;
+  bool lemma_time_;
+  SparseCounts * sparse_counts_;
+  const std::set<int> * target_words_;
+  std::vector<char> targets_;
+  const int32_t * col_;
+  std::vector<int> slots_;
+  std::vector<int> lookup_;
+  std::vector< std::vector<int> > scratch_;
+  std::vector< std::vector<int> > slot_scratch_;
+  std::unique_ptr<CooccurrenceLog> log_;
+};
+
+//! the word frequencies, as a pipeline stage. Each thread counts its sentences into its own
+//! FreqCounter, bounded at the capacity if there is one.
+class FrequencyCounter : public SentenceConsumer {
+public:
+  FrequencyCounter(std::set<std::string> & WORD_IGNORES,
+      bool LEMMA_TIME,
+      size_t FREQ_CAPACITY = 0);
+
+  int begin_file(const Corpus & corpus, const std::string & name) override;
+  void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) override;
+  int end_file(const Corpus & corpus) override;
+
+  //! the per thread counts, to be merged
+  const std::vector<FreqCounter> & counters() const { return counters_; }
+
+private:
+  std::set<std::string> & ignores_;
+  bool lemma_time_;
+  const int32_t * col_;
+  uint64_t base_;
+  std::vector<std::string> vals_;
+  std::vector<char> counted_;
+  std::vector<char> allowed_;
+  std::vector<FreqCounter> counters_;
+};
+
+//! the integers and size files, as a pipeline stage
+class IntegerWriter : public SentenceConsumer {
+public:
+  IntegerWriter(std::string OUTPUT_DIR,
+      std::set<std::string> & WORD_IGNORES,
+      Dictionary & DICTIONARY_FAST,
+      size_t VOCAB_SIZE,
+      bool LEMMA_TIME);
+
+  int begin_file(const Corpus & corpus, const std::string & name) override;
+  void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) override;
+  int end_file(const Corpus & corpus) override;
+
+private:
+  std::string output_dir_;
+  std::set<std::string> & ignores_;
+  Dictionary & dictionary_;
+  size_t vocab_size_;
+  bool lemma_time_;
+  const int32_t * col_;
+  std::vector<int> lookup_;
+  IntegerFile file_;
+};
 
 //! create files of numbers for the tensorflow version
 int create_integers(std::vector<std::string> filenames,
     std::string OUTPUT_DIR, 
     std::set<std::string> & WORD_IGNORES,
-    std::map<std::string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     size_t VOCAB_SIZE,
     bool LEMMA_TIME);
 
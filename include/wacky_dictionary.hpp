@@ -0,0 +1,103 @@
+/**
+* @brief The word to id lookup every pass uses, with all the words in one arena
+* @file wacky_dictionary.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_DICTIONARY_HPP
+#define WACKY_DICTIONARY_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "string_utils.hpp"
+
+//! Maps words to their ids in dictionary.txt and back. The words sit end to end in a single
+//! arena and the index is an open addressing table of (hash, id) pairs, kept at most half full,
+//! so a lookup is one hash and usually one compare. Lookups take a StringRef, so a field of the
+//! mapped file or a reused buffer can be looked up without making a std::string.
+class Dictionary {
+public:
+  Dictionary() : slots_(16, Slot{0, -1}), offsets_(1, 0) {}
+
+  //! the id of a word, or -1 if it is not in the dictionary
+  inline int find(s9::StringRef word) const {
+    uint64_t h = s9::HashString(word);
+    uint32_t tag = static_cast<uint32_t>(h >> 32);
+    size_t mask = slots_.size() - 1;
+
+    for (size_t i = h & mask; ; i = (i + 1) & mask) {
+      const Slot & s = slots_[i];
+      if (s.id < 0) { return -1; }
+      if (s.tag == tag && this->word(s.id) == word) { return s.id; }
+    }
+  }
+
+  //! the id of a word, or 0 if it is missing, which is what looking up the std::map this
+  //! replaced with [] gave
+  inline int operator[](s9::StringRef word) const {
+    int id = find(word);
+    return id < 0 ? 0 : id;
+  }
+
+  //! add a word with the next id, returning it. A word we already have keeps its old id.
+  int insert(s9::StringRef word) {
+    int id = find(word);
+    if (id >= 0) { return id; }
+
+    id = static_cast<int>(size());
+    arena_.append(word.data(), word.size());
+    offsets_.push_back(arena_.size());
+
+    if ((size() + 1) * 2 > slots_.size()) {
+      rehash(slots_.size() * 2);
+    } else {
+      place(s9::HashString(word), id);
+    }
+    return id;
+  }
+
+  //! the word with this id
+  inline s9::StringRef word(int id) const {
+    return s9::StringRef(arena_.data() + offsets_[id], offsets_[id + 1] - offsets_[id]);
+  }
+
+  inline size_t size() const { return offsets_.size() - 1; }
+
+  void clear() {
+    slots_.assign(16, Slot{0, -1});
+    offsets_.assign(1, 0);
+    arena_.clear();
+  }
+
+private:
+  struct Slot {
+    uint32_t tag;
+    int32_t id;
+  };
+
+  void place(uint64_t h, int id) {
+    size_t mask = slots_.size() - 1;
+    size_t i = h & mask;
+    while (slots_[i].id >= 0) { i = (i + 1) & mask; }
+    slots_[i].tag = static_cast<uint32_t>(h >> 32);
+    slots_[i].id = id;
+  }
+
+  void rehash(size_t num_slots) {
+    slots_.assign(num_slots, Slot{0, -1});
+    for (size_t id = 0; id < size(); ++id) {
+      place(s9::HashString(word(id)), id);
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::vector<uint64_t> offsets_;
+  std::string arena_;
+};
+
+#endif
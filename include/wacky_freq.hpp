@@ -0,0 +1,183 @@
+/**
+* @brief Per thread word counts that merge to the same result whatever the number of threads
+* @file wacky_freq.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_FREQ_HPP
+#define WACKY_FREQ_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "string_utils.hpp"
+
+//! How many slots a new FreqCounter starts with. Always a power of two.
+#define FREQ_COUNTER_SLOTS 4096
+
+//! Counts words in an open addressing hash table. Each word is copied into an arena the first
+//! time we see it, so counting a word we already have costs a hash and a compare. Alongside the
+//! count we keep the earliest position the word was seen at and whether that occurrence had a
+//! basis tag, so merging counters from any number of threads always gives the same answer.
+//!
+//! Given a capacity the counter is bounded, after Space-Saving. Once it holds twice capacity
+//! words it keeps the capacity most frequent and raises its floor to the highest count it
+//! dropped. A word that comes in later starts at the floor, since it may have been one of the
+//! dropped, and carries the floor as its error. So every count is an upper bound, count - error
+//! is a lower bound, and any word seen more than floor() times is still held.
+class FreqCounter {
+public:
+  struct Entry {
+    uint64_t hash;
+    size_t offset;
+    size_t length;
+    size_t count;
+    size_t error;
+    uint64_t first;
+    bool allowed;
+  };
+
+  explicit FreqCounter(size_t capacity = 0) :
+    slots_(FREQ_COUNTER_SLOTS, -1), capacity_(capacity), floor_(0), total_(0) {}
+
+  //! count one occurrence of a word at a position in the file
+  inline void add(s9::StringRef word, uint64_t position, bool allowed) {
+    add(word, s9::HashString(word), 1, 0, position, allowed);
+    total_++;
+  }
+
+  //! add count occurrences of a word, up to error of them perhaps not real, the earliest at first.
+  //! A word we don't hold starts from the floor.
+  void add(s9::StringRef word, uint64_t h, size_t count, size_t error, uint64_t first, bool allowed) {
+    size_t mask = slots_.size() - 1;
+    for (size_t i = h & mask; ; i = (i + 1) & mask) {
+      int32_t e = slots_[i];
+      if (e < 0) {
+        Entry entry = { h, arena_.size(), word.size(), floor_ + count, floor_ + error, first, allowed };
+        arena_.append(word.data(), word.size());
+        slots_[i] = static_cast<int32_t>(entries_.size());
+        entries_.push_back(entry);
+        if (entries_.size() * 2 > slots_.size()) { grow(); }
+        if (capacity_ > 0 && entries_.size() >= 2 * capacity_) { prune(); }
+        return;
+      }
+
+      Entry & entry = entries_[e];
+      if (entry.hash == h && entry.length == word.size() &&
+          memcmp(arena_.data() + entry.offset, word.data(), word.size()) == 0) {
+        entry.count += count;
+        entry.error += error;
+        if (first < entry.first) {
+          entry.first = first;
+          entry.allowed = allowed;
+        }
+        return;
+      }
+    }
+  }
+
+  //! add the entries of another counter whose hash falls in one of num_parts partitions. Floors
+  //! are not carried over, so this is only for counters that never dropped a word.
+  void merge(const FreqCounter & other, size_t part, size_t num_parts) {
+    for (const Entry & e : other.entries_) {
+      if ((e.hash >> 32) % num_parts == part) {
+        add(other.word(e), e.hash, e.count, e.error, e.first, e.allowed);
+      }
+    }
+  }
+
+  //! add all of another counter. A word it doesn't hold may have been seen there up to its
+  //! floor times, so the words only we hold take that floor on as count and error. The sums
+  //! wrap while we go but every count and error comes out right.
+  void merge(const FreqCounter & other) {
+    for (Entry & e : entries_) {
+      e.count += other.floor_;
+      e.error += other.floor_;
+    }
+    floor_ += other.floor_;
+    total_ += other.total_;
+    for (const Entry & e : other.entries_) {
+      add(other.word(e), e.hash, e.count - other.floor_, e.error - other.floor_, e.first, e.allowed);
+    }
+  }
+
+  const std::vector<Entry> & entries() const { return entries_; }
+
+  //! the word an entry counts
+  s9::StringRef word(const Entry & e) const { return s9::StringRef(arena_.data() + e.offset, e.length); }
+
+  //! how many occurrences we were given, dropped words and all
+  inline uint64_t total() const { return total_; }
+
+  //! no word we dropped was seen more often than this
+  inline size_t floor() const { return floor_; }
+
+  //! drop all but the capacity most frequent words, if we hold more
+  void shrink() {
+    if (capacity_ > 0 && entries_.size() > capacity_) { prune(); }
+  }
+
+private:
+  //! more frequent first, then by hash and word so the same words always survive
+  inline bool before(const Entry & a, const Entry & b) const {
+    if (a.count != b.count) { return a.count > b.count; }
+    if (a.hash != b.hash) { return a.hash < b.hash; }
+    return word(a) < word(b);
+  }
+
+  void prune() {
+    std::vector<size_t> order (entries_.size());
+    for (size_t e = 0; e < order.size(); ++e) { order[e] = e; }
+    std::nth_element(order.begin(), order.begin() + capacity_, order.end(),
+        [this](size_t a, size_t b) { return before(entries_[a], entries_[b]); });
+
+    for (size_t k = capacity_; k < order.size(); ++k) {
+      floor_ = std::max(floor_, entries_[order[k]].count);
+    }
+
+    // Keep the survivors in the order they arrived and copy their words to a fresh arena
+    order.resize(capacity_);
+    std::sort(order.begin(), order.end());
+    std::vector<Entry> kept;
+    std::string arena;
+    kept.reserve(capacity_ * 2);
+    for (size_t e : order) {
+      Entry entry = entries_[e];
+      entry.offset = arena.size();
+      arena.append(arena_.data() + entries_[e].offset, entry.length);
+      kept.push_back(entry);
+    }
+    entries_.swap(kept);
+    arena_.swap(arena);
+    rehash();
+  }
+
+  void grow() {
+    slots_.resize(slots_.size() * 2);
+    rehash();
+  }
+
+  void rehash() {
+    slots_.assign(slots_.size(), -1);
+    size_t mask = slots_.size() - 1;
+    for (size_t e = 0; e < entries_.size(); ++e) {
+      size_t i = entries_[e].hash & mask;
+      while (slots_[i] >= 0) { i = (i + 1) & mask; }
+      slots_[i] = static_cast<int32_t>(e);
+    }
+  }
+
+  std::vector<int32_t> slots_;
+  std::vector<Entry> entries_;
+  std::string arena_;
+  size_t capacity_;
+  size_t floor_;
+  uint64_t total_;
+};
+
+#endif
@@ -0,0 +1,70 @@
+/**
+* @brief The corpus as binary dictionary indices, for Tensorflow
+* @file wacky_integers.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_INTEGERS_HPP
+#define WACKY_INTEGERS_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+//! The extension of a file's token stream: little endian uint32 dictionary indices and
+//! nothing else, so numpy can memmap it as '<u4'
+#define INTEGER_DATA_EXTENSION ".bin"
+
+//! The extension of a file's index, an IntegerIndexHeader then uint64 sentence starts
+//! [num_sentences + 1] into the token stream
+#define INTEGER_INDEX_EXTENSION ".idx"
+
+//! Bump this whenever the layout of the index changes
+#define INTEGER_FILE_VERSION 1
+
+//! The start of every .idx file
+struct IntegerIndexHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t num_tokens;
+  uint64_t num_known;
+  uint64_t num_sentences;
+};
+
+//! Writes the integers_<file> token stream for one ukwac file and the index beside it. Where
+//! each sentence starts is known before any token is written, so the stream is sized once and
+//! mapped, and any thread can write any sentence straight to its place. Empty sentences are
+//! dropped from the index.
+class IntegerFile {
+public:
+  IntegerFile() : data_(nullptr), num_known_(0) {}
+
+  //! create path_base + INTEGER_DATA_EXTENSION, sentence s going at starts[s], and map it
+  int open(std::string path_base, std::vector<uint64_t> & starts, uint64_t num_known);
+
+  //! where the tokens of sentence s go
+  inline uint32_t * sentence(size_t s) { return data_ + starts_[s]; }
+
+  //! unmap the stream and write the index
+  int close();
+
+private:
+  std::string path_base_;
+  boost::interprocess::file_mapping file_;
+  boost::interprocess::mapped_region region_;
+  uint32_t * data_;
+  std::vector<uint64_t> starts_;
+  uint64_t num_known_;
+};
+
+//! read a file's index back
+int integer_index_read(std::string path, IntegerIndexHeader & header, std::vector<uint64_t> & sentences);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+* @brief Kronecker sums kept as their rank-1 factors so we never build BASIS_SIZE^2 tensors
+* @file wacky_kron.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_KRON_HPP
+#define WACKY_KRON_HPP
+
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "wacky_workspace.hpp"
+#include "wacky_sparse.hpp"
+
+#ifdef _USE_MKL
+#include "mkl.h"
+#endif
+
+//! A weighted sum of Kronecker products, sum_i weight_i * (left_i (x) right_i), held as factors.
+//! Factors are indices into the sparse word vectors. Negative indices -(r+1) point at row r of
+//! extra, which holds any vectors that are not word vectors (the verb itself, a row of ones etc).
+//! If scale is set, every factor is multiplied elementwise by it, which is the same as taking
+//! the Hadamard product of the whole sum with scale (x) scale.
+struct KronSum {
+  int basis;
+  const SparseVectors * rows;
+  std::vector<int> left;
+  std::vector<int> right;
+  std::vector<float> weight;
+  std::vector<float> extra;
+  std::vector<float> scale;
+};
+
+//! copy one of the factor rows of a KronSum into basis floats, negative indices being the extra rows
+inline void krn_row(const KronSum & k, int r, float * out) {
+  if (r < 0) {
+    const float * src = &k.extra[ static_cast<size_t>(-r - 1) * k.basis ];
+    std::copy(src, src + k.basis, out);
+    return;
+  }
+  std::fill(out, out + k.basis, 0.0f);
+  for (size_t m = k.rows->row_ptr[r]; m < k.rows->row_ptr[r+1]; ++m) {
+    out[k.rows->col_idx[m]] = k.rows->vals[m];
+  }
+}
+
+//! empty a KronSum and point it at a set of word vectors
+void krn_sum_init(KronSum & k, const SparseVectors & rows, int basis);
+
+//! add a term made from two word vector rows
+void krn_sum_add(KronSum & k, int left, int right, float weight);
+
+//! add a term made from two arbitrary vectors of length basis
+void krn_sum_add(KronSum & k, const float * left, const float * right, float weight);
+
+//! r becomes k (o) (v (x) v)
+void krn_sum_hadamard(KronSum & r, const KronSum & k, const float * v);
+
+//! write out the dense basis x basis tensor this sum represents. Its tiles come from work if given.
+void krn_sum_dense(const KronSum & k, float * out, Workspace * work = nullptr);
+
+//! how many floats the packed upper triangle of a symmetric basis x basis tensor takes
+inline size_t krn_packed_size(int basis) { return (static_cast<size_t>(basis) * (basis + 1)) / 2; }
+
+//! write out the upper triangle of a sum of self products, row by row, as basis rows shrinking
+//! by one. Its tiles come from work if given.
+void krn_sum_packed(const KronSum & k, float * out, Workspace * work = nullptr);
+
+//! write out the upper triangle of v (x) v the same way
+void krn_packed_self(const float * v, int basis, float * out);
+
+//! the same similarity as cosine_sim on the full symmetric tensors two packed triangles stand for
+float krn_packed_cosine_sim(const float * p0, const float * p1, int basis);
+
+//! how much Workspace krn_sum_packed needs
+size_t krn_packed_workspace_floats(int basis);
+
+//! how much Workspace krn_sum_dot needs, whichever path it takes
+size_t krn_workspace_floats(int basis);
+
+//! the inner product of the two dense tensors these sums represent. Its tiles come from work if given.
+double krn_sum_dot(const KronSum & k0, const KronSum & k1, Workspace * work = nullptr);
+
+//! the same similarity as cosine_sim on the dense tensors, without building them
+float krn_cosine_sim(const KronSum & k0, const KronSum & k1);
+
+//! as above but with the squared lengths of k0 and k1 already worked out
+float krn_cosine_sim(const KronSum & k0, const KronSum & k1, double l0, double l1, Workspace * work = nullptr);
+
+#endif
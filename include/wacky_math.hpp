@@ -30,6 +30,7 @@
 void mul_vec_slow( std::vector<float> & v0, std::vector<float> & v, std::vector<float> &r);
 void krn_mul( std::vector<float> & a, std::vector<float> & b, std::vector<float> &r);
 float cosine_sim(std::vector<float> & v0, std::vector<float> & v1, int size);
+float cosine_sim(const float * v0, const float * v1, int size);
 #else
 boost::numeric::ublas::vector<float> mul_vec( boost::numeric::ublas::vector<float> & v0, boost::numeric::ublas::vector<float> & v1);
 boost::numeric::ublas::vector<float> krn_mul( boost::numeric::ublas::vector<float> & a, boost::numeric::ublas::vector<float> & b);
@@ -10,12 +10,19 @@
 #define WACKY_MISC_HPP
 
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <omp.h>
 #include <boost/interprocess/file_mapping.hpp>
 #include <boost/interprocess/mapped_region.hpp>
 #include <boost/interprocess/managed_mapped_file.hpp>
 
+#include "string_utils.hpp"
+
+//! The first line of verb_subjects.txt, verb_objects.txt and verb_sbj_obj.txt, followed by a
+//! space and how many numbers make up each entry. Files without it hold unweighted entries.
+#define VERB_LIST_HEADER "#wacky verb list 2"
+
 //! represents two verbs to compare and their human ranking
 struct VerbPair {
   std::string v0;
@@ -24,10 +31,23 @@ struct VerbPair {
 };
 
 //! sort our frequency file
-inline bool sort_freq (std::pair<std::string,size_t> i, std::pair<std::string, size_t> j) { return (i.second > j.second); }
+inline bool sort_freq (const std::pair<std::string,size_t> & i, const std::pair<std::string, size_t> & j) {
+  // Ties go alphabetically so the order is the same however we sort
+  return i.second != j.second ? i.second > j.second : i.first < j.first;
+}
+
+//! round a byte count up to the next multiple of 8, which every section of our binary files starts on
+inline size_t pad8(size_t n) {
+  return (n + 7) & ~static_cast<size_t>(7);
+}
 
-//! breakup the ukwac into managable chunks
-int breakup ( char ** & block_pointer, size_t * & block_size, boost::interprocess::file_mapping &m_file, boost::interprocess::mapped_region &region, int & num_blocks);
+//! write out a block of bytes padded with zeroes to 8 bytes. With data NULL only the padding
+//! is written, for a section whose bytes have already gone out piece by piece.
+inline void write_padded(std::ofstream & out, const void * data, size_t size) {
+  static const char zeroes[8] = {0,0,0,0,0,0,0,0};
+  if (data != NULL && size > 0) { out.write(static_cast<const char*>(data), size); }
+  out.write(zeroes, pad8(size) - size);
+}
 
 #endif
 
@@ -0,0 +1,209 @@
+/**
+* @brief Buffered text output for the count, dictionary and results files
+* @file wacky_output.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_OUTPUT_HPP
+#define WACKY_OUTPUT_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <omp.h>
+
+#include "string_utils.hpp"
+
+//! How much a TextFile holds before it writes
+#define TEXT_FILE_BUFFER (1 << 22)
+
+//! How many rows each thread formats at a time in text_file_write_rows
+#define TEXT_FILE_ROWS_PER_PART 1024
+
+//! Text built up in memory. Numbers are written straight into the buffer with no stream in
+//! the way; floats come out as ostream would print them, so the files do not change.
+class TextBuffer {
+public:
+  TextBuffer & operator<<(s9::StringRef s) { buf_.append(s.data(), s.size()); return *this; }
+  TextBuffer & operator<<(const std::string & s) { buf_.append(s); return *this; }
+  TextBuffer & operator<<(const char * s) { buf_.append(s); return *this; }
+  TextBuffer & operator<<(char c) { buf_.push_back(c); return *this; }
+
+  TextBuffer & operator<<(int v) { return put_signed(v); }
+  TextBuffer & operator<<(long v) { return put_signed(v); }
+  TextBuffer & operator<<(long long v) { return put_signed(v); }
+  TextBuffer & operator<<(unsigned v) { return put_unsigned(v); }
+  TextBuffer & operator<<(unsigned long v) { return put_unsigned(v); }
+  TextBuffer & operator<<(unsigned long long v) { return put_unsigned(v); }
+
+  TextBuffer & operator<<(float v) { return put_float(v); }
+  TextBuffer & operator<<(double v) { return put_float(v); }
+
+  inline size_t size() const { return buf_.size(); }
+  inline bool empty() const { return buf_.empty(); }
+  inline void clear() { buf_.clear(); }
+  inline void reserve(size_t n) { buf_.reserve(n); }
+  inline std::string & str() { return buf_; }
+  inline const std::string & str() const { return buf_; }
+
+private:
+  TextBuffer & put_unsigned(unsigned long long v) {
+    char tmp[20];
+    char * p = tmp + sizeof(tmp);
+    do {
+      *--p = static_cast<char>('0' + v % 10);
+      v /= 10;
+    } while (v != 0);
+    buf_.append(p, tmp + sizeof(tmp) - p);
+    return *this;
+  }
+
+  TextBuffer & put_signed(long long v) {
+    if (v < 0) {
+      buf_.push_back('-');
+      return put_unsigned(0ULL - static_cast<unsigned long long>(v));
+    }
+    return put_unsigned(v);
+  }
+
+  // %g at the default precision of 6 is what ostream uses for a float or a double
+  TextBuffer & put_float(double v) {
+    char tmp[32];
+    int n = snprintf(tmp, sizeof(tmp), "%g", v);
+    buf_.append(tmp, n);
+    return *this;
+  }
+
+  std::string buf_;
+};
+
+//! A file written TEXT_FILE_BUFFER at a time. Only one thread may write to it at once.
+class TextFile {
+public:
+  TextFile() : file_(NULL) {}
+  ~TextFile() { close(); }
+
+  bool open(const std::string & path) {
+    close();
+    file_ = fopen(path.c_str(), "wb");
+    if (file_ != NULL) { buffer_.reserve(TEXT_FILE_BUFFER); }
+    return file_ != NULL;
+  }
+
+  inline bool is_open() const { return file_ != NULL; }
+
+  template<class T> TextFile & operator<<(const T & t) {
+    buffer_ << t;
+    if (buffer_.size() >= TEXT_FILE_BUFFER) { flush(); }
+    return *this;
+  }
+
+  //! append text that was formatted elsewhere
+  void write(const TextBuffer & text) {
+    if (buffer_.size() + text.size() >= TEXT_FILE_BUFFER) {
+      flush();
+      if (text.size() >= TEXT_FILE_BUFFER) {
+        if (file_ != NULL) { fwrite(text.str().data(), 1, text.size(), file_); }
+        return;
+      }
+    }
+    buffer_ << text.str();
+  }
+
+  void flush() {
+    if (file_ != NULL && !buffer_.empty()) { fwrite(buffer_.str().data(), 1, buffer_.size(), file_); }
+    buffer_.clear();
+  }
+
+  void close() {
+    flush();
+    if (file_ != NULL) { fclose(file_); }
+    file_ = NULL;
+  }
+
+private:
+  FILE * file_;
+  TextBuffer buffer_;
+};
+
+//! The rows of a results file from a parallel loop, written in loop order. Every iteration
+//! hands over its row, or skips it. Whichever thread wins the drain flag writes out the rows
+//! that are finished from the front, so no thread waits on a lock and the file still grows
+//! as the loop runs.
+class ResultRows {
+public:
+  ResultRows(TextFile & out, size_t num_rows) :
+    out_(out), rows_(num_rows), ready_(new std::atomic<bool>[num_rows]), next_(0), draining_(false) {
+    for (size_t i = 0; i < num_rows; ++i) { ready_[i].store(false, std::memory_order_relaxed); }
+  }
+
+  //! row i is done. The text is taken from row, which is left empty.
+  void set(size_t i, TextBuffer & row) {
+    rows_[i].swap(row.str());
+    row.clear();
+    ready_[i].store(true, std::memory_order_release);
+    drain();
+  }
+
+  //! row i has nothing to write
+  void skip(size_t i) {
+    ready_[i].store(true, std::memory_order_release);
+    drain();
+  }
+
+  //! write whatever is left. Call once the loop is over.
+  void finish() {
+    drain();
+    out_.flush();
+  }
+
+private:
+  void drain() {
+    while (!draining_.exchange(true, std::memory_order_acquire)) {
+      while (next_ < rows_.size() && ready_[next_].load(std::memory_order_acquire)) {
+        out_ << rows_[next_];
+        std::string().swap(rows_[next_]);
+        ++next_;
+      }
+      size_t next = next_;
+      draining_.store(false, std::memory_order_release);
+
+      // A row may have landed after we looked but before we let go of the flag
+      if (next >= rows_.size() || !ready_[next].load(std::memory_order_acquire)) { return; }
+    }
+  }
+
+  TextFile & out_;
+  std::vector<std::string> rows_;
+  std::unique_ptr<std::atomic<bool>[]> ready_;
+  size_t next_;
+  std::atomic<bool> draining_;
+};
+
+//! Format num_rows rows with format(row, buffer) on all threads, each taking
+//! TEXT_FILE_ROWS_PER_PART rows into its own buffer, and write them to out in order
+template<class Format> void text_file_write_rows(TextFile & out, size_t num_rows, Format format) {
+  size_t num_parts = omp_get_max_threads();
+  std::vector<TextBuffer> parts (num_parts);
+
+  for (size_t start = 0; start < num_rows; start += num_parts * TEXT_FILE_ROWS_PER_PART) {
+    #pragma omp parallel for schedule(static, 1)
+    for (size_t p = 0; p < num_parts; ++p) {
+      parts[p].clear();
+      size_t begin = start + p * TEXT_FILE_ROWS_PER_PART;
+      size_t end = std::min(num_rows, begin + TEXT_FILE_ROWS_PER_PART);
+      for (size_t r = begin; r < end; ++r) { format(r, parts[p]); }
+    }
+
+    for (const TextBuffer & part : parts) { out.write(part); }
+  }
+}
+
+#endif
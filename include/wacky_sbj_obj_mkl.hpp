@@ -20,19 +20,28 @@
 #include "mkl_vml.h"
 
 #include "string_utils.hpp"
+#include "wacky_dictionary.hpp"
 #include "wacky_math.hpp"
+#include "wacky_sparse.hpp"
+#include "wacky_kron.hpp"
+#include "wacky_sketch.hpp"
+#include "wacky_verb_cache.hpp"
 #include "wacky_misc.hpp"
+#include "wacky_output.hpp"
+#include "wacky_stats.hpp"
 
 //! given a verb, peform the statistics on its subjects
-void read_subjects(std::string verb, std::map<std::string,int> & DICTIONARY_FAST,
+void read_subjects(std::string verb, Dictionary & DICTIONARY_FAST,
     std::vector< std::vector<int> > & VERB_SUBJECTS,
-    std::vector< std::vector<float> > & WORD_VECTORS,
+    SparseVectors & WORD_VECTORS,
     int BASIS_SIZE,
     std::vector<float> & base_vector,
     std::vector<float> & add_vector,
     std::vector<float> & min_vector,
     std::vector<float> & max_vector,
-    std::vector<float> & krn_vector);
+    std::vector<float> & krn_vector,
+    KronSum & krn_sum,
+    Workspace * work = nullptr);
 
 //! return all the intranstive stats
 void intrans_count( std::string results_file,
@@ -40,9 +49,11 @@ void intrans_count( std::string results_file,
   std::set<std::string> & VERB_TRANSITIVE,
   std::set<std::string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  std::map<std::string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   std::vector< std::vector<int> > & VERB_SUBJECTS,
-  std::vector< std::vector<float> > & WORD_VECTORS);
+  SparseVectors & WORD_VECTORS,
+  size_t CACHE_MB = VERB_CACHE_MB,
+  const SketchOptions & SKETCH = SketchOptions());
  
 //! return the transitive stats
 void trans_count(  std::string results_file,
@@ -50,9 +61,11 @@ void trans_count(  std::string results_file,
   std::set<std::string> & VERB_TRANSITIVE,
   std::set<std::string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  std::map<std::string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   std::vector< std::vector<int> > & VERB_SBJ_OBJ,
-  std::vector< std::vector<float> > & WORD_VECTORS);
+  SparseVectors & WORD_VECTORS,
+  size_t CACHE_MB = VERB_CACHE_MB,
+  const SketchOptions & SKETCH = SketchOptions());
 
 //! Return all the stats
 void all_count(std::string results_file,
@@ -60,17 +73,19 @@ void all_count(std::string results_file,
   std::set<std::string> & VERB_TRANSITIVE,
   std::set<std::string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  std::map<std::string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   std::vector< std::vector<int> > & VERB_SBJ_OBJ,
 	std::vector< std::vector<int> > & VERB_SUBJECTS,
-  std::vector< std::vector<float> > & WORD_VECTORS);
+  SparseVectors & WORD_VECTORS,
+  size_t CACHE_MB = VERB_CACHE_MB,
+  const SketchOptions & SKETCH = SketchOptions());
 
 //! Return the variance
 void variance_count(std::string results_file,
     std::vector<VerbPair> & VERBS_TO_CHECK,
   int BASIS_SIZE,
-  std::map<std::string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   std::vector< std::vector<int> > & VERB_SBJ_OBJ,
-  std::vector< std::vector<float> > & WORD_VECTORS);
+  SparseVectors & WORD_VECTORS);
  
 #endif
@@ -0,0 +1,63 @@
+/**
+* @brief Approximate Kronecker similarities through TensorSketch
+* @file wacky_sketch.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_SKETCH_HPP
+#define WACKY_SKETCH_HPP
+
+#include <cstdint>
+#include <complex>
+#include <string>
+#include <vector>
+
+#include "wacky_kron.hpp"
+
+//! How the approximate Kronecker columns are made. The sketch width is picked so that, by
+//! Chebyshev and the variance bound for order two TensorSketch, an inner product is within
+//! epsilon * |a| * |b| of the exact one with probability 1 - delta.
+struct SketchOptions {
+  float epsilon = 0;       // The error we allow. 0 turns sketching off.
+  float delta = 0.1f;      // The chance of missing that error
+  bool only = false;       // Leave out the exact Kronecker columns when sketching, for bases too big to do them
+  uint32_t seed = 1;
+};
+
+//! A TensorSketch of order two. Two count sketches of width dim are taken of a and b and
+//! circularly convolved, which is a count sketch of a (x) b. We keep sketches as the first
+//! dim / 2 + 1 terms of their FFT so sums of terms and inner products need no inverse FFT.
+struct TensorSketch {
+  int basis;
+  int dim;
+  std::vector<int> bucket0;
+  std::vector<int> bucket1;
+  std::vector<float> sign0;
+  std::vector<float> sign1;
+  std::vector< std::complex<float> > twiddle;
+  std::vector<int> reverse;
+};
+
+typedef std::vector< std::complex<float> > Sketch;
+
+//! the sketch width, a power of two, that meets epsilon and delta
+int tensor_sketch_dim(float epsilon, float delta);
+
+//! pick the hash functions for a basis, the same for every verb in a run
+void tensor_sketch_init(TensorSketch & ts, int basis, const SketchOptions & options);
+
+//! out becomes the sketch of everything in a KronSum, scale included
+void tensor_sketch_krn(const TensorSketch & ts, const KronSum & k, Sketch & out);
+
+//! add the sketch of weight * (a (x) b) to out
+void tensor_sketch_add(const TensorSketch & ts, const float * a, const float * b, float weight, Sketch & out);
+
+//! the cosine_sim of the two tensors, worked out from their sketches
+float tensor_sketch_cosine_sim(const Sketch & x, const Sketch & y);
+
+//! the header columns for some Kronecker similarities, exact and / or approximate, each with a leading comma
+std::string sketch_columns(const std::vector<std::string> & names, const SketchOptions & options);
+
+#endif
@@ -0,0 +1,93 @@
+/**
+* @brief Compressed sparse row storage for the count and PMI word vectors
+* @file wacky_sparse.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_SPARSE_HPP
+#define WACKY_SPARSE_HPP
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+//! Word vectors in compressed sparse row form. The entries of row r are
+//! col_idx and vals over [row_ptr[r], row_ptr[r+1]), sorted by column.
+struct SparseVectors {
+  size_t num_cols;
+  std::vector<size_t> row_ptr;
+  std::vector<int> col_idx;
+  std::vector<float> vals;
+
+  size_t rows() const { return row_ptr.empty() ? 0 : row_ptr.size() - 1; }
+  size_t nnz() const { return vals.size(); }
+};
+
+//! A sorted run of counts, keyed on row * num_cols + col with no key twice
+struct SparseRun {
+  std::vector<uint64_t> keys;
+  std::vector<float> vals;
+};
+
+//! How many shards SparseCounts splits its rows into, row r going to shard r % SPARSE_COUNT_SHARDS
+#define SPARSE_COUNT_SHARDS 64
+
+//! Counts gathered while we count the corpus, before packing them into a SparseVectors.
+//! Each shard holds a stack of sorted runs, each smaller than the one below it, so a count
+//! costs 12 bytes rather than a hash map node, and adding a batch merges runs only as often
+//! as a binary counter carries.
+struct SparseCounts {
+  size_t num_rows;
+  size_t num_cols;
+  std::vector< std::vector<SparseRun> > shards;
+};
+
+//! make an empty set of counts
+void sparse_counts_init(SparseCounts & counts, size_t num_rows, size_t num_cols);
+
+//! add a batch of (row, col) hits, each counting one, whose rows all belong to one shard.
+//! Two threads may add to different shards at once.
+void sparse_counts_add(SparseCounts & counts, size_t shard, const std::vector<int> & hits);
+
+//! pack counts into sparse rows, merging each shard's runs as it goes
+void sparse_from_counts(SparseCounts & counts, SparseVectors & sparse);
+
+//! pack dense rows into sparse rows, dropping the zeroes
+void sparse_from_dense(const std::vector< std::vector<float> > & dense, size_t num_cols, SparseVectors & sparse);
+
+//! add a row, given as a dense vector, to the end of a SparseVectors
+void sparse_push_row(SparseVectors & sparse, const std::vector<float> & row);
+
+//! add a row, given as its non-zero columns and values, to the end of a SparseVectors
+void sparse_push_row(SparseVectors & sparse, const std::vector<int> & cols, const std::vector<float> & vals);
+
+//! add an empty row to the end of a SparseVectors
+void sparse_push_empty(SparseVectors & sparse);
+
+//! unpack one row into a dense vector of num_cols
+void sparse_row_dense(const SparseVectors & sparse, size_t row, std::vector<float> & out);
+
+//! unpack one row into num_cols floats
+void sparse_row_dense(const SparseVectors & sparse, size_t row, float * out);
+
+//! the dot product of two sparse rows
+float sparse_dot(const SparseVectors & a, size_t ra, const SparseVectors & b, size_t rb);
+
+//! the squared euclidean distance between two sparse rows
+float sparse_dist2(const SparseVectors & a, size_t ra, const SparseVectors & b, size_t rb);
+
+//! cosine_sim between two sparse rows
+float sparse_cosine_sim(const SparseVectors & a, size_t ra, const SparseVectors & b, size_t rb);
+
+//! cosine_sim between a sparse row and a dense vector
+float sparse_cosine_sim(const SparseVectors & a, size_t ra, const std::vector<float> & v);
+
+//! y += alpha * row, for summing word vectors into a dense vector
+void sparse_axpy(const SparseVectors & a, size_t row, float alpha, float * y);
+
+//! y += alpha * (row a + row b), adding each column's two values before scaling as a dense sum would
+void sparse_axpy(const SparseVectors & a, size_t ra, size_t rb, float alpha, float * y);
+
+#endif
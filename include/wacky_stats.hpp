@@ -0,0 +1,63 @@
+/**
+* @brief Timings, throughput and memory for each stage of a run, reported as JSON
+* @file wacky_stats.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_STATS_HPP
+#define WACKY_STATS_HPP
+
+#include <cstdint>
+#include <string>
+
+//! The status file is rewritten at most this often, in seconds
+#define STATS_STATUS_SECONDS 2.0
+
+//! Each stage's peak memory is sampled at most this often, in seconds
+#define STATS_RSS_SECONDS 0.01
+
+//! Threads past this many share busy time slots
+#define STATS_MAX_THREADS 256
+
+//! Start reporting. The JSON report is written to report_path when the program exits and
+//! the progress goes to report_path + ".status" as we run. Without this the stages are still
+//! timed, which costs next to nothing, but nothing is written.
+void stats_init(std::string report_path, int argc, char* argv[]);
+
+//! Times a stage from construction to destruction. Stages nest; the counts, steps and busy
+//! time go to the innermost one. Only open stages outside parallel regions. The peak memory
+//! of a stage is the most the process held when sampled - as the stage opens and closes and
+//! every STATS_RSS_SECONDS as it counts or steps - so a stage that never counts may miss a
+//! short lived spike.
+class StatsStage {
+public:
+  explicit StatsStage(const std::string & name);
+  ~StatsStage();
+
+private:
+  size_t index_;
+};
+
+//! add bytes read, sentences and tokens seen to the current stage. Safe from any thread.
+void stats_count(uint64_t bytes, uint64_t sentences, uint64_t tokens);
+
+//! how many steps the current stage will take, so the status file can show a fraction
+void stats_total(uint64_t steps);
+
+//! one more step of the current stage is done. Safe from any thread.
+void stats_step();
+
+//! Adds the time a thread spends between construction and destruction to its busy time in
+//! the current stage. Make one inside a parallel region, around the work but not the barrier.
+class StatsBusy {
+public:
+  StatsBusy();
+  ~StatsBusy();
+
+private:
+  double start_;
+};
+
+#endif
@@ -0,0 +1,49 @@
+/**
+* @brief Synthetic ukWaC style corpora for benchmarking
+* @file wacky_synth.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_SYNTH_HPP
+#define WACKY_SYNTH_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! The shape of a synthetic corpus. Word frequencies in each class follow a Zipf curve,
+//! sentence lengths are log-normal and every sentence is a tree of clauses, each a verb
+//! with a subject, maybe an object and maybe a prepositional phrase.
+struct SynthOptions {
+  size_t num_tokens = 1000000;    // Roughly how many tokens to write across all the files
+  size_t num_files = 4;
+  size_t num_nouns = 20000;
+  size_t num_verbs = 2000;
+  size_t num_adjectives = 4000;
+  double zipf = 1.05;              // The exponent of the rank frequency curve
+  double mean_sentence = 22.0;     // Mean sentence length in tokens, the full stop included
+  double transitive = 0.6;         // Fraction of verbs that usually take an object
+  uint32_t seed = 1;
+};
+
+//! What was written
+struct SynthCounts {
+  uint64_t bytes = 0;
+  uint64_t sentences = 0;
+  uint64_t tokens = 0;
+};
+
+//! the made up word for index i of a word class. Different classes never share a word.
+std::string synth_word(size_t i, int word_class);
+
+//! write a MaltParser format corpus as ukwac_00, ukwac_01 ... in OUTPUT_DIR
+int synth_corpus(std::string OUTPUT_DIR, const SynthOptions & options,
+    std::vector<std::string> & filenames,
+    SynthCounts & counts);
+
+//! write a SimVerb style file of verb pairs drawn from the most frequent verbs
+int synth_simverbs(std::string simverb_path, const SynthOptions & options, size_t num_pairs);
+
+#endif
@@ -0,0 +1,76 @@
+/**
+* @brief A binary, memory mappable version of word_vectors.txt
+* @file wacky_vector_file.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_VECTOR_FILE_HPP
+#define WACKY_VECTOR_FILE_HPP
+
+#include <cstdint>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/filesystem.hpp>
+
+#include "wacky_sparse.hpp"
+
+//! The name of the binary word vectors file we write next to word_vectors.txt
+#define VECTOR_FILE_NAME "word_vectors.wbv"
+
+//! Written next to the word vectors by a targeted count, listing the only rows it counted
+#define TARGETS_FILE_NAME "word_targets.txt"
+
+//! Bump this whenever the layout below changes
+#define VECTOR_FILE_VERSION 1
+
+//! The start of every .wbv file. After it come, each 8 byte aligned:
+//! uint64 row starts [num_rows + 1], then for a sparse file int32 columns [nnz], and finally
+//! float values [nnz]. A dense file has no columns and every row holds num_cols values.
+//! Row r covers the entries [rows[r], rows[r+1]) either way.
+struct VectorFileHeader {
+  char magic[4];
+  uint32_t version;
+  uint64_t num_rows;
+  uint64_t num_cols;
+  uint64_t nnz;
+  uint32_t sparse;
+  uint32_t padding;
+};
+
+//! A mapped .wbv file. Only the pages of the rows we ask for are ever read from disk.
+struct VectorFile {
+  boost::interprocess::file_mapping file;
+  boost::interprocess::mapped_region region;
+
+  const VectorFileHeader * header;
+  const uint64_t * rows;
+  const int32_t * cols;
+  const float * vals;
+};
+
+//! write dense word vectors, picking whichever encoding is smaller
+int vector_file_write(std::string path, const std::vector< std::vector<float> > & WORD_VECTORS, size_t num_cols);
+
+//! write sparse word vectors, picking whichever encoding is smaller
+int vector_file_write(std::string path, const SparseVectors & WORD_VECTORS);
+
+//! is there a binary vector file in OUTPUT_DIR at least as new as word_vectors.txt?
+bool vector_file_current(std::string OUTPUT_DIR);
+
+//! map a vector file into memory
+int vector_file_open(VectorFile & vf, std::string path);
+
+//! unpack one row into a dense vector of num_cols
+void vector_file_row(const VectorFile & vf, size_t row, std::vector<float> & out);
+
+//! the columns and values of the non-zeroes in one row, in column order
+void vector_file_row(const VectorFile & vf, size_t row, std::vector<int> & cols, std::vector<float> & vals);
+
+#endif
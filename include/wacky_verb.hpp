@@ -14,6 +14,7 @@
 #include <map>
 #include <vector>
 #include <set>
+#include <algorithm>
 
 #include <boost/interprocess/file_mapping.hpp>
 #include <boost/interprocess/mapped_region.hpp>
@@ -24,25 +25,61 @@
 
 #include "string_utils.hpp"
 #include "wacky_misc.hpp"
+#include "wacky_corpus.hpp"
+#include "wacky_output.hpp"
+#include "wacky_stats.hpp"
 
-//! create a set of verb objects
-void create_verb_objects(std::string str_buffer, std::vector<int> & verb_obj_pairs,
-    std::map<std::string,int> & DICTIONARY_FAST,
-    std::vector< std::vector<int> > & VERB_OBJECTS,
-    bool UNIQUE_OBJECTS,
-    bool LEMMA_TIME );
+// VERB_SUBJECTS and VERB_OBJECTS hold (word, count) pairs per verb and VERB_SBJ_OBJ holds
+// (subject, object, count) triples, each entry appearing once with how often we saw it.
 
-//! create a set of verb subjects
-void create_verb_subjects(std::string str_buffer, std::vector<int> & verb_sbj_pairs,
-    std::map<std::string,int> & DICTIONARY_FAST,
-    std::vector< std::vector<int> > & VERB_SUBJECTS,
-    bool UNIQUE_SUBJECTS,
-    bool LEMMA_TIME );
+//! Finds the token in a sentence that carries a MaltParser id in one lookup, so following a
+//! chain of heads costs a step per hop rather than a scan of the sentence. Ids run from 1 to
+//! the length of the sentence, so a table that long covers them; any other id is searched for.
+class HeadIndex {
+public:
+  HeadIndex() : ids_(NULL), n_(0), unique_(true) {}
+
+  //! index the n ids of a sentence. ids must outlive the index.
+  void build(const int32_t * ids, size_t n) {
+    ids_ = ids;
+    n_ = n;
+    unique_ = true;
+    table_.assign(n + 1, -1);
+    // Go backwards so the first token with an id is the one we keep
+    for (size_t j = n; j-- > 0; ) {
+      if (ids[j] >= 0 && static_cast<size_t>(ids[j]) <= n) {
+        if (table_[ids[j]] != -1) { unique_ = false; }
+        table_[ids[j]] = j;
+      }
+    }
+  }
+
+  //! the position of the first token with this id, or -1 if there isn't one
+  inline int find(int32_t target) const {
+    if (target >= 0 && static_cast<size_t>(target) <= n_) { return table_[target]; }
+    for (size_t j = 0; j < n_; ++j) {
+      if (ids_[j] == target) { return j; }
+    }
+    return -1;
+  }
+
+  //! false if a badly parsed sentence gave the same id to two tokens
+  bool unique() const { return unique_; }
+
+private:
+  const int32_t * ids_;
+  size_t n_;
+  bool unique_;
+  std::vector<int> table_;
+};
+
+//! merge repeated records in a flat list, summing their counts
+void collapse_counts(std::vector<int> & entries, int stride, bool unique);
 
 //! create the set of verb subject object pairs
 int create_verb_subject_object(std::vector<std::string> filenames,
     std::string OUTPUT_DIR, 
-    std::map<std::string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     std::vector< std::vector<int> > & VERB_SBJ_OBJ,
     std::vector< std::vector<int> > & VERB_SUBJECTS,
     std::vector< std::vector<int> > & VERB_OBJECTS,
@@ -50,6 +87,90 @@ int create_verb_subject_object(std::vector<std::string> filenames,
     bool UNIQUE_SUBJECTS,
     bool LEMMA_TIME );
 
+//! write verb_subjects.txt, verb_objects.txt and verb_sbj_obj.txt
+int write_verb_subject_object(std::string OUTPUT_DIR,
+    const std::vector< std::vector<int> > & VERB_SBJ_OBJ,
+    const std::vector< std::vector<int> > & VERB_SUBJECTS,
+    const std::vector< std::vector<int> > & VERB_OBJECTS);
+
+//! the verb subject and object lists, as a pipeline stage
+class DependencyExtractor : public SentenceConsumer {
+public:
+  DependencyExtractor(Dictionary & DICTIONARY_FAST,
+      std::vector< std::vector<int> > & VERB_SBJ_OBJ,
+      std::vector< std::vector<int> > & VERB_SUBJECTS,
+      std::vector< std::vector<int> > & VERB_OBJECTS,
+      bool UNIQUE_OBJECTS,
+      bool UNIQUE_SUBJECTS,
+      bool LEMMA_TIME);
+
+  int begin_file(const Corpus & corpus, const std::string & name) override;
+  void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) override;
+  int end_file(const Corpus & corpus) override;
+
+private:
+  Dictionary & dictionary_;
+  std::vector< std::vector<int> > & sbj_obj_;
+  std::vector< std::vector<int> > & subjects_;
+  std::vector< std::vector<int> > & objects_;
+  bool unique_objects_;
+  bool unique_subjects_;
+  bool lemma_time_;
+  const int32_t * col_;
+  std::vector<int> lookup_;
+  std::vector<char> sbj_, obj_, noun_, verb_;
+  std::vector<HeadIndex> heads_;
+  std::vector< std::vector<int> > sbj_pairs_;
+  std::vector< std::vector<int> > obj_pairs_;
+};
+
+//! read the simverb file and zero the counts
+int setup_simverbs(std::string simverb_path,
+    std::vector<std::string> & SIMVERBS,
+    std::vector<int> & SIMVERBS_COUNT,
+    std::vector<int> & SIMVERBS_OBJECTS,
+    std::vector<int> & SIMVERBS_ALONE);
+
+//! write the simverb counts to sim_stats.txt
+int write_simverbs(std::string OUTPUT_DIR,
+    std::vector<std::string> & SIMVERBS,
+    std::vector<int> & SIMVERBS_COUNT,
+    std::vector<int> & SIMVERBS_OBJECTS,
+    std::vector<int> & SIMVERBS_ALONE);
+
+//! the simverb statistics, as a pipeline stage
+class SimverbCounter : public SentenceConsumer {
+public:
+  SimverbCounter(std::vector<std::string> & SIMVERBS,
+      std::vector<int> & SIMVERBS_COUNT,
+      std::vector<int> & SIMVERBS_OBJECTS,
+      std::vector<int> & SIMVERBS_ALONE,
+      bool LEMMA_TIME);
+
+  int begin_file(const Corpus & corpus, const std::string & name) override;
+  void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) override;
+  int end_file(const Corpus & corpus) override;
+
+private:
+  struct ThreadCounts {
+    std::vector<int> count, objects, alone;
+    std::vector<int> sim_indices;
+    std::vector<char> verb_hit;
+    std::vector<uint64_t> object_indices;
+    HeadIndex heads;
+  };
+
+  std::vector<std::string> & simverbs_;
+  std::vector<int> & count_;
+  std::vector<int> & objects_;
+  std::vector<int> & alone_;
+  bool lemma_time_;
+  const int32_t * col_;
+  std::vector<char> verb_, obj_;
+  std::vector<int> sim_;
+  std::vector<ThreadCounts> threads_;
+};
+
 //! create the set of statistics for how many times a verb has a subject or object
 int create_simverbs(std::vector<std::string> filenames, std::string simverb_path,
     std::string OUTPUT_DIR,
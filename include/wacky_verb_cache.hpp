@@ -0,0 +1,213 @@
+/**
+* @brief A run level cache of the composed tensors for each verb
+* @file wacky_verb_cache.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_VERB_CACHE_HPP
+#define WACKY_VERB_CACHE_HPP
+
+#include <map>
+#include <list>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <omp.h>
+
+#include "wacky_kron.hpp"
+#include "wacky_sketch.hpp"
+
+//! How much memory the verb cache may use by default, in megabytes
+#define VERB_CACHE_MB 2048
+
+//! Which of the read_subjects* functions built a VerbTensor
+enum VerbModel {
+  MODEL_SBJ_OBJ,        // read_subjects_objects
+  MODEL_SBJ_OBJ_FEW,    // read_subjects_objects_few
+  MODEL_SBJ_FEW,        // read_subjects_few
+  MODEL_SBJ             // read_subjects
+};
+
+//! Everything we compose for one verb. Which fields are filled depends on the VerbModel.
+//! The krn_* norms are the squared lengths of the Kronecker sums so the pair loop only
+//! needs the cross terms.
+template<class V>
+struct VerbTensor {
+  V base;
+  V sum_subject;
+  V sum_object;
+  V min;
+  V max;
+  V krn;                // packed upper triangle of subject (x) subject, only for MODEL_SBJ
+
+  KronSum krn_sum;      // the sum of the kroneckered subjects and objects
+  KronSum krn_add;      // krn_sum + base (x) base
+  KronSum krn_mul;      // krn_sum (o) base (x) base
+  double krn_sum_norm;
+  double krn_add_norm;
+  double krn_mul_norm;
+
+  Sketch sketch_sum;    // TensorSketches of krn_sum, krn_add and krn_mul, when we approximate
+  Sketch sketch_add;
+  Sketch sketch_mul;
+};
+
+/**
+ * Fill in the Kronecker forms of a VerbTensor once krn_sum and base are set
+ * @param t the VerbTensor
+ * @param base a pointer to the basis floats of the verb vector
+ */
+
+template<class V>
+void verb_tensor_finish(VerbTensor<V> & t, const float * base) {
+  t.krn_add = t.krn_sum;
+  krn_sum_add(t.krn_add, base, base, 1.0f);
+  krn_sum_hadamard(t.krn_mul, t.krn_sum, base);
+
+  t.krn_sum_norm = krn_sum_dot(t.krn_sum, t.krn_sum);
+  t.krn_add_norm = krn_sum_dot(t.krn_add, t.krn_add);
+  t.krn_mul_norm = krn_sum_dot(t.krn_mul, t.krn_mul);
+}
+
+/**
+ * Sketch the Kronecker forms of a VerbTensor once krn_sum and base are set. This doesn't
+ * need verb_tensor_finish so the exact forms can be left out.
+ * @param t the VerbTensor
+ * @param sketch the TensorSketch for this run
+ * @param base a pointer to the basis floats of the verb vector
+ */
+
+template<class V>
+void verb_tensor_sketch(VerbTensor<V> & t, const TensorSketch & sketch, const float * base) {
+  tensor_sketch_krn(sketch, t.krn_sum, t.sketch_sum);
+  t.sketch_add = t.sketch_sum;
+  tensor_sketch_add(sketch, base, base, 1.0f, t.sketch_add);
+
+  KronSum mul;
+  krn_sum_hadamard(mul, t.krn_sum, base);
+  tensor_sketch_krn(sketch, mul, t.sketch_mul);
+}
+
+/**
+ * Roughly how many bytes a VerbTensor holds on to
+ * @param t the VerbTensor
+ * @return the size in bytes
+ */
+
+template<class V>
+size_t verb_tensor_bytes(const VerbTensor<V> & t) {
+  size_t floats = t.base.size() + t.sum_subject.size() + t.sum_object.size() +
+    t.min.size() + t.max.size() + t.krn.size();
+
+  const KronSum * ks[3] = { &t.krn_sum, &t.krn_add, &t.krn_mul };
+  for (int i = 0; i < 3; ++i) {
+    floats += ks[i]->extra.size() + ks[i]->scale.size() + (ks[i]->weight.size() * 3);
+  }
+
+  floats += (t.sketch_sum.size() + t.sketch_add.size() + t.sketch_mul.size()) * 2;
+
+  return floats * sizeof(float);
+}
+
+//! A least recently used cache of VerbTensors keyed on (verb index, VerbModel). Entries are
+//! handed out as shared_ptrs so evicting one never pulls it from under a thread still using it.
+//! Callers share entries so must treat them as read only.
+//! Safe to call from inside an omp parallel region.
+template<class V>
+class VerbCache {
+public:
+  typedef std::pair<int,int> Key;
+  typedef std::shared_ptr< VerbTensor<V> > Entry;
+  typedef std::function< void(VerbTensor<V> &) > Builder;
+
+  VerbCache(size_t budget_mb = VERB_CACHE_MB) : budget_ (budget_mb * 1024 * 1024), used_ (0),
+      hits_ (0), misses_ (0) {
+    omp_init_lock(&lock_);
+  }
+
+  ~VerbCache() { omp_destroy_lock(&lock_); }
+
+  /**
+   * Return the tensor for this verb and model, building it if we don't have it
+   * @param vidx the index of the verb in the dictionary
+   * @param model which VerbModel we want
+   * @param build fills in an empty VerbTensor if it isn't cached
+   * @return a shared_ptr to the VerbTensor
+   */
+
+  Entry get(int vidx, VerbModel model, Builder build) {
+    Key key (vidx, static_cast<int>(model));
+
+    omp_set_lock(&lock_);
+    typename std::map<Key, Slot>::iterator it = entries_.find(key);
+    if (it != entries_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second.pos);
+      Entry e = it->second.tensor;
+      hits_++;
+      omp_unset_lock(&lock_);
+      return e;
+    }
+    misses_++;
+    omp_unset_lock(&lock_);
+
+    // Build outside the lock. Two threads may build the same verb at once; the first one in wins.
+    std::shared_ptr< VerbTensor<V> > t (new VerbTensor<V>());
+    build(*t);
+    size_t bytes = verb_tensor_bytes(*t);
+
+    omp_set_lock(&lock_);
+    it = entries_.find(key);
+    if (it != entries_.end()) {
+      Entry e = it->second.tensor;
+      omp_unset_lock(&lock_);
+      return e;
+    }
+
+    // Anything bigger than the whole budget is handed back but never kept, nor evicts anything
+    if (bytes <= budget_) {
+      while (!lru_.empty() && used_ + bytes > budget_) {
+        typename std::map<Key, Slot>::iterator old = entries_.find(lru_.back());
+        used_ -= old->second.bytes;
+        entries_.erase(old);
+        lru_.pop_back();
+      }
+
+      lru_.push_front(key);
+      Slot s;
+      s.tensor = t;
+      s.bytes = bytes;
+      s.pos = lru_.begin();
+      entries_[key] = s;
+      used_ += bytes;
+    }
+
+    omp_unset_lock(&lock_);
+    return t;
+  }
+
+  size_t hits() const { return hits_; }
+  size_t misses() const { return misses_; }
+
+private:
+  struct Slot {
+    Entry tensor;
+    size_t bytes;
+    typename std::list<Key>::iterator pos;
+  };
+
+  size_t budget_;
+  size_t used_;
+  size_t hits_;
+  size_t misses_;
+  std::map<Key, Slot> entries_;
+  std::list<Key> lru_;
+  omp_lock_t lock_;
+
+  VerbCache(const VerbCache &);
+  VerbCache & operator=(const VerbCache &);
+};
+
+#endif
@@ -0,0 +1,91 @@
+/**
+* @brief Per thread scratch memory for the composition models
+* @file wacky_workspace.hpp
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#ifndef WACKY_WORKSPACE_HPP
+#define WACKY_WORKSPACE_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+//! Slices are lined up on 16 floats - 64 bytes, a cache line
+#define WORKSPACE_ALIGN 16
+
+//! A block of scratch floats for one thread, sized once up front and handed out in aligned
+//! slices. A pair loop calls reset() each time round and takes what it needs, so it never goes
+//! near the heap. Functions that want scratch of their own take a mark() and rewind() to it
+//! when done. If a run asks for more than we reserved we hand out separate blocks until the
+//! next reset(), which then grows the main block to the most we were ever asked for.
+//! Not thread safe - every thread wants its own.
+class Workspace {
+public:
+  Workspace() : base_ (nullptr), capacity_ (0), used_ (0), peak_ (0) {}
+
+  explicit Workspace(size_t floats) : Workspace() { reserve(floats); }
+
+  //! how many floats a slice of n floats takes up
+  static size_t slice(size_t n) { return ((n + WORKSPACE_ALIGN - 1) / WORKSPACE_ALIGN) * WORKSPACE_ALIGN; }
+
+  //! make room for this many floats, giving back every slice. The block is zeroed here, so
+  //! the pages belong to the thread that reserves it.
+  void reserve(size_t floats) {
+    overflow_.clear();
+    block_.assign(slice(floats) + WORKSPACE_ALIGN, 0.0f);
+    base_ = align(&block_[0]);
+    capacity_ = slice(floats);
+    used_ = 0;
+  }
+
+  //! an aligned slice of n floats, holding whatever was there before
+  float * take(size_t n) {
+    size_t s = slice(n);
+    float * p;
+    if (used_ + s <= capacity_) {
+      p = base_ + used_;
+    } else {
+      overflow_.push_back(std::vector<float>(s + WORKSPACE_ALIGN));
+      p = align(&overflow_.back()[0]);
+    }
+    used_ += s;
+    peak_ = std::max(peak_, used_);
+    return p;
+  }
+
+  //! where we are, to rewind() to later
+  size_t mark() const { return used_; }
+
+  //! give back every slice taken since mark
+  void rewind(size_t mark) { used_ = mark; }
+
+  //! give back every slice, growing the block if we ran over it
+  void reset() {
+    if (!overflow_.empty()) {
+      reserve(peak_);
+    }
+    used_ = 0;
+  }
+
+  size_t capacity() const { return capacity_; }
+  size_t peak() const { return peak_; }
+
+private:
+  static float * align(float * p) {
+    uintptr_t a = reinterpret_cast<uintptr_t>(p);
+    uintptr_t bytes = WORKSPACE_ALIGN * sizeof(float);
+    return reinterpret_cast<float *>((a + bytes - 1) & ~(bytes - 1));
+  }
+
+  std::vector<float> block_;
+  std::vector< std::vector<float> > overflow_;
+  float * base_;
+  size_t capacity_;
+  size_t used_;
+  size_t peak_;
+};
+
+#endif
@@ -64,10 +64,10 @@ def read_sbj_obj_file(BASE_DIR, SBJ_OBJ_FILE):
       tokens = line.split()
       SBJ_OBJ[int(tokens[0])] = []
       if (len(tokens) > 1):
-        for i in range(1,len(tokens),2):
+        for i in range(1,len(tokens),3):
           sbj_idx = int(tokens[i])
           obj_idx = int(tokens[i+1])
-          SBJ_OBJ[int(tokens[0])].append( (sbj_idx, obj_idx) )  
+          SBJ_OBJ[int(tokens[0])].extend( [(sbj_idx, obj_idx)] * int(tokens[i+2]) )  
 
   return SBJ_OBJ
 
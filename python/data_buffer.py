@@ -112,49 +112,61 @@ def read_dictionary(dict_path):
 
   return dictionary, reverse_dictionary, size_dict
 
-# Find Integer data files and their associated file sizes
+# The header at the start of every integers_xxxxxx.idx file
+_index_header = np.dtype([('magic', 'S4'), ('version', '<u4'), ('num_tokens', '<u8'),
+  ('num_known', '<u8'), ('num_sentences', '<u8')])
+
+# Find Integer data files and their associated index files
 def find_integer_files(intpath):
 
   data_files = []
-  size_files = []
+  index_files = []
 
   for dirname, dirnames, filenames in os.walk(intpath):
     for filename in filenames:
-      if "integers_" in filename:
+      if filename.startswith("integers_") and filename.endswith(".bin"):
         data_files.append(os.path.join(dirname, filename))
-      elif "size_" in filename:
-        size_files.append(os.path.join(dirname, filename))
+      elif filename.startswith("integers_") and filename.endswith(".idx"):
+        index_files.append(os.path.join(dirname, filename))
 
   data_files.sort()
-  size_files.sort()
+  index_files.sort()
+
+  return data_files, index_files
 
-  return data_files, size_files
+# Read an index file, returning the header and the sentence starts
+def read_integer_index(index_path):
+  header = np.fromfile(index_path, dtype=_index_header, count=1)[0]
+  if header['magic'] != b'WBI1' or header['version'] != 1:
+    raise ValueError(index_path + " is not a version 1 integer index")
+  sentences = np.fromfile(index_path, dtype='<u8', count=int(header['num_sentences']) + 1,
+    offset=_index_header.itemsize)
+  return header, sentences
 
 def read_integer_file(filepath):
   global _current_data_block
   print("Reading integer file",filepath)
-  _current_data_block = []
-  with open(filepath, 'r') as f:
-    for line in f.readlines():
-      _current_data_block.append(int(line))
+  if os.path.getsize(filepath) == 0:
+    _current_data_block = np.zeros(0, dtype='<u4')
+  else:
+    _current_data_block = np.memmap(filepath, dtype='<u4', mode='r')
 
 
 # Set the integer data files, reading the first into the buffer
-def set_integer_files(integer_files, size_files):
+def set_integer_files(integer_files, index_files):
 
   global _data_barriers
   global _integer_files
 
   _integer_files = integer_files
 
-  # Set the barriers from the sizes
+  # Set the barriers from the number of tokens in each file
   offset = 0
   _data_barriers.append(0)
-  for size_file in size_files:
-    with open(size_file, 'r') as f:
-      for line in f.readlines():
-        offset += int(line)
-        _data_barriers.append(offset)
+  for index_file in index_files:
+    header, _ = read_integer_index(index_file)
+    offset += int(header['num_tokens'])
+    _data_barriers.append(offset)
 
   read_integer_file(integer_files[0])
 
@@ -84,7 +84,7 @@ if __name__ == "__main__" :
 
   print("Reading dictionary")
   dictionary, reverse_dictionary, vocabulary_size = read_dictionary(BASE_DIR + DICTIONARY_FILE) 
-  data_files, size_files = find_integer_files(BASE_DIR + INTEGER_DIR)
+  data_files, index_files = find_integer_files(BASE_DIR + INTEGER_DIR)
   count, count_order = read_freq(BASE_DIR + FREQ_FILE, vocabulary_size)
 
   # Wacky removes the most 100 common so we adjust the count_order accordingly
@@ -95,7 +95,7 @@ if __name__ == "__main__" :
   print("Vocabularly of size", vocabulary_size)
 
   print("Reading integer data files")
-  set_integer_files(data_files, size_files)
+  set_integer_files(data_files, index_files)
   
   print("Reading total data size")
   data_size = read_total_size(BASE_DIR + TOTAL_FILE)
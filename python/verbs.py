@@ -94,7 +94,7 @@ def read_subjects() :
 
           sl = 0
 
-          for sbj in tokens[1:]:
+          for sbj in [t for w, c in zip(tokens[1::2], tokens[2::2]) for t in [w] * int(c)]:
             try:
               sbj_idx = int(sbj)
               #print (" -", DICTIONARY[sbj_idx])
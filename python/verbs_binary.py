@@ -80,7 +80,7 @@ def read_subjects_file(base_dir, subjects_file):
       tokens = line.split()
       subjects[int(tokens[0])] = []
       if (len(tokens) > 1):
-        for sbj in tokens[1:]:
+        for sbj in [t for w, c in zip(tokens[1::2], tokens[2::2]) for t in [w] * int(c)]:
           sbj_idx = int(sbj)
           subjects[int(tokens[0])].append(sbj_idx)  
   return subjects
@@ -95,10 +95,10 @@ def read_sbj_obj_file(base_dir, sbj_obj_file):
       tokens = line.split()
       sbj_obj[int(tokens[0])] = []
       if (len(tokens) > 1):
-        for i in range(1,len(tokens),2):
+        for i in range(1,len(tokens),3):
           sbj_idx = int(tokens[i])
           obj_idx = int(tokens[i+1])
-          sbj_obj[int(tokens[0])].append( (sbj_idx, obj_idx) ) 
+          sbj_obj[int(tokens[0])].extend( [(sbj_idx, obj_idx)] * int(tokens[i+2]) ) 
   
   return sbj_obj
  
@@ -117,7 +117,7 @@ def read_subject_object(base_dir, subjects_file, object_file, dictionary, w2v_re
         found_subject = dictionary[int(tokens[0])]
         
         if verb == found_subject: 
-          for sbj in tokens[1:]:
+          for sbj in [t for w, c in zip(tokens[1::2], tokens[2::2]) for t in [w] * int(c)]:
             sbj_idx = int(sbj)
 
             # Convert to the word2vec lookup
@@ -138,7 +138,7 @@ def read_subject_object(base_dir, subjects_file, object_file, dictionary, w2v_re
         found_object = dictionary[int(tokens[0])]
         
         if verb == found_object: 
-          for obj in tokens[1:]:
+          for obj in [t for w, c in zip(tokens[1::2], tokens[2::2]) for t in [w] * int(c)]:
 
             obj_idx = int(obj)
 
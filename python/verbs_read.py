@@ -80,7 +80,7 @@ def read_subjects_file(BASE_DIR, VOCAB_SIZE, SUBJECTS_FILE):
       line = line.replace("\n","")
       tokens = line.split()
       if (len(tokens) > 1):
-        for sbj in tokens[1:]:
+        for sbj in [t for w, c in zip(tokens[1::2], tokens[2::2]) for t in [w] * int(c)]:
           sbj_idx = int(sbj)
           SUBJECTS[int(tokens[0])].append(sbj_idx)  
 
@@ -99,10 +99,10 @@ def read_sbj_obj_file(BASE_DIR, VOCAB_SIZE, SBJ_OBJ_FILE):
       tokens = line.split()
       SBJ_OBJ[int(tokens[0])] = []
       if (len(tokens) > 1):
-        for i in range(1,len(tokens),2):
+        for i in range(1,len(tokens),3):
           sbj_idx = int(tokens[i])
           obj_idx = int(tokens[i+1])
-          SBJ_OBJ[int(tokens[0])].append( (sbj_idx, obj_idx) )  
+          SBJ_OBJ[int(tokens[0])].extend( [(sbj_idx, obj_idx)] * int(tokens[i+2]) )  
   
   return SBJ_OBJ
 
@@ -127,7 +127,7 @@ def read_subject_object(verb, BASE_DIR, DICTIONARY, SUBJECTS_FILE, OBJECT_FILE,
         found_subject = DICTIONARY[int(tokens[0])]
         
         if verb == found_subject: 
-          for sbj in tokens[1:]:
+          for sbj in [t for w, c in zip(tokens[1::2], tokens[2::2]) for t in [w] * int(c)]:
             sbj_idx = int(sbj)
 
             # Convert to the word2vec lookup
@@ -152,7 +152,7 @@ def read_subject_object(verb, BASE_DIR, DICTIONARY, SUBJECTS_FILE, OBJECT_FILE,
         found_object = DICTIONARY[int(tokens[0])]
         
         if verb == found_object: 
-          for obj in tokens[1:]:
+          for obj in [t for w, c in zip(tokens[1::2], tokens[2::2]) for t in [w] * int(c)]:
 
             obj_idx = int(obj)
 
@@ -64,9 +64,9 @@ __global__ void VerbSubjectKrn(int width, int height, float *input, int idx, flo
  * @param krn_vector a ublas vector of verb (x) verb
  */
 
-void read_subjects_cuda(string verb, map<string,int> & DICTIONARY_FAST,
+void read_subjects_cuda(string verb, Dictionary & DICTIONARY_FAST,
     vector< vector<int> > & VERB_SUBJECTS,
-    vector< vector<float> > & WORD_VECTORS,
+    SparseVectors & WORD_VECTORS,
     int BASIS_SIZE,
     ublas::vector<float> & base_vector,
     ublas::vector<float> & add_vector,
@@ -75,9 +75,7 @@ void read_subjects_cuda(string verb, map<string,int> & DICTIONARY_FAST,
   int vidx = DICTIONARY_FAST[verb];
   vector<int> subjects = VERB_SUBJECTS[vidx];
 
-  for (int i=0; i < BASIS_SIZE; ++i){
-    base_vector[i] = WORD_VECTORS[vidx][i];
-  } 
+  sparse_row_dense(WORD_VECTORS, vidx, &base_vector[0]);
  
   for (int i=0; i < BASIS_SIZE; ++i){
     add_vector[i] = 0.0f;
@@ -87,16 +85,16 @@ void read_subjects_cuda(string verb, map<string,int> & DICTIONARY_FAST,
     }
   }
 
-  for (int i : subjects) {
+  // subjects holds (subject, count) pairs
+  for (int s = 0; s < subjects.size(); s+=2) {
+    int i = subjects[s];
+    float count = static_cast<float>(subjects[s+1]);
     ublas::vector<float> sbj_vector (BASIS_SIZE);
-  
-    for (int j =0; j < BASIS_SIZE; ++j) {
-      sbj_vector[j] = WORD_VECTORS[i][j];
-    }
+    sparse_row_dense(WORD_VECTORS, i, &sbj_vector[0]);
 
-    add_vector = add_vector + sbj_vector;
+    add_vector = add_vector + count * sbj_vector;
     ublas::vector<float> tk  = krn_mul(sbj_vector, sbj_vector);
-    krn_vector = krn_vector + tk;   
+    krn_vector = krn_vector + count * tk;   
   }
 }
 
@@ -113,9 +111,9 @@ void read_subjects_cuda(string verb, map<string,int> & DICTIONARY_FAST,
  * @param sum_krn a ublas vector of the verb subs objs kroneckered
  */
 
-void read_subjects_objects_cuda(string verb, map<string,int> & DICTIONARY_FAST,
+void read_subjects_objects_cuda(string verb, Dictionary & DICTIONARY_FAST,
     vector< vector<int> > & VERB_SBJ_OBJ,
-    vector< vector<float> > & WORD_VECTORS,
+    SparseVectors & WORD_VECTORS,
     int BASIS_SIZE,
     ublas::vector<float> & base_vector,
     ublas::vector<float> & sum_subject,
@@ -131,19 +129,25 @@ void read_subjects_objects_cuda(string verb, map<string,int> & DICTIONARY_FAST,
   // We modify the Basis size to fit it nicely into memory (ish)
   size_t real_width = BASIS_SIZE + (BASIS_SIZE % 8);
 
-  for (int i : subs_obs) {
-    for (int j = 0; j < BASIS_SIZE; ++j) {
-      subs_obs_conv.push_back( WORD_VECTORS[i][j]);
-    }
-    for (int j = 0; j < real_width - BASIS_SIZE; ++j){
-      subs_obs_conv.push_back(0);
+  // subs_obs holds (subject, object, count) triples. The kernels work a row at a time
+  // so we still hand them one dense row per occurrence
+  vector<float> row;
+  for (int t = 0; t < subs_obs.size(); t+=3) {
+    for (int c = 0; c < subs_obs[t+2]; ++c) {
+      for (int w = 0; w < 2; ++w) {
+        sparse_row_dense(WORD_VECTORS, subs_obs[t+w], row);
+        for (int j = 0; j < BASIS_SIZE; ++j) {
+          subs_obs_conv.push_back(row[j]);
+        }
+        for (int j = 0; j < real_width - BASIS_SIZE; ++j){
+          subs_obs_conv.push_back(0);
+        }
+      }
     }
   }
 
   // Copy the base vector
-  for (int i=0; i < BASIS_SIZE; ++i){
-    base_vector[i] = WORD_VECTORS[vidx][i];
-  } 
+  sparse_row_dense(WORD_VECTORS, vidx, &base_vector[0]);
  
   cout << "Verb: " << verb << endl; 
 
@@ -269,10 +273,10 @@ void all_count_cuda( string results_file,
   set<string> & VERB_TRANSITIVE,
   set<string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  map<string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   vector< vector<int> > & VERB_SBJ_OBJ,
 	vector< vector<int> > & VERB_SUBJECTS,
-  vector< vector<float> > & WORD_VECTORS) {
+  SparseVectors & WORD_VECTORS) {
 
 	cout << "verb0,verb1,base_sim,cs1,cs2,cs3,cs4,cs5,cs6,human_sim" << endl;
 
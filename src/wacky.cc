@@ -33,6 +33,7 @@
 #include "wacky_create.hpp"
 #include "wacky_read.hpp"
 #include "wacky_verb.hpp"
+#include "wacky_stats.hpp"
 
 #ifdef _USE_CUDA
 #include <cuda_runtime.h>
@@ -51,13 +52,14 @@ using namespace boost::filesystem;
 map<string, size_t> FREQ {};
 vector< pair<string,size_t> > FREQ_FLIPPED {};
 set<string> WORD_IGNORES {",","-",".","@card@", "<text","<s>xt","</s>SENT", "<s>>SENT", "<s>", "</s>", "<text>", "</text>"};
-map<string,int> DICTIONARY_FAST {};
+Dictionary DICTIONARY_FAST;
 vector<string> DICTIONARY {};
 set<string> ALLOWED_BASIS_WORDS;
 set<string> INSIST_BASIS_WORDS;
 vector< vector<int> > VERB_SUBJECTS;
 vector< vector<int> > VERB_OBJECTS;
 vector< vector<float> > WORD_VECTORS;
+SparseVectors CHECK_VECTORS;
 vector< vector<int> > VERB_SBJ_OBJ;
 vector<int> BASIS_VECTOR;
 vector<string> SIMVERBS;
@@ -68,6 +70,7 @@ vector<int> SIMVERBS_ALONE;
 set<string> VERB_TRANSITIVE;
 set<string> VERB_INTRANSITIVE;
 set<int> WORDS_TO_CHECK;
+set<int> TARGET_WORDS;
 vector<VerbPair> VERBS_TO_CHECK;
 
 // Our list of options
@@ -77,6 +80,8 @@ struct WackyOptions {
   string simverb_file;
   string combine_file;
   string RESULTS_FILE;
+  string CORPUS_DIR;      // Where the binary version of ukwac lives, if we are using it
+  string REPORT_FILE;     // Where the JSON timing report goes, if we want one
 
   bool read_in;
   bool verb_subject;
@@ -88,6 +93,10 @@ struct WackyOptions {
   bool intransitive;
   bool transitive;
   bool variance;
+  bool corpus;
+  bool pipeline;          // Run all the create passes we asked for in one scan of the files
+  bool SPARSE;            // Count the word vectors as sparse rows rather than one dense block
+  bool TARGETED;          // Only count the word vectors the -p and -h passes will read
 
   size_t UNK_COUNT;
   size_t TOTAL_COUNT;     // TODO - not really an option so needs moving I think
@@ -99,6 +108,9 @@ struct WackyOptions {
   size_t WINDOW_SIZE;      // Our sliding window size, either side of the chosen word
   bool  UNIQUE_SUBJECTS;
   bool  UNIQUE_OBJECTS;
+  size_t CACHE_MB;        // How much memory the verb tensor cache may use when running the models
+  size_t FREQ_CAPACITY;   // If not 0, count frequencies in bounded memory keeping about this many words
+  SketchOptions SKETCH;   // Approximate Kronecker similarities through TensorSketch
 
 };
 
@@ -111,17 +123,27 @@ struct WackyOptions {
 
 int combine_ukwac(vector<string> filenames, string outpath) {
 
-  std::ofstream combine_file (outpath);
+  TextFile combine_file;
+  combine_file.open(outpath);
   
   // Scan directory for the files
   for( string filepath : filenames) {
+    if (corpus_file(filepath)) {
+      Corpus corpus;
+      if (corpus_open(corpus, filepath) != 0) { return 1; }
+      for (uint64_t i = 0; i < corpus.header->num_tokens; ++i) {
+        combine_file << corpus_string(corpus, corpus.word[i]) << ' ';
+      }
+      continue;
+    }
+
     std::ifstream infile (filepath); 
     string line;
     
     while (std::getline(infile, line)){
       vector<string> tokens = s9::SplitStringWhitespace(line);
       if (tokens.size() > 5 ){
-        combine_file << tokens[0] << " ";
+        combine_file << tokens[0] << ' ';
       }
     }
     infile.close();
@@ -131,6 +153,98 @@ int combine_ukwac(vector<string> filenames, string outpath) {
 
 }
 
+/**
+ * Work out which words the -p and -h passes will want vectors for, the same way they do,
+ * so a targeted word vector count need only fill those rows. We use the verb lists counted
+ * earlier in this run if there are any, otherwise the ones in the working directory.
+ * @param options our WackyOptions
+ * @return a 1 or 0 for failure or success
+ */
+
+int find_target_words(WackyOptions & options) {
+  vector<VerbPair> verbs;
+  if (read_sim_file(options.simverb_file, verbs) != 0 ) { cout << "read sim file failed" << endl; return 1; }
+
+  TARGET_WORDS.clear();
+  if (options.verb_subject) {
+    generate_words_to_check(TARGET_WORDS, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, verbs, DICTIONARY_FAST);
+  } else {
+    vector< vector<int> > subjects (options.VOCAB_SIZE + 1);
+    vector< vector<int> > objects (options.VOCAB_SIZE + 1);
+    vector< vector<int> > sbj_obj (options.VOCAB_SIZE + 1);
+    if (read_subject_file(options.WORKING_DIR, subjects) != 0 ) { cout << "read subject file failed" << endl; return 1; }
+    if (read_subject_object_file(options.WORKING_DIR, sbj_obj) != 0 ) { cout << "read subject/object file failed" << endl; return 1; }
+    generate_words_to_check(TARGET_WORDS, sbj_obj, subjects, objects, verbs, DICTIONARY_FAST);
+  }
+
+  cout << "Targeting " << TARGET_WORDS.size() << " words" << endl;
+  return 0;
+}
+
+/**
+ * Run every create pass we've asked for in a single scan of the files, each sentence
+ * being read once and handed to all the passes that want it
+ * @param filenames the global vector of files
+ * @param options our WackyOptions
+ * @return a 1 or 0 for failure or success
+ */
+
+int run_pipeline(vector<string> filenames, WackyOptions & options) {
+  DependencyExtractor extractor (DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, options.UNIQUE_OBJECTS, options.UNIQUE_SUBJECTS, options.LEMMA_TIME);
+  IntegerWriter writer (options.WORKING_DIR, WORD_IGNORES, DICTIONARY_FAST, options.VOCAB_SIZE, options.LEMMA_TIME);
+  SparseCounts counts;
+  CooccurrenceCounter counter (DICTIONARY_FAST, BASIS_VECTOR, WORD_VECTORS, options.VOCAB_SIZE, options.BASIS_SIZE, options.WINDOW_SIZE, options.LEMMA_TIME, options.SPARSE ? &counts : NULL, options.TARGETED ? &TARGET_WORDS : NULL);
+  SimverbCounter simverbs (SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE, options.LEMMA_TIME);
+
+  vector<SentenceConsumer*> consumers;
+
+  if (options.verb_subject) {
+    consumers.push_back(&extractor);
+  }
+
+  if (options.integers) {
+    consumers.push_back(&writer);
+  }
+
+  if (options.word_vectors) {
+    if (options.TARGETED) {
+      // The targets come from the verb lists, which this scan would only now be counting
+      if (options.verb_subject) {
+        cout << "Targeted word vectors need the verb files from an earlier -b run" << endl;
+        return 1;
+      }
+      if (find_target_words(options) != 0) { return 1; }
+    }
+    create_basis(options.WORKING_DIR, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, BASIS_VECTOR, ALLOWED_BASIS_WORDS, INSIST_BASIS_WORDS, options.BASIS_SIZE, options.IGNORE_WINDOW);
+    if (options.SPARSE) {
+      sparse_counts_init(counts, options.VOCAB_SIZE + 1, options.BASIS_SIZE);
+    } else {
+      init_word_vectors(WORD_VECTORS, options.VOCAB_SIZE, options.BASIS_SIZE, options.TARGETED ? &TARGET_WORDS : NULL);
+    }
+    consumers.push_back(&counter);
+  }
+
+  if (options.sim_verbs) {
+    if (setup_simverbs(options.simverb_file, SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE) != 0) { return 1; }
+    consumers.push_back(&simverbs);
+  }
+
+  cout << "Running " << consumers.size() << " passes in one scan" << endl;
+  if (corpus_scan(filenames, consumers) != 0) { return 1; }
+
+  if (options.verb_subject && write_verb_subject_object(options.WORKING_DIR, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS) != 0) { return 1; }
+  if (options.word_vectors) {
+    if (options.SPARSE) {
+      SparseVectors sparse;
+      sparse_from_counts(counts, sparse);
+      if (write_word_vectors(options.WORKING_DIR, sparse, options.TARGETED ? &TARGET_WORDS : NULL) != 0) { return 1; }
+    } else if (write_word_vectors(options.WORKING_DIR, WORD_VECTORS, options.TARGETED ? &TARGET_WORDS : NULL) != 0) { return 1; }
+  }
+  if (options.sim_verbs && write_simverbs(options.WORKING_DIR, SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE) != 0) { return 1; }
+
+  return 0;
+}
+
 /**
  * Parse the command line options (of which there are many)
  * @param argc an int from main
@@ -142,7 +256,7 @@ void ParseCommandLine(int argc, char* argv[], WackyOptions &options) {
   int c;
   int digit_optind = 0;
 
-  while ((c = getopt(argc, (char **)argv, "u:o:v:ls:rc:g:e:j:f:biwnthyzpad?")) != -1) {
+  while ((c = getopt(argc, (char **)argv, "u:o:v:ls:rc:g:e:j:f:q:m:J:B:K:D:ZkxSTbiwnthyzpad?")) != -1) {
     int this_option_optind = optind ? optind : 1;
     switch (c) {
       case 0 :
@@ -196,6 +310,39 @@ void ParseCommandLine(int argc, char* argv[], WackyOptions &options) {
       case 'e':
         options.BASIS_SIZE = s9::FromString<int>(optarg);
         break;
+      case 'q':
+        options.CACHE_MB = s9::FromString<int>(optarg);
+        break;
+      case 'm':
+        options.CORPUS_DIR = string(optarg);
+        break;
+      case 'k':
+        options.corpus = true;
+        break;
+      case 'x':
+        options.pipeline = true;
+        break;
+      case 'J':
+        options.REPORT_FILE = string(optarg);
+        break;
+      case 'B':
+        options.FREQ_CAPACITY = s9::FromString<size_t>(optarg);
+        break;
+      case 'K':
+        options.SKETCH.epsilon = s9::FromString<float>(optarg);
+        break;
+      case 'D':
+        options.SKETCH.delta = s9::FromString<float>(optarg);
+        break;
+      case 'Z':
+        options.SKETCH.only = true;
+        break;
+      case 'S':
+        options.SPARSE = true;
+        break;
+      case 'T':
+        options.TARGETED = true;
+        break;
       case 'g':
         options.IGNORE_WINDOW = s9::FromString<int>(optarg);
         break;
@@ -237,6 +384,11 @@ int main(int argc, char* argv[]) {
   options.count = false;
   options.intransitive = false;
   options.transitive = false;
+  options.variance = false;
+  options.corpus = false;
+  options.pipeline = false;
+  options.SPARSE = false;
+  options.TARGETED = false;
   options.ukdir = ".";
 
   options.UNK_COUNT = 0;
@@ -249,11 +401,17 @@ int main(int argc, char* argv[]) {
   options.WINDOW_SIZE = 5;
   options.UNIQUE_SUBJECTS = false;
   options.UNIQUE_OBJECTS = false;
+  options.CACHE_MB = VERB_CACHE_MB;
+  options.FREQ_CAPACITY = 0;
 
   options.RESULTS_FILE = "results.txt";
+  options.CORPUS_DIR = "";
+  options.REPORT_FILE = "";
 
   ParseCommandLine(argc, argv, options);
 
+  if (!options.REPORT_FILE.empty()) { stats_init(options.REPORT_FILE, argc, argv); }
+
   vector<string> filenames;
   
   // Scan directory for the ukwac files
@@ -277,10 +435,27 @@ int main(int argc, char* argv[]) {
     cout << "Incorrect command line argument for directory" << endl;
     return 1;
   }
+
+  // Are we converting ukwac to the binary corpus first?
+  if (options.corpus) {
+    StatsStage stage ("corpus");
+    if (options.CORPUS_DIR.empty()) { options.CORPUS_DIR = options.WORKING_DIR + "/corpus"; }
+    if (create_corpus(filenames, options.CORPUS_DIR) != 0) { cout << "Creating the corpus failed" << endl; return 1; }
+  }
+
+  // Every pass after this can run straight off the binary corpus
+  if (!options.CORPUS_DIR.empty()) {
+    filenames = corpus_filenames(options.CORPUS_DIR);
+    if (filenames.empty()) {
+      cout << "No corpus files found in " << options.CORPUS_DIR << endl;
+      return 1;
+    }
+  }
  
 
   // Are we reading in the existing dictionary, frequency and such
   if (options.read_in){
+    StatsStage stage ("read_in");
     cout << "Reading in dictionary and frequency data" << endl;
     read_freq(options.WORKING_DIR, FREQ, FREQ_FLIPPED, ALLOWED_BASIS_WORDS);
     read_dictionary(options.WORKING_DIR, DICTIONARY_FAST, DICTIONARY, options.VOCAB_SIZE);
@@ -289,8 +464,9 @@ int main(int argc, char* argv[]) {
     //create_basis(options.WORKING_DIR, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, BASIS_VECTOR, ALLOWED_BASIS_WORDS, INSIST_BASIS_WORDS, options.BASIS_SIZE, options.IGNORE_WINDOW);
 
   } else {
+    StatsStage stage ("freq");
     cout << "Creating frequency and dictionary" << endl;
-    if (create_freq(filenames, options.WORKING_DIR,FREQ, FREQ_FLIPPED, WORD_IGNORES, ALLOWED_BASIS_WORDS, options.LEMMA_TIME) != 0)  { return 1; }    
+    if (create_freq(filenames, options.WORKING_DIR,FREQ, FREQ_FLIPPED, WORD_IGNORES, ALLOWED_BASIS_WORDS, options.LEMMA_TIME, options.FREQ_CAPACITY) != 0)  { return 1; }    
     if (create_dictionary(options.WORKING_DIR, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, options.VOCAB_SIZE) != 0) { return 1; }
   }
   
@@ -312,6 +488,7 @@ int main(int argc, char* argv[]) {
 
   // Are we creating the verb subject/object vectors?
   if (options.count) {
+    StatsStage stage ("count");
     if (options.read_in) { 
       cout << "Performing statistics on count vectors" << endl;
       cout << "Reading in dictionary and frequency data" << endl;
@@ -322,8 +499,8 @@ int main(int argc, char* argv[]) {
       if (read_subject_file(options.WORKING_DIR, VERB_SUBJECTS) != 0 ) { cout << "read subject file failed" << endl; return 1; }
       if (options.intransitive){   
         generate_words_to_check(WORDS_TO_CHECK, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, VERBS_TO_CHECK,DICTIONARY_FAST );
-        if (read_count(options.WORKING_DIR, FREQ, DICTIONARY, BASIS_VECTOR, WORD_VECTORS, options.TOTAL_COUNT, WORDS_TO_CHECK) != 0 ) { cout << "read count file failed" << endl; return 1; }
-        intrans_count( options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS);
+        if (read_count(options.WORKING_DIR, FREQ, DICTIONARY, BASIS_VECTOR, CHECK_VECTORS, options.TOTAL_COUNT, WORDS_TO_CHECK) != 0 ) { cout << "read count file failed" << endl; return 1; }
+        intrans_count( options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SUBJECTS, CHECK_VECTORS, options.CACHE_MB, options.SKETCH);
 
       } else if (options.transitive) {
         if (read_subject_file(options.WORKING_DIR, VERB_SUBJECTS) != 0 ) { cout << "read subject file failed" << endl; return 1; }
@@ -331,18 +508,18 @@ int main(int argc, char* argv[]) {
 
         generate_words_to_check(WORDS_TO_CHECK, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, VERBS_TO_CHECK,DICTIONARY_FAST );
 
-        if (read_count(options.WORKING_DIR, FREQ, DICTIONARY, BASIS_VECTOR, WORD_VECTORS, options.TOTAL_COUNT, WORDS_TO_CHECK) != 0 ) { cout << "read count file failed" << endl; return 1; }
-        trans_count( options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS);
+        if (read_count(options.WORKING_DIR, FREQ, DICTIONARY, BASIS_VECTOR, CHECK_VECTORS, options.TOTAL_COUNT, WORDS_TO_CHECK) != 0 ) { cout << "read count file failed" << endl; return 1; }
+        trans_count( options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, CHECK_VECTORS, options.CACHE_MB, options.SKETCH);
       } else {
          if(read_subject_object_file(options.WORKING_DIR, VERB_SBJ_OBJ) != 0 ) { cout << "read subject/object file failed" << endl; return 1; }
 
         generate_words_to_check(WORDS_TO_CHECK, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, VERBS_TO_CHECK,DICTIONARY_FAST );
-        if (read_count(options.WORKING_DIR, FREQ, DICTIONARY, BASIS_VECTOR, WORD_VECTORS, options.TOTAL_COUNT, WORDS_TO_CHECK)  != 0 ) { cout << "read count file failed" << endl; return 1; }
+        if (read_count(options.WORKING_DIR, FREQ, DICTIONARY, BASIS_VECTOR, CHECK_VECTORS, options.TOTAL_COUNT, WORDS_TO_CHECK)  != 0 ) { cout << "read count file failed" << endl; return 1; }
 
 #ifdef _USE_CUDA
-        all_count_cuda(options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, WORD_VECTORS);
+        all_count_cuda(options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, CHECK_VECTORS);
 #else
-        all_count(options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, WORD_VECTORS);
+        all_count(options.RESULTS_FILE, VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, CHECK_VECTORS, options.CACHE_MB, options.SKETCH);
 #endif
       }
 
@@ -354,40 +531,55 @@ int main(int argc, char* argv[]) {
 
   // Are we combining files?
   if (options.combine) {
+    StatsStage stage ("combine");
     cout << "Combining ukwac into a large file of text" << endl;
     combine_ukwac(filenames, options.combine_file);
     return 0;
   }
  
+  // Are we running the create passes together in one scan?
+  if (options.pipeline && (options.verb_subject || options.integers || options.word_vectors || options.sim_verbs)) {
+    StatsStage stage ("pipeline");
+    cout << "Creating outputs in a single pass" << endl;
+    if (run_pipeline(filenames, options) != 0) { return 1; }
+    options.verb_subject = options.integers = options.word_vectors = options.sim_verbs = false;
+  }
+ 
   // Are we creating our verb subject and object files
   if (options.verb_subject) {
+    StatsStage stage ("verb_subject");
     cout << "Create verb subjects and objects" << endl; 
     if (create_verb_subject_object(filenames, options.WORKING_DIR, DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, options.UNIQUE_OBJECTS, options.UNIQUE_SUBJECTS, options.LEMMA_TIME ) != 0)  { return 1; }
   }
   
   // Are we converting words to numbers for tensorflow?
   if (options.integers) {
+    StatsStage stage ("integers");
     cout << "Create integer files" << endl;
     if (create_integers(filenames, options.WORKING_DIR, WORD_IGNORES, DICTIONARY_FAST, options.VOCAB_SIZE, options.LEMMA_TIME) != 0) { return 1; }
   }
 
   // Are we creating our word vectors?
   if (options.word_vectors){
+    StatsStage stage ("word_vectors");
     cout << "Creating word vectors" << endl;
+    if (options.TARGETED && find_target_words(options) != 0) { return 1; }
     create_basis(options.WORKING_DIR, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, BASIS_VECTOR, ALLOWED_BASIS_WORDS, INSIST_BASIS_WORDS, options.BASIS_SIZE, options.IGNORE_WINDOW);
 
 
-    if (create_word_vectors(filenames, options.WORKING_DIR, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, BASIS_VECTOR, WORD_IGNORES, WORD_VECTORS, ALLOWED_BASIS_WORDS, options.VOCAB_SIZE, options.BASIS_SIZE, options.WINDOW_SIZE, options.LEMMA_TIME) != 0)  { return 1; }
+    if (create_word_vectors(filenames, options.WORKING_DIR, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, BASIS_VECTOR, WORD_IGNORES, WORD_VECTORS, ALLOWED_BASIS_WORDS, options.VOCAB_SIZE, options.BASIS_SIZE, options.WINDOW_SIZE, options.LEMMA_TIME, options.SPARSE, options.TARGETED ? &TARGET_WORDS : NULL) != 0)  { return 1; }
   }
   
   // Are we creating the sim verbs file?
   if (options.sim_verbs) {
+    StatsStage stage ("sim_verbs");
     cout << "Creating simverbs" << endl;
     if (create_simverbs(filenames, options.simverb_file, options.WORKING_DIR, SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE, options.LEMMA_TIME ) !=0)  { return 1; }
   }
 
   // Are we analyising the variance of the word vector verb distances?
   if (options.variance) {
+    StatsStage stage ("variance");
 
     if (options.read_in) {
       cout << "Analysing variance for each verb" << endl;
@@ -400,9 +592,9 @@ int main(int argc, char* argv[]) {
        if(read_subject_object_file(options.WORKING_DIR, VERB_SBJ_OBJ) != 0 ) { cout << "read subject/object file failed" << endl; return 1; }
 
       generate_words_to_check(WORDS_TO_CHECK, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, VERBS_TO_CHECK,DICTIONARY_FAST );
-      if (read_count_raw(options.WORKING_DIR, DICTIONARY, BASIS_VECTOR, WORD_VECTORS, WORDS_TO_CHECK)  != 0 ) { cout << "read count file failed" << endl; return 1; }
+      if (read_count_raw(options.WORKING_DIR, DICTIONARY, BASIS_VECTOR, CHECK_VECTORS, WORDS_TO_CHECK)  != 0 ) { cout << "read count file failed" << endl; return 1; }
       
-       variance_count(options.RESULTS_FILE, VERBS_TO_CHECK, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS);
+       variance_count(options.RESULTS_FILE, VERBS_TO_CHECK, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, CHECK_VECTORS);
     }
   }
   return 0;
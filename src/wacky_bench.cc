@@ -1,5 +1,5 @@
 /**
-* @brief A little bit of benchmarking
+* @brief Benchmark every stage of the pipeline on a synthetic corpus
 * @file wacky_bench.cc
 * @author Benjamin Blundell <oni@section9.co.uk>
 * @date 14/02/2017
@@ -17,8 +17,8 @@
 #include <omp.h>
 #include <deque>
 #include <getopt.h>
-#include <time.h>
 
+#include <boost/filesystem.hpp>
 
 #ifdef _USE_MKL
 #include "wacky_sbj_obj_mkl.hpp"
@@ -27,71 +27,278 @@
 #endif
 
 #include "string_utils.hpp"
+#include "wacky_create.hpp"
+#include "wacky_read.hpp"
+#include "wacky_verb.hpp"
+#include "wacky_stats.hpp"
+#include "wacky_synth.hpp"
 
 using namespace std;
 
+// Our list of options
+struct BenchOptions {
+  SynthOptions synth;
+  string WORKING_DIR;     // Where the corpus and everything made from it goes
+  string REPORT_FILE;     // The JSON report, WORKING_DIR/bench.json unless we say
+  size_t NUM_PAIRS;       // How many verb pairs the three models compare
+  size_t VOCAB_SIZE;
+  size_t BASIS_SIZE;
+  size_t WINDOW_SIZE;
+  size_t IGNORE_WINDOW;
+  size_t CACHE_MB;
+  size_t FREQ_CAPACITY;   // If not 0, count frequencies in bounded memory as -B does
+  SketchOptions SKETCH;   // Sketched Kronecker similarities as -K, -D and -Z do
+  int KRN_ITERATIONS;     // How many krn_mul calls to time on their own
+};
+
 #ifdef _USE_MKL
 
-int main(int argc, char* argv[]) {
+/**
+ * Time krn_mul on its own, on two vectors of the basis size
+ * @param ss the vector size
+ * @param iterations how many calls
+ */
 
-  time_t start,end;
-  size_t ss = 5000;
-  double dif;
-  
-  time(&start);
- 
+void bench_krn_mul(size_t ss, int iterations) {
   vector<float> tk (ss * ss);
-  
-  for (int i = 0; i < 1000; ++i) {
-    vector<float> krn_vector0 (ss);
-    vector<float> krn_vector1 (ss);
-  
-    for (int j=0; j < ss; ++j){
-      krn_vector0[j] = 2.0f;
-      krn_vector1[j] = 2.0f;
-    }
+  vector<float> krn_vector0 (ss, 2.0f);
+  vector<float> krn_vector1 (ss, 2.0f);
 
+  for (int i = 0; i < iterations; ++i) {
     krn_mul(krn_vector0, krn_vector1, tk);
+    stats_step();
   }
-  time(&end);
+  cout << "krn_mul " << tk[0] << endl;
+}
 
-  dif = difftime (end,start);
-  printf("%f",dif);
- 
-  cout << endl;
+#else
 
-  MKL_INT n = ss * ss;
-  vsAdd(n,&tk[0],&tk[0],&tk[0]); 
+using namespace boost::numeric;
 
-  cout << tk[0] << endl;
+void bench_krn_mul(size_t ss, int iterations) {
+  ublas::vector<float> krn_vector0 (ss);
+  ublas::vector<float> krn_vector1 (ss);
+  for (int j=0; j < ss; ++j){
+    krn_vector0 (j) = krn_vector1(j) = 1.0f;
+  }
 
+  float total = 0;
+  for (int i = 0; i < iterations; ++i) {
+    ublas::vector<float> tk = krn_mul(krn_vector0, krn_vector1);
+    total += tk(0);
+    stats_step();
+  }
+  cout << "krn_mul " << total << endl;
 }
 
-#else
+#endif
 
-using namespace boost::numeric;
+/**
+ * Parse the command line options
+ * @param argc an int from main
+ * @param argv an array of char from main
+ * @param options a reference to a BenchOptions struct which we will set here
+ */
 
-int main(int argc, char* argv[]) {
+void ParseCommandLine(int argc, char* argv[], BenchOptions &options) {
+  int c;
 
-  time_t start,end;
-  size_t ss = 5000;
-  double dif;
-  
-  time(&start);
-  for (int i = 0; i < 1000; ++i) {
-    ublas::vector<float> krn_vector0 (ss);
-    ublas::vector<float> krn_vector1 (ss);
-  
-    for (int j=0; j < ss; ++j){
-      krn_vector0 (j) = krn_vector1(j) = 1.0f;
+  while ((c = getopt(argc, (char **)argv, "o:J:t:f:n:b:a:z:m:s:p:v:e:j:g:q:k:B:K:D:Z?")) != -1) {
+    switch (c) {
+      case 'o' :
+        options.WORKING_DIR = string(optarg);
+        break;
+      case 'J' :
+        options.REPORT_FILE = string(optarg);
+        break;
+      case 't' :
+        options.synth.num_tokens = s9::FromString<size_t>(optarg);
+        break;
+      case 'f' :
+        options.synth.num_files = s9::FromString<size_t>(optarg);
+        break;
+      case 'n' :
+        options.synth.num_nouns = s9::FromString<size_t>(optarg);
+        break;
+      case 'b' :
+        options.synth.num_verbs = s9::FromString<size_t>(optarg);
+        break;
+      case 'a' :
+        options.synth.num_adjectives = s9::FromString<size_t>(optarg);
+        break;
+      case 'z' :
+        options.synth.zipf = s9::FromString<double>(optarg);
+        break;
+      case 'm' :
+        options.synth.mean_sentence = s9::FromString<double>(optarg);
+        break;
+      case 's' :
+        options.synth.seed = s9::FromString<uint32_t>(optarg);
+        break;
+      case 'p' :
+        options.NUM_PAIRS = s9::FromString<size_t>(optarg);
+        break;
+      case 'v' :
+        options.VOCAB_SIZE = s9::FromString<size_t>(optarg);
+        break;
+      case 'e' :
+        options.BASIS_SIZE = s9::FromString<size_t>(optarg);
+        break;
+      case 'j' :
+        options.WINDOW_SIZE = s9::FromString<size_t>(optarg);
+        break;
+      case 'g' :
+        options.IGNORE_WINDOW = s9::FromString<size_t>(optarg);
+        break;
+      case 'q' :
+        options.CACHE_MB = s9::FromString<size_t>(optarg);
+        break;
+      case 'k' :
+        options.KRN_ITERATIONS = s9::FromString<int>(optarg);
+        break;
+      case 'B' :
+        options.FREQ_CAPACITY = s9::FromString<size_t>(optarg);
+        break;
+      case 'K' :
+        options.SKETCH.epsilon = s9::FromString<float>(optarg);
+        break;
+      case 'D' :
+        options.SKETCH.delta = s9::FromString<float>(optarg);
+        break;
+      case 'Z' :
+        options.SKETCH.only = true;
+        break;
+      case '?':
+        std::cout << "wacky_bench -o <output directory> -t <tokens> -f <files> -J <report.json>" << std::endl;
+        break;
+      default:
+        std::cout << "?? getopt returned character code" << c << std::endl;
     }
+  }
+}
 
-    ublas::vector<float> tk = krn_mul(krn_vector0, krn_vector1);
+// Main entrypoint
+int main(int argc, char* argv[]) {
+
+  BenchOptions options;
+  options.WORKING_DIR = "./bench";
+  options.REPORT_FILE = "";
+  options.NUM_PAIRS = 100;
+  options.VOCAB_SIZE = 10000;
+  options.BASIS_SIZE = 300;
+  options.WINDOW_SIZE = 5;
+  options.IGNORE_WINDOW = 100;
+  options.CACHE_MB = VERB_CACHE_MB;
+  options.FREQ_CAPACITY = 0;
+  options.KRN_ITERATIONS = 100;
+
+  ParseCommandLine(argc, argv, options);
+
+  boost::filesystem::create_directories(options.WORKING_DIR);
+  if (options.REPORT_FILE.empty()) { options.REPORT_FILE = options.WORKING_DIR + "/bench.json"; }
+  stats_init(options.REPORT_FILE, argc, argv);
+
+  string dir = options.WORKING_DIR;
+  string corpus_dir = dir + "/ukwac";
+  string simverb_file = dir + "/simverb.txt";
+  boost::filesystem::create_directories(corpus_dir);
+
+  map<string, size_t> FREQ;
+  vector< pair<string,size_t> > FREQ_FLIPPED;
+  set<string> WORD_IGNORES {",","-",".","@card@", "<text","<s>xt","</s>SENT", "<s>>SENT", "<s>", "</s>", "<text>", "</text>"};
+  Dictionary DICTIONARY_FAST;
+  vector<string> DICTIONARY;
+  set<string> ALLOWED_BASIS_WORDS;
+  set<string> INSIST_BASIS_WORDS;
+  vector< vector<int> > VERB_SUBJECTS;
+  vector< vector<int> > VERB_OBJECTS;
+  vector< vector<int> > VERB_SBJ_OBJ;
+  vector< vector<float> > WORD_VECTORS;
+  SparseVectors CHECK_VECTORS;
+  vector<int> BASIS_VECTOR;
+  vector<string> SIMVERBS;
+  vector<int> SIMVERBS_COUNT;
+  vector<int> SIMVERBS_OBJECTS;
+  vector<int> SIMVERBS_ALONE;
+  set<string> VERB_TRANSITIVE;
+  set<string> VERB_INTRANSITIVE;
+  set<int> WORDS_TO_CHECK;
+  vector<VerbPair> VERBS_TO_CHECK;
+  size_t TOTAL_COUNT = 0;
+
+  vector<string> filenames;
+
+  {
+    StatsStage stage ("generate");
+    SynthCounts counts;
+    if (synth_corpus(corpus_dir, options.synth, filenames, counts) != 0) { return 1; }
+    if (synth_simverbs(simverb_file, options.synth, options.NUM_PAIRS) != 0) { return 1; }
+    stats_count(counts.bytes, counts.sentences, counts.tokens);
+    cout << "Generated " << counts.tokens << " tokens in " << counts.sentences << " sentences" << endl;
+  }
+
+  {
+    StatsStage stage ("freq");
+    if (create_freq(filenames, dir, FREQ, FREQ_FLIPPED, WORD_IGNORES, ALLOWED_BASIS_WORDS, true, options.FREQ_CAPACITY) != 0) { return 1; }
+  }
+
+  {
+    StatsStage stage ("dictionary");
+    if (create_dictionary(dir, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, options.VOCAB_SIZE) != 0) { return 1; }
+  }
+
+  VERB_SUBJECTS.assign(options.VOCAB_SIZE + 1, vector<int>());
+  VERB_OBJECTS.assign(options.VOCAB_SIZE + 1, vector<int>());
+  VERB_SBJ_OBJ.assign(options.VOCAB_SIZE + 1, vector<int>());
+
+  {
+    StatsStage stage ("verb_subject");
+    if (create_verb_subject_object(filenames, dir, DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, false, false, true) != 0) { return 1; }
+  }
+
+  {
+    StatsStage stage ("integers");
+    if (create_integers(filenames, dir, WORD_IGNORES, DICTIONARY_FAST, options.VOCAB_SIZE, true) != 0) { return 1; }
+  }
+
+  {
+    StatsStage stage ("word_vectors");
+    create_basis(dir, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, BASIS_VECTOR, ALLOWED_BASIS_WORDS, INSIST_BASIS_WORDS, options.BASIS_SIZE, options.IGNORE_WINDOW);
+    if (create_word_vectors(filenames, dir, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, BASIS_VECTOR, WORD_IGNORES, WORD_VECTORS, ALLOWED_BASIS_WORDS, options.VOCAB_SIZE, options.BASIS_SIZE, options.WINDOW_SIZE, true) != 0) { return 1; }
   }
-  time(&end);
 
-  dif = difftime (end,start);
-  printf("%f",dif);
+  {
+    StatsStage stage ("sim_verbs");
+    if (create_simverbs(filenames, simverb_file, dir, SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE, true) != 0) { return 1; }
+  }
+
+  // Read back what the create passes wrote, as a -p run would
+  {
+    StatsStage stage ("read_count");
+    VERB_SUBJECTS.assign(options.VOCAB_SIZE + 1, vector<int>());
+    VERB_OBJECTS.assign(options.VOCAB_SIZE + 1, vector<int>());
+    VERB_SBJ_OBJ.assign(options.VOCAB_SIZE + 1, vector<int>());
+    WORD_VECTORS.clear();
 
+    if (read_total_file(dir, TOTAL_COUNT) != 0 ) { cout << "read total file failed" << endl; return 1; }
+    if (read_sim_file(simverb_file, VERBS_TO_CHECK) != 0 ) { cout << "read sim file failed" << endl; return 1; }
+    if (read_sim_stats(dir, VERB_TRANSITIVE, VERB_INTRANSITIVE) != 0 ) { cout << "read sim_stats file failed" << endl; return 1; }
+    if (read_subject_file(dir, VERB_SUBJECTS) != 0 ) { cout << "read subject file failed" << endl; return 1; }
+    if (read_subject_object_file(dir, VERB_SBJ_OBJ) != 0 ) { cout << "read subject/object file failed" << endl; return 1; }
+    generate_words_to_check(WORDS_TO_CHECK, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, VERBS_TO_CHECK, DICTIONARY_FAST);
+    if (read_count(dir, FREQ, DICTIONARY, BASIS_VECTOR, CHECK_VECTORS, TOTAL_COUNT, WORDS_TO_CHECK) != 0 ) { cout << "read count file failed" << endl; return 1; }
+  }
+
+  // Each model times itself
+  intrans_count(dir + "/results_intrans.csv", VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SUBJECTS, CHECK_VECTORS, options.CACHE_MB, options.SKETCH);
+  trans_count(dir + "/results_trans.csv", VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, CHECK_VECTORS, options.CACHE_MB, options.SKETCH);
+  all_count(dir + "/results_all.csv", VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, options.BASIS_SIZE, DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, CHECK_VECTORS, options.CACHE_MB, options.SKETCH);
+
+  if (options.KRN_ITERATIONS > 0) {
+    StatsStage stage ("krn_mul");
+    stats_total(options.KRN_ITERATIONS);
+    bench_krn_mul(options.BASIS_SIZE, options.KRN_ITERATIONS);
+  }
+
+  return 0;
 }
-#endif
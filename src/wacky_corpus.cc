@@ -0,0 +1,590 @@
+/**
+* @brief Converting ukWaC to our binary columnar format and reading it back
+* @file wacky_corpus.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_corpus.hpp"
+#include "wacky_stats.hpp"
+#include "wacky_misc.hpp"
+
+#include <cstring>
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <unordered_map>
+#include <omp.h>
+
+using namespace boost::filesystem;
+using namespace boost::interprocess;
+using namespace std;
+
+/**
+ * Is this path one of our converted files?
+ * @param path the path to a file
+ * @return true if it ends in CORPUS_EXTENSION
+ */
+
+bool corpus_file(const string & path) {
+  string ext (CORPUS_EXTENSION);
+  return path.size() > ext.size() && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+/**
+ * The name of the original ukwac file a converted file came from
+ * @param path the path to the converted file
+ * @return the file name without the directory or CORPUS_EXTENSION
+ */
+
+string corpus_source_name(const string & path) {
+  string name = s9::FilenameFromPath(path);
+  if (corpus_file(name)) {
+    name = name.substr(0, name.size() - string(CORPUS_EXTENSION).size());
+  }
+  return name;
+}
+
+/**
+ * List all the converted files in a directory
+ * @param CORPUS_DIR the directory create_corpus wrote to
+ * @return a sorted vector of paths
+ */
+
+vector<string> corpus_filenames(string CORPUS_DIR) {
+  vector<string> filenames;
+
+  if (!is_directory(CORPUS_DIR)) {
+    return filenames;
+  }
+
+  for (directory_iterator it (CORPUS_DIR); it != directory_iterator(); ++it) {
+    string fullpath = it->path().string();
+    if (corpus_file(fullpath)) {
+      filenames.push_back(fullpath);
+    }
+  }
+
+  std::sort(filenames.begin(), filenames.end());
+  return filenames;
+}
+
+//! One run of a text file, parsed with its own string table so the threads needn't share one
+struct ParseBlock {
+  const char * start;
+  const char * end;
+  std::vector<std::string> strings;
+  std::vector<int32_t> cols[6];
+  std::vector<uint64_t> ends;
+};
+
+/**
+ * Does this line close a sentence? These are the lines starting with </s>
+ * @param line a line of a ukwac file
+ * @return true if the first field contains </s>
+ */
+
+static inline bool closes_sentence(s9::StringRef line) {
+  s9::StringRef first;
+  return s9::SplitFieldsWhitespace(line, &first, 1) > 0 && s9::FieldContains(first, "</s>");
+}
+
+/**
+ * Find where a block should start so no sentence is split between two blocks. We go back to
+ * the start of the line we landed in, then on past the next line that closes a sentence.
+ * @param guess roughly where we want the block to start
+ * @param from the start of the block before, which we won't go back past
+ * @param end the end of the file
+ * @return the start of the block, or end if no sentence closes after guess
+ */
+
+static const char * parse_block_start(const char * guess, const char * from, const char * end) {
+  while (guess > from && guess[-1] != '\n') { guess--; }
+
+  s9::StringRef line;
+  while (s9::NextLine(guess, end, line)) {
+    if (closes_sentence(line)) { return guess; }
+  }
+  return end;
+}
+
+/**
+ * Parse one block of a text file. Every line with at least six columns becomes a token and
+ * every line starting with </s> closes a sentence.
+ * @param block the ParseBlock to fill, with start and end set
+ */
+
+static void parse_block(ParseBlock & block) {
+  unordered_map<string, int32_t> string_idx;
+  vector<int32_t> * cols = block.cols;
+
+  string key;
+  auto intern = [&](s9::StringRef s) -> int32_t {
+    key.assign(s.data(), s.size());
+    auto it = string_idx.find(key);
+    if (it != string_idx.end()) { return it->second; }
+    int32_t idx = static_cast<int32_t>(block.strings.size());
+    string_idx[key] = idx;
+    block.strings.push_back(key);
+    return idx;
+  };
+
+  const char * mem = block.start;
+  s9::StringRef line;
+  s9::StringRef tokens[6];
+
+  while (s9::NextLine(mem, block.end, line)) {
+    size_t num_tokens = s9::SplitFieldsWhitespace(line, tokens, 6);
+
+    if (num_tokens > 5) {
+      cols[0].push_back(intern(tokens[0]));
+      cols[1].push_back(intern(tokens[1]));
+      cols[2].push_back(intern(tokens[2]));
+      cols[3].push_back(s9::ParseInt(tokens[3]));
+      cols[4].push_back(s9::ParseInt(tokens[4]));
+      cols[5].push_back(intern(tokens[5]));
+    }
+
+    if (num_tokens > 0 && s9::FieldContains(tokens[0], "</s>")) {
+      block.ends.push_back(cols[0].size());
+    }
+  }
+}
+
+/**
+ * Parse one ukwac file into our columns. Every line with at least six columns
+ * becomes a token and every line starting with </s> closes a sentence. The file is cut
+ * into a block per thread at sentence ends and the blocks parsed at once. Their string
+ * tables are then joined in file order, so the strings get the same numbers they would
+ * reading the file straight through.
+ * @param filepath the ukwac file
+ * @param data the CorpusData to fill
+ * @param block_bytes the smallest block worth giving a thread of its own
+ * @return int a value to say if we succeeded or not
+ */
+
+int corpus_parse_text(string filepath, CorpusData & data, size_t block_bytes) {
+  boost::system::error_code ec;
+  uintmax_t size = file_size(filepath, ec);
+  if (ec) {
+    cout << "Unable to open " << filepath << " for reading" << endl;
+    return 1;
+  }
+
+  // An empty file can't be mapped, but it is still an empty corpus
+  file_mapping file;
+  mapped_region region;
+  if (size > 0) {
+    try {
+      file_mapping f (filepath.c_str(), read_only);
+      mapped_region r (f, read_only);
+      file.swap(f);
+      region.swap(r);
+    } catch (interprocess_exception &ex) {
+      cout << "Unable to map " << filepath << ": " << ex.what() << endl;
+      return 1;
+    }
+  }
+
+  const char * mem = static_cast<const char*>(region.get_address());
+  const char * mem_end = mem + region.get_size();
+
+  size_t num_blocks = region.get_size() / std::max(block_bytes, static_cast<size_t>(1));
+  num_blocks = std::max(static_cast<size_t>(1), std::min(num_blocks, static_cast<size_t>(omp_get_max_threads())));
+  vector<ParseBlock> blocks (num_blocks);
+
+  blocks[0].start = mem;
+  for (size_t b = 1; b < num_blocks; ++b) {
+    const char * guess = std::max(blocks[b-1].start, mem + region.get_size() * b / num_blocks);
+    blocks[b].start = parse_block_start(guess, blocks[b-1].start, mem_end);
+    blocks[b-1].end = blocks[b].start;
+  }
+  blocks[num_blocks-1].end = mem_end;
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (long b = 0; b < num_blocks; ++b) {
+    parse_block(blocks[b]);
+  }
+
+  // Number the strings in the order the file first uses them
+  unordered_map<string, int32_t> string_idx;
+  vector<string> strings;
+  vector< vector<int32_t> > remap (num_blocks);
+  vector<size_t> base (num_blocks + 1, 0);
+
+  for (size_t b = 0; b < num_blocks; ++b) {
+    for (string & s : blocks[b].strings) {
+      auto it = string_idx.find(s);
+      if (it == string_idx.end()) {
+        it = string_idx.insert(make_pair(s, static_cast<int32_t>(strings.size()))).first;
+        strings.push_back(std::move(s));
+      }
+      remap[b].push_back(it->second);
+    }
+    blocks[b].strings.clear();
+    base[b+1] = base[b] + blocks[b].cols[0].size();
+  }
+
+  vector<int32_t> * cols = data.cols;
+  for (int c = 0; c < 6; ++c) { cols[c].resize(base[num_blocks]); }
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (long b = 0; b < num_blocks; ++b) {
+    ParseBlock & block = blocks[b];
+    for (int c = 0; c < 6; ++c) {
+      bool text = c != 3 && c != 4;
+      for (size_t i = 0; i < block.cols[c].size(); ++i) {
+        cols[c][base[b] + i] = text ? remap[b][block.cols[c][i]] : block.cols[c][i];
+      }
+      vector<int32_t> ().swap(block.cols[c]);
+    }
+  }
+
+  vector<uint64_t> & sentences = data.sentences;
+  sentences.clear();
+  sentences.push_back(0);
+  for (size_t b = 0; b < num_blocks; ++b) {
+    for (uint64_t e : blocks[b].ends) {
+      sentences.push_back(base[b] + e);
+    }
+  }
+
+  // Anything after the last </s> still gets its own sentence
+  if (sentences.back() != cols[0].size()) {
+    sentences.push_back(cols[0].size());
+  }
+
+  data.strings.clear();
+  data.string_data.clear();
+  for (const string & s : strings) {
+    data.strings.push_back(data.string_data.size());
+    data.string_data += s;
+  }
+  data.strings.push_back(data.string_data.size());
+
+  CorpusHeader & header = data.header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "WBC1", 4);
+  header.version = CORPUS_VERSION;
+  header.num_tokens = cols[0].size();
+  header.num_sentences = sentences.size() - 1;
+  header.num_strings = strings.size();
+  header.string_bytes = data.string_data.size();
+
+  return 0;
+}
+
+/**
+ * Point a Corpus at data we parsed ourselves, so the passes can't tell it wasn't mapped
+ * @param data the parsed CorpusData, which must outlive the Corpus
+ * @param corpus the Corpus to fill in
+ */
+
+void corpus_view(const CorpusData & data, Corpus & corpus) {
+  static const int32_t empty = 0;
+  const int32_t ** cols[6] = { &corpus.word, &corpus.lemma, &corpus.pos, &corpus.id, &corpus.head, &corpus.deprel };
+
+  corpus.header = &data.header;
+  corpus.sentences = &data.sentences[0];
+  corpus.strings = &data.strings[0];
+  for (int c = 0; c < 6; ++c) {
+    *cols[c] = data.cols[c].empty() ? &empty : &data.cols[c][0];
+  }
+  corpus.string_data = data.string_data.data();
+}
+
+/**
+ * Convert one ukwac file into our binary format
+ * @param filepath the ukwac file
+ * @param outpath the file to write
+ * @return int a value to say if we succeeded or not
+ */
+
+int create_corpus_file(string filepath, string outpath) {
+  CorpusData data;
+  if (corpus_parse_text(filepath, data) != 0) {
+    return 1;
+  }
+
+  std::ofstream out (outpath, std::ios::binary);
+  if (!out.is_open()) {
+    cout << "Unable to open " << outpath << " for writing" << endl;
+    return 1;
+  }
+
+  write_padded(out, &data.header, sizeof(CorpusHeader));
+  write_padded(out, &data.sentences[0], data.sentences.size() * sizeof(uint64_t));
+  write_padded(out, &data.strings[0], data.strings.size() * sizeof(uint64_t));
+  for (int c = 0; c < 6; ++c) {
+    write_padded(out, data.cols[c].empty() ? NULL : &data.cols[c][0], data.cols[c].size() * sizeof(int32_t));
+  }
+  write_padded(out, data.string_data.data(), data.string_data.size());
+  out.close();
+
+  return out.fail() ? 1 : 0;
+}
+
+/**
+ * Convert all of the ukwac files, one output file per input file
+ * @param filenames the list of ukwac files
+ * @param CORPUS_DIR where the converted files go
+ * @return int a value to say if we succeeded or not
+ */
+
+int create_corpus(vector<string> filenames, string CORPUS_DIR) {
+  cout << "Creating binary corpus in " << CORPUS_DIR << endl;
+
+  create_directories(CORPUS_DIR);
+  int failed = 0;
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int i = 0; i < filenames.size(); ++i) {
+    string outpath = CORPUS_DIR + "/" + s9::FilenameFromPath(filenames[i]) + CORPUS_EXTENSION;
+    if (create_corpus_file(filenames[i], outpath) != 0) {
+      #pragma omp atomic
+      failed++;
+    }
+  }
+
+  return failed == 0 ? 0 : 1;
+}
+
+/**
+ * Map a converted file and point the columns at it
+ * @param corpus the Corpus to fill in
+ * @param path the .wbc file
+ * @return int a value to say if we succeeded or not
+ */
+
+int corpus_open(Corpus & corpus, string path) {
+  try {
+    file_mapping file (path.c_str(), read_only);
+    mapped_region region (file, read_only);
+    corpus.file.swap(file);
+    corpus.region.swap(region);
+  } catch (interprocess_exception &ex) {
+    cout << "Unable to map " << path << ": " << ex.what() << endl;
+    return 1;
+  }
+
+  const char * base = static_cast<const char*>(corpus.region.get_address());
+  size_t size = corpus.region.get_size();
+
+  if (size < sizeof(CorpusHeader)) {
+    cout << path << " is too small to be a corpus file" << endl;
+    return 1;
+  }
+
+  corpus.header = reinterpret_cast<const CorpusHeader*>(base);
+  const CorpusHeader & h = *corpus.header;
+
+  if (memcmp(h.magic, "WBC1", 4) != 0 || h.version != CORPUS_VERSION) {
+    cout << path << " is not a version " << CORPUS_VERSION << " corpus file" << endl;
+    return 1;
+  }
+
+  size_t column = pad8(h.num_tokens * sizeof(int32_t));
+  size_t offset = pad8(sizeof(CorpusHeader));
+
+  if (size < offset + pad8((h.num_sentences + 1) * sizeof(uint64_t)) +
+      pad8((h.num_strings + 1) * sizeof(uint64_t)) + (column * 6) + h.string_bytes) {
+    cout << path << " is truncated" << endl;
+    return 1;
+  }
+
+  corpus.sentences = reinterpret_cast<const uint64_t*>(base + offset);
+  offset += pad8((h.num_sentences + 1) * sizeof(uint64_t));
+  corpus.strings = reinterpret_cast<const uint64_t*>(base + offset);
+  offset += pad8((h.num_strings + 1) * sizeof(uint64_t));
+
+  const int32_t ** cols[6] = { &corpus.word, &corpus.lemma, &corpus.pos, &corpus.id, &corpus.head, &corpus.deprel };
+  for (int c = 0; c < 6; ++c) {
+    *cols[c] = reinterpret_cast<const int32_t*>(base + offset);
+    offset += column;
+  }
+
+  corpus.string_data = base + offset;
+  return 0;
+}
+
+/**
+ * Get the text of a string in the table
+ * @param corpus an open Corpus
+ * @param idx the index of the string
+ * @return the string
+ */
+
+string corpus_string(const Corpus & corpus, int32_t idx) {
+  uint64_t start = corpus.strings[idx];
+  return string(corpus.string_data + start, corpus.strings[idx + 1] - start);
+}
+
+/**
+ * Lower case every string in the table and find it in the dictionary. The passes do
+ * this once per string rather than once per token.
+ * @param corpus an open Corpus
+ * @param DICTIONARY_FAST the fast dictionary
+ * @param missing the value to use for strings not in the dictionary
+ * @return a vector with an entry for each string in the table
+ */
+
+vector<int> corpus_dictionary_lookup(const Corpus & corpus, Dictionary & DICTIONARY_FAST, int missing) {
+  vector<int> lookup (corpus.header->num_strings, missing);
+  string val;
+
+  for (size_t i = 0; i < lookup.size(); ++i) {
+    uint64_t start = corpus.strings[i];
+    s9::StringRef str (corpus.string_data + start, corpus.strings[i + 1] - start);
+    int id = DICTIONARY_FAST.find(s9::ToLowerInto(str, val));
+    if (id >= 0) {
+      lookup[i] = id;
+    }
+  }
+
+  return lookup;
+}
+
+/**
+ * Check every string in the table for a substring
+ * @param corpus an open Corpus
+ * @param contains the substring to look for
+ * @return a vector with a 1 for each string that contains it
+ */
+
+vector<char> corpus_contains(const Corpus & corpus, const string & contains) {
+  vector<char> flags (corpus.header->num_strings, 0);
+
+  for (size_t i = 0; i < flags.size(); ++i) {
+    flags[i] = s9::StringContains(corpus_string(corpus, i), contains) ? 1 : 0;
+  }
+
+  return flags;
+}
+
+/**
+ * Cut a file's sentences into runs holding about the same number of tokens. Sentences vary a
+ * lot in length, so equal numbers of sentences can leave one thread with far more work.
+ * @param corpus an open Corpus
+ * @param num_chunks how many runs we want
+ * @return num_chunks + 1 sentence indices, run c being [chunks[c], chunks[c+1]). Runs may be
+ * empty when there are fewer sentences than chunks.
+ */
+
+vector<uint64_t> corpus_chunks(const Corpus & corpus, size_t num_chunks) {
+  uint64_t num_sentences = corpus.header->num_sentences;
+  uint64_t num_tokens = corpus.sentences[num_sentences];
+  const uint64_t * sentences_end = corpus.sentences + num_sentences;
+
+  vector<uint64_t> chunks (num_chunks + 1, num_sentences);
+  chunks[0] = 0;
+  for (size_t c = 1; c < num_chunks; ++c) {
+    uint64_t target = num_tokens * c / num_chunks;
+    chunks[c] = std::lower_bound(corpus.sentences, sentences_end, target) - corpus.sentences;
+  }
+  return chunks;
+}
+
+/**
+ * How many chunks corpus_scan cuts each file into, so a consumer can keep state per chunk
+ * @return size_t the number of chunks
+ */
+
+size_t corpus_scan_chunks() {
+  return omp_get_max_threads() * CORPUS_CHUNKS_PER_THREAD;
+}
+
+//! One file of a scan, held so the next can be loaded while this one is read
+struct ScanFile {
+  Corpus corpus;
+  CorpusData data;
+};
+
+/**
+ * Map or parse one file for corpus_scan. A mapped file is also asked into the page cache,
+ * so its pages are read from disk while the file before it is still being counted.
+ * @param filepath a .wbc or text file
+ * @param file the ScanFile to fill
+ * @return int a value to say if we succeeded or not
+ */
+
+static int scan_load(const string & filepath, ScanFile & file) {
+  if (corpus_file(filepath)) {
+    if (corpus_open(file.corpus, filepath) != 0) { return 1; }
+    file.corpus.region.advise(mapped_region::advice_willneed);
+    return 0;
+  }
+
+  if (corpus_parse_text(filepath, file.data) != 0) { return 1; }
+  corpus_view(file.data, file.corpus);
+  return 0;
+}
+
+/**
+ * Read each file once and hand every sentence to all of the consumers. Converted files are
+ * mapped; ukwac text files are parsed into memory first. The next file is loaded on its own
+ * thread while the current one is read, so the cores are not left waiting on the disk or the
+ * parser at each file. Each file is cut into runs of about equal tokens which the threads
+ * take as they finish the last, so one long run can't hold up the rest. The threads still
+ * meet at the end of each file, since end_file may write out what the file gave.
+ * @param filenames the files to read, .wbc or text
+ * @param consumers the passes that want to see the sentences
+ * @return int a value to say if we succeeded or not
+ */
+
+int corpus_scan(vector<string> filenames, vector<SentenceConsumer*> & consumers) {
+  if (filenames.empty()) { return 0; }
+
+  int num_threads = omp_get_max_threads();
+  size_t num_chunks = corpus_scan_chunks();
+
+  std::unique_ptr<ScanFile> next (new ScanFile);
+  std::future<int> loading = std::async(std::launch::async, scan_load, std::cref(filenames[0]), std::ref(*next));
+
+  for (size_t f = 0; f < filenames.size(); ++f) {
+    if (loading.get() != 0) { return 1; }
+    std::unique_ptr<ScanFile> current (std::move(next));
+    const Corpus & corpus = current->corpus;
+
+    if (f + 1 < filenames.size()) {
+      next.reset(new ScanFile);
+      loading = std::async(std::launch::async, scan_load, std::cref(filenames[f + 1]), std::ref(*next));
+    }
+
+    cout << "Reading file " << filenames[f] << endl;
+
+    string name = corpus_source_name(filenames[f]);
+    for (SentenceConsumer * c : consumers) {
+      if (c->begin_file(corpus, name) != 0) { return 1; }
+    }
+
+    vector<uint64_t> chunks = corpus_chunks(corpus, num_chunks);
+
+    auto read_chunk = [&](long c, int thread) {
+      for (uint64_t s = chunks[c]; s < chunks[c+1]; ++s) {
+        for (SentenceConsumer * sc : consumers) {
+          sc->sentence(corpus, corpus.sentences[s], corpus.sentences[s+1], thread, c);
+        }
+      }
+      stats_count(0, chunks[c+1] - chunks[c], corpus.sentences[chunks[c+1]] - corpus.sentences[chunks[c]]);
+    };
+
+    // Dynamic hands the chunks out in order, so each thread still sees its sentences in file order
+    #pragma omp parallel num_threads(num_threads)
+    {
+      int thread = omp_get_thread_num();
+      StatsBusy busy;
+
+      #pragma omp for schedule(dynamic, 1) nowait
+      for (long c = 0; c < num_chunks; ++c) { read_chunk(c, thread); }
+    }
+
+    stats_count(file_size(filenames[f]), 0, 0);
+
+    for (SentenceConsumer * c : consumers) {
+      if (c->end_file(corpus) != 0) { return 1; }
+    }
+  }
+
+  return 0;
+}
@@ -8,6 +8,8 @@
 
 #include "wacky_create.hpp"
 
+#include <numeric>
+
 using namespace boost::filesystem;
 using namespace boost::interprocess;
 using namespace std;
@@ -39,7 +41,7 @@ vector<string>::iterator find_in_dictionary(vector<string> & DICTIONARY, string
  * Create our dictionary and flipped frequency from a frequency set
  * @param OUTPUT_DIR the output directory
  * @param FREQ an existing frequency of words
- * @param FREQ_FLIPPED an empty vector which this function will fill
+ * @param FREQ_FLIPPED an empty vector we fill with the top VOCAB_SIZE words, most frequent first - create_basis sorts the rest if it needs them
  * @param DICTIONARY_FAST an empty map which this function will fill
  * @param DICTIONARY an empty vector that this function will fill
  * @param VOCAB_SIZE a size_t for the maximum size of our dictionary
@@ -50,7 +52,7 @@ vector<string>::iterator find_in_dictionary(vector<string> & DICTIONARY, string
 int create_dictionary(string OUTPUT_DIR,
     map<string, size_t> & FREQ, 
     vector< pair<string,size_t> > & FREQ_FLIPPED,
-    map<string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     vector<string> & DICTIONARY,
     size_t & VOCAB_SIZE) {
 
@@ -61,21 +63,35 @@ int create_dictionary(string OUTPUT_DIR,
 
   if (VOCAB_SIZE < 0 ) { VOCAB_SIZE = 5000; }
 
-  for (auto it = FREQ.begin(); it != FREQ.end(); it++){
-    FREQ_FLIPPED.push_back(*it);
+  // Only the top VOCAB_SIZE words need putting in order - the rest just add up to the
+  // unknown count - so we select them from pointers into FREQ, in the order sort_freq gives
+  typedef map<string, size_t>::const_iterator FreqIt;
+  vector<FreqIt> order;
+  order.reserve(FREQ.size());
+  for (auto it = FREQ.cbegin(); it != FREQ.cend(); it++){
+    order.push_back(it);
   }
 
-  std::sort(FREQ_FLIPPED.begin(), FREQ_FLIPPED.end(), sort_freq);
+  size_t top = std::min(static_cast<size_t>(VOCAB_SIZE), order.size());
+  std::partial_sort(order.begin(), order.begin() + top, order.end(), [](FreqIt a, FreqIt b) {
+    return a->second != b->second ? a->second > b->second : a->first < b->first;
+  });
 
-  for (auto it = FREQ_FLIPPED.begin(); it != FREQ_FLIPPED.end(); it++) {
-    DICTIONARY.push_back(it->first);
+  for (auto it = order.begin(); it != order.end(); it++) {
     idx++;
     if (idx >= VOCAB_SIZE){
-      unk_count += it->second;
-    }  
+      unk_count += (*it)->second;
+    }
+  }
+
+  for (size_t i = 0; i < top; ++i) {
+    FREQ_FLIPPED.push_back(*order[i]);
+  }
+
+  // FREQ is already in alphabetical order
+  for (auto it = FREQ.begin(); it != FREQ.end(); it++) {
+    DICTIONARY.push_back(it->first);
   }
- 
-  std::sort(DICTIONARY.begin(), DICTIONARY.end());
 
   // In case we have a dictionary that is smaller than what we've asked for set it here
   VOCAB_SIZE = DICTIONARY.size();
@@ -83,19 +99,17 @@ int create_dictionary(string OUTPUT_DIR,
   // I suspect we dont actually need the total count
   DICTIONARY.push_back(string("UNK"));
 
-  idx = 0;
-  std::ofstream dictionary_file (OUTPUT_DIR + "/dictionary.txt");
+  TextFile dictionary_file;
+  dictionary_file.open(OUTPUT_DIR + "/dictionary.txt");
   for (auto it : DICTIONARY){
-    dictionary_file << it << endl;
-    DICTIONARY_FAST[it] = idx;
-    idx++;
+    dictionary_file << it << '\n';
+    DICTIONARY_FAST.insert(it);
   }
-  dictionary_file.flush();
   dictionary_file.close();
 
-  std::ofstream unk_file (OUTPUT_DIR + "/unk_count.txt");
-  if (unk_file.is_open()) {
-    unk_file << s9::ToString(unk_count) << endl;
+  TextFile unk_file;
+  if (unk_file.open(OUTPUT_DIR + "/unk_count.txt")) {
+    unk_file << unk_count << '\n';
     unk_file.close();
   } else {
     cout << "Unable to open unk file for writing" << endl;
@@ -105,11 +119,37 @@ int create_dictionary(string OUTPUT_DIR,
   return 0;
 }
 
+/**
+ * create_dictionary only puts the top VOCAB_SIZE words in order. If the basis runs off the
+ * end of them we sort the rest of FREQ on and carry on, so the basis comes out the same as
+ * it would from the full list that read_freq gives.
+ * @param FREQ the frequency of every word
+ * @param FREQ_FLIPPED the words in order so far, which we add the rest to
+ * @return bool true if we added any words
+ */
+
+static bool extend_freq_flipped(map<string, size_t> & FREQ,
+    vector< pair<string,size_t> > & FREQ_FLIPPED) {
+
+  if (FREQ_FLIPPED.size() >= FREQ.size()) { return false; }
+
+  // What we have is a prefix of the full order, so the rest is everything that sorts after it
+  size_t start = FREQ_FLIPPED.size();
+  for (auto it = FREQ.cbegin(); it != FREQ.cend(); it++) {
+    if (start == 0 || sort_freq(FREQ_FLIPPED[start - 1], *it)) {
+      FREQ_FLIPPED.push_back(*it);
+    }
+  }
+
+  std::sort(FREQ_FLIPPED.begin() + start, FREQ_FLIPPED.end(), sort_freq);
+  return FREQ_FLIPPED.size() > start;
+}
+
 /**
  * When creating word count vectors, we must first create a basis
  * @param OUTPUT_DIR the output directory
  * @param FREQ an existing frequency of words
- * @param FREQ_FLIPPED the frequency flipped
+ * @param FREQ_FLIPPED the frequency flipped, which we extend if the basis needs words past it
  * @param DICTIONARY_FAST a lookup from string to position
  * @param BASIS_VECTOR the vector this function will fill
  * @param ALLOWED_BASIS_WORDS words we are actually allowed to use in the basis
@@ -122,7 +162,7 @@ int create_dictionary(string OUTPUT_DIR,
 void create_basis(string OUTPUT_DIR,
     map<string, size_t> & FREQ, 
     vector< pair<string,size_t> > & FREQ_FLIPPED,
-    map<string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     vector<int> & BASIS_VECTOR,
     set<string> & ALLOWED_BASIS_WORDS,
     set<string> & INSIST_WORDS,
@@ -139,11 +179,12 @@ void create_basis(string OUTPUT_DIR,
     cout << "Inserting " << *it << " into basis" << endl;
   }
 
-  for (auto it = FREQ_FLIPPED.begin(); it != FREQ_FLIPPED.end(); it++) {
-    if (!s9::StringContains(it->first,"UNK")){ 
+  for (size_t i = 0; i < FREQ_FLIPPED.size() || extend_freq_flipped(FREQ, FREQ_FLIPPED); i++) {
+    const pair<string,size_t> & word = FREQ_FLIPPED[i];
+    if (!s9::StringContains(word.first,"UNK")){ 
       if (idx > IGNORE_WINDOW) {
-        if (ALLOWED_BASIS_WORDS.find(it->first) != ALLOWED_BASIS_WORDS.end()) {
-          BASIS_VECTOR.push_back(DICTIONARY_FAST[it->first]);
+        if (ALLOWED_BASIS_WORDS.find(word.first) != ALLOWED_BASIS_WORDS.end()) {
+          BASIS_VECTOR.push_back(DICTIONARY_FAST[word.first]);
         }
       } else{ 
         idx++;
@@ -154,15 +195,119 @@ void create_basis(string OUTPUT_DIR,
     }   
   }
   
-  std::ofstream basis_file (OUTPUT_DIR + "/basis.txt");
+  TextFile basis_file;
+  basis_file.open(OUTPUT_DIR + "/basis.txt");
   for (auto it : BASIS_VECTOR){
-    basis_file << it << endl;
+    basis_file << it << '\n';
   }
-  basis_file.flush();
   basis_file.close();
 }
 
 
+/**
+ * Add the words a counter holds to the frequencies. A word new to FREQ is allowed in the
+ * basis if the first time it was seen it had a basis tag.
+ * @param counter the counts
+ * @param FREQ the map we are adding to
+ * @param ALLOWED_BASIS_WORDS the allowed words we are adding to
+ */
+
+static void add_freq(const FreqCounter & counter,
+    map<string, size_t> & FREQ,
+    set<string> & ALLOWED_BASIS_WORDS) {
+
+  for (const FreqCounter::Entry & e : counter.entries()) {
+    string val = counter.word(e).to_string();
+
+    auto it = FREQ.find(val);
+    if (it == FREQ.end()) {
+      FREQ[val] = e.count;
+      if (e.allowed) {
+        ALLOWED_BASIS_WORDS.insert(val);
+      }
+    } else {
+      it->second += e.count;
+    }
+  }
+}
+
+/**
+ * Write out how far a bounded count may be off. The first line is the floor - no word seen
+ * more often than that was dropped - then each word whose count may be too high, a comma and
+ * a space, and by how much at most.
+ * @param OUTPUT_DIR the output directory
+ * @param counter the bounded counts
+ * @return int a value to say if we succeeded or not
+ */
+
+static int write_freq_error(string OUTPUT_DIR, const FreqCounter & counter) {
+  map<string, size_t> errors;
+  for (const FreqCounter::Entry & e : counter.entries()) {
+    if (e.error > 0) { errors[counter.word(e).to_string()] = e.error; }
+  }
+
+  TextFile error_file;
+  if (!error_file.open(OUTPUT_DIR + "/freq_error.txt")) {
+    cout << "Unable to open freq_error.txt file for writing" << endl;
+    return 1;
+  }
+  error_file << counter.floor() << '\n';
+  for (auto it = errors.begin(); it != errors.end(); ++it) {
+    error_file << it->first << ", " << it->second << '\n';
+  }
+  error_file.close();
+  return 0;
+}
+
+/**
+ * Count the frequencies as a pipeline stage. Each word is counted at its position in the
+ * whole scan, so whichever thread sees a word first the allowed words come out the same as
+ * reading the text in order.
+ * @param WORD_IGNORES the nonsense words to ignore
+ * @param LEMMA_TIME are we using the lemmatized version of the word?
+ * @param FREQ_CAPACITY if not 0, each thread keeps only about this many of its most frequent words
+ */
+
+FrequencyCounter::FrequencyCounter(set<string> & WORD_IGNORES,
+    bool LEMMA_TIME,
+    size_t FREQ_CAPACITY) :
+  ignores_(WORD_IGNORES), lemma_time_(LEMMA_TIME), col_(NULL), base_(0),
+  counters_(omp_get_max_threads(), FreqCounter(FREQ_CAPACITY)) {}
+
+int FrequencyCounter::begin_file(const Corpus & corpus, const string & name) {
+  col_ = lemma_time_ ? corpus.lemma : corpus.word;
+
+  // Work out once per string what word it counts as and whether it is a basis tag
+  size_t num_strings = corpus.header->num_strings;
+  vals_.resize(num_strings);
+  counted_.assign(num_strings, 0);
+  allowed_.assign(num_strings, 0);
+
+  for (size_t i = 0; i < num_strings; ++i) {
+    string str = corpus_string(corpus, i);
+    vals_[i] = s9::ToLower(str);
+    counted_[i] = s9::IsAsciiPrintableString(vals_[i]) && ignores_.find(vals_[i]) == ignores_.end();
+    allowed_[i] = s9::StringContains(str,"NN") || s9::StringContains(str,"JJ") ||
+      s9::StringContains(str,"VV") || s9::StringContains(str,"RB");
+  }
+  return 0;
+}
+
+void FrequencyCounter::sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) {
+  FreqCounter & counter = counters_[thread];
+  for (uint64_t i = start; i < end; ++i) {
+    int32_t s = col_[i];
+    if (counted_[s]) {
+      counter.add(vals_[s], base_ + i, allowed_[corpus.pos[i]]);
+    }
+  }
+}
+
+int FrequencyCounter::end_file(const Corpus & corpus) {
+  base_ += corpus.header->num_tokens;
+  return 0;
+}
+
 /**
  * Create the frequency count of all the words
  * @param OUTPUT_DIR the output directory
@@ -170,6 +315,7 @@ void create_basis(string OUTPUT_DIR,
  * @param FREQ_FLIPPED a vector we shall fill
  * @param ALLOWED_BASIS_WORDS an empty vector we will fill with allowed words
  * @param LEMMA_TIME are we using the lemmatized version of the word?
+ * @param FREQ_CAPACITY if not 0, keep only about this many of the most frequent words as we go
  * @return int a value to say if we succeeded or not
  */
 
@@ -179,99 +325,61 @@ int create_freq(vector<string> filenames,
     vector< pair<string,size_t> > & FREQ_FLIPPED,
     set<string> & WORD_IGNORES,
     set<string> & ALLOWED_BASIS_WORDS,
-    bool LEMMA_TIME) {
+    bool LEMMA_TIME,
+    size_t FREQ_CAPACITY) {
 
-  size_t total_count = 0;
+  FrequencyCounter frequencies (WORD_IGNORES, LEMMA_TIME, FREQ_CAPACITY);
+  vector<SentenceConsumer*> consumers {&frequencies};
+  if (corpus_scan(filenames, consumers) != 0) { return 1; }
 
-  // Scan directory for the files
-  for (string filepath : filenames){
+  const vector<FreqCounter> & counters = frequencies.counters();
+  size_t total_count = 0;
+  for (const FreqCounter & counter : counters) {
+    total_count += counter.total();
+  }
 
-    cout << filepath << endl;
-    int num_blocks =1; 
-   
-    char ** block_pointer;
-    size_t * block_size;
+  if (FREQ_CAPACITY > 0) {
+    // Bounded counters merge through their floors, so every count stays an upper bound and
+    // count - error a lower one
+    FreqCounter bounded (FREQ_CAPACITY);
+    for (const FreqCounter & counter : counters) {
+      bounded.merge(counter);
+    }
+    bounded.shrink();
+    add_freq(bounded, FREQ, ALLOWED_BASIS_WORDS);
+    if (write_freq_error(OUTPUT_DIR, bounded) != 0) { return 1; }
 
-    // Cant pass this into _breakup sadly
-    file_mapping m_file(filepath.c_str(), read_only);
-    mapped_region region(m_file, read_only);  
+    size_t exact = 0;
+    for (const FreqCounter::Entry & e : bounded.entries()) {
+      if (e.error == 0) { exact++; }
+    }
+    cout << "Kept " << FREQ.size() << " words, " << exact << " of them counted exactly. ";
+    cout << "No word seen more than " << bounded.floor() << " times was dropped" << endl;
+  } else {
+    // Every count is exact, so an error file from an earlier bounded run no longer applies
+    boost::filesystem::remove(OUTPUT_DIR + "/freq_error.txt");
 
-    int result = breakup(block_pointer, block_size, m_file, region, num_blocks );
-    if (result == -1){
-      return -1;
-    }  
+    // Merge the tables, each thread taking the words whose hash lands in its partition
+    int num_parts = omp_get_max_threads();
+    vector<FreqCounter> parts (num_parts);
 
-    // Now begin the threading block
-    // Probably a little slow reading char by char right?
-    // Also potential unicode errors? Maybe
-    
-    omp_set_num_threads(num_blocks);
-    #pragma omp parallel
-    {   
-      int block_id = omp_get_thread_num();
-      char *mem = block_pointer[block_id];
-      string str;
-
-      for(size_t i = 0; i < block_size[block_id]; ++i){
-        char data = *mem;
-        if (data != '\n' && data != '\r'){
-          str += data;
-        } else {
-          // Can now look at the string and work on our FREQ
-          vector<string> tokens = s9::SplitStringWhitespace(str);  
-          if (tokens.size() > 5) {
-            string val = s9::ToLower(tokens[0]);
-            if (LEMMA_TIME) {
-              val = s9::ToLower(tokens[1]); // Use the canonical form of the word
-            }
-
-            if (s9::IsAsciiPrintableString(val)){
-              if (WORD_IGNORES.find(val) == WORD_IGNORES.end()){  
-               #pragma omp atomic
-               total_count++;
-               
-               auto result = FREQ.find(val); 
-                if (result == FREQ.end()){
-                  #pragma omp critical
-                  { 
-                    FREQ[val] = 1;
-                    if ( s9::StringContains(tokens[2],"NN") ||
-                          s9::StringContains(tokens[2],"JJ") ||
-                          s9::StringContains(tokens[2],"VV") ||
-                          s9::StringContains(tokens[2],"RB")){
-                      ALLOWED_BASIS_WORDS.insert(val);  
-                    }
-                  }
-                 
-                }  else {
-                  #pragma omp atomic 
-                  FREQ[val] = FREQ[val] + 1;
-                  
-                }
-              }
-            }
-          }
-          str = "";
-        }
-        mem++;
+    #pragma omp parallel for num_threads(num_parts)
+    for (int p = 0; p < num_parts; ++p) {
+      for (const FreqCounter & counter : counters) {
+        parts[p].merge(counter, p, num_parts);
       }
-    
     }
 
-#ifdef _WRITE_WORDS
-    words_file.flush();
-    words_file.close();
-#endif
-
-    // remove memory map ?
+    for (const FreqCounter & part : parts) {
+      add_freq(part, FREQ, ALLOWED_BASIS_WORDS);
+    }
   }
-  
 
   // Write out the final frequency file
-  std::ofstream freq_file (OUTPUT_DIR + "/freq.txt");
-  if (freq_file.is_open()) {
+  TextFile freq_file;
+  if (freq_file.open(OUTPUT_DIR + "/freq.txt")) {
     for (auto it = FREQ.begin(); it != FREQ.end(); ++it) {
-      freq_file << it->first << ", " << it->second << endl;
+      freq_file << it->first << ", " << it->second << '\n';
     }
     freq_file.close();
   } else {
@@ -282,10 +390,10 @@ int create_freq(vector<string> filenames,
   cout << "Finished writing FREQ file" << endl;
 
   // Write out the allowed basis words file
-  std::ofstream allowed_file (OUTPUT_DIR + "/allowed.txt");
-  if (allowed_file.is_open()) {
+  TextFile allowed_file;
+  if (allowed_file.open(OUTPUT_DIR + "/allowed.txt")) {
     for (auto it = ALLOWED_BASIS_WORDS.begin(); it != ALLOWED_BASIS_WORDS.end(); ++it) {
-      allowed_file << *it << endl;
+      allowed_file << *it << '\n';
     }
     allowed_file.close();
   } else {
@@ -295,9 +403,9 @@ int create_freq(vector<string> filenames,
   
   cout << "Finished writing ALLOWED file" << endl;
 
-  std::ofstream total_file (OUTPUT_DIR + "/total_count.txt");
-  if (total_file.is_open()) {
-    total_file << s9::ToString(total_count) << endl;
+  TextFile total_file;
+  if (total_file.open(OUTPUT_DIR + "/total_count.txt")) {
+    total_file << total_count << '\n';
     total_file.close();
   } else {
     cout << "Unable to open total file for writing" << endl;
@@ -308,6 +416,298 @@ int create_freq(vector<string> filenames,
 
 }
 
+/**
+ * Build the reverse of BASIS_VECTOR, so we can find the basis slot of a word without
+ * searching the basis. Where a word appears more than once the first slot wins.
+ * @param BASIS_VECTOR the words in the vector we are summing up
+ * @param BASIS_SIZE how big is our basis
+ * @param VOCAB_SIZE how big is the dictionary
+ * @return a vector indexed by dictionary index (VOCAB_SIZE is UNK) giving the slot or -1
+ */
+
+vector<int> create_basis_slots(const vector<int> & BASIS_VECTOR,
+    size_t BASIS_SIZE,
+    size_t VOCAB_SIZE) {
+
+  size_t num_slots = std::min(BASIS_SIZE, BASIS_VECTOR.size());
+  size_t table_size = VOCAB_SIZE + 1;
+  for (size_t bv = 0; bv < num_slots; ++bv) {
+    if (BASIS_VECTOR[bv] >= 0) {
+      table_size = std::max(table_size, static_cast<size_t>(BASIS_VECTOR[bv]) + 1);
+    }
+  }
+
+  vector<int> BASIS_SLOTS (table_size, -1);
+  for (size_t bv = num_slots; bv-- > 0; ) {
+    if (BASIS_VECTOR[bv] >= 0) {
+      BASIS_SLOTS[BASIS_VECTOR[bv]] = bv;
+    }
+  }
+
+  return BASIS_SLOTS;
+}
+
+/**
+ * Add the window counts for one sentence to the word vectors
+ * @param sentence the dictionary indices of the words in the sentence
+ * @param BASIS_SLOTS the basis slot of each dictionary index, from create_basis_slots
+ * @param log where this thread records its hits on the word vectors
+ * @param thread which thread we are
+ * @param WINDOW_SIZE how many words either side will we consider
+ * @param slots scratch space for the slot of each word in the sentence
+ * @param TARGET_ROWS if not NULL, only count windows around the words set here
+ */
+
+void count_sentence(const vector<int> & sentence,
+    const vector<int> & BASIS_SLOTS,
+    CooccurrenceLog & log,
+    int thread,
+    size_t WINDOW_SIZE,
+    vector<int> & slots,
+    const vector<char> * TARGET_ROWS) {
+
+  // Look each word up once rather than once per window it falls in
+  slots.resize(sentence.size());
+  for (size_t i = 0; i < sentence.size(); ++i) {
+    int w = sentence[i];
+    slots[i] = (w >= 0 && w < BASIS_SLOTS.size()) ? BASIS_SLOTS[w] : -1;
+  }
+
+  for (int idw = 0; idw < sentence.size(); ++idw){
+    int row = sentence[idw];
+    if (TARGET_ROWS != NULL && !(*TARGET_ROWS)[row]) { continue; }
+
+    // look below
+    for (int jdw = idw-1; jdw > idw - WINDOW_SIZE && jdw >= 0; --jdw){
+      if (slots[jdw] >= 0) {
+        log.add(thread, row, slots[jdw]);
+      }
+    }
+
+    // look above
+    for (int jdw = idw+1; jdw < idw + WINDOW_SIZE && jdw < sentence.size(); ++jdw){
+      if (slots[jdw] >= 0) {
+        log.add(thread, row, slots[jdw]);
+      }
+    } 
+  }
+}
+
+/**
+ * Count the word vector windows for every sentence we are handed
+ * @param DICTIONARY_FAST the fast dictionary
+ * @param BASIS_VECTOR the words in the vector we are summing up
+ * @param WORD_VECTORS the vector of vectors we are building
+ * @param VOCAB_SIZE how big is the dictionary
+ * @param BASIS_SIZE how big is our basis
+ * @param WINDOW_SIZE how many words either side will we consider
+ * @param LEMMA_TIME are we using the lemmatized version of the word?
+ * @param SPARSE_COUNTS if not NULL, count into this rather than WORD_VECTORS
+ * @param TARGET_WORDS if not NULL, only count the rows of these dictionary indices
+ */
+
+CooccurrenceCounter::CooccurrenceCounter(Dictionary & DICTIONARY_FAST,
+    vector<int> & BASIS_VECTOR,
+    vector< vector<float> > & WORD_VECTORS,
+    size_t VOCAB_SIZE,
+    size_t BASIS_SIZE,
+    size_t WINDOW_SIZE,
+    bool LEMMA_TIME,
+    SparseCounts * SPARSE_COUNTS,
+    const set<int> * TARGET_WORDS) :
+  dictionary_(DICTIONARY_FAST), basis_(BASIS_VECTOR), word_vectors_(WORD_VECTORS),
+  vocab_size_(VOCAB_SIZE), basis_size_(BASIS_SIZE), window_size_(WINDOW_SIZE),
+  lemma_time_(LEMMA_TIME), sparse_counts_(SPARSE_COUNTS), target_words_(TARGET_WORDS), col_(NULL) {}
+
+int CooccurrenceCounter::begin_file(const Corpus & corpus, const string & name) {
+  // The basis may be chosen after we are made, so build the slots here
+  slots_ = create_basis_slots(basis_, basis_size_, vocab_size_);
+  if (target_words_ != NULL) { targets_ = create_target_rows(*target_words_, vocab_size_); }
+  lookup_ = corpus_dictionary_lookup(corpus, dictionary_, vocab_size_);
+  col_ = lemma_time_ ? corpus.lemma : corpus.word;
+  scratch_.resize(omp_get_max_threads());
+  slot_scratch_.resize(omp_get_max_threads());
+  if (sparse_counts_ != NULL) {
+    log_.reset(new CooccurrenceLog(*sparse_counts_, omp_get_max_threads()));
+  } else {
+    log_.reset(new CooccurrenceLog(word_vectors_, omp_get_max_threads()));
+  }
+  return 0;
+}
+
+void CooccurrenceCounter::sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) {
+  vector<int> & sentence = scratch_[thread];
+  sentence.clear();
+  for (uint64_t i = start; i < end; ++i) {
+    sentence.push_back(lookup_[col_[i]]);
+  }
+  count_sentence(sentence, slots_, *log_, thread, window_size_, slot_scratch_[thread],
+      target_words_ != NULL ? &targets_ : NULL);
+}
+
+int CooccurrenceCounter::end_file(const Corpus & corpus) {
+  log_->flush();
+  log_.reset();
+  return 0;
+}
+
+/**
+ * Flag the rows a targeted count should fill
+ * @param TARGET_WORDS the dictionary indices we want vectors for
+ * @param VOCAB_SIZE how big is the dictionary
+ * @return a vector of VOCAB_SIZE + 1 with a 1 for each target row
+ */
+
+vector<char> create_target_rows(const set<int> & TARGET_WORDS, size_t VOCAB_SIZE) {
+  vector<char> TARGET_ROWS (VOCAB_SIZE + 1, 0);
+  for (int w : TARGET_WORDS) {
+    if (w >= 0 && w <= VOCAB_SIZE) { TARGET_ROWS[w] = 1; }
+  }
+  return TARGET_ROWS;
+}
+
+/**
+ * Zero the word vectors - we add an extra 1 for the UNK value (but UNK does not occur in the basis)
+ * @param WORD_VECTORS the vector of vectors we are building
+ * @param VOCAB_SIZE how big is the dictionary
+ * @param BASIS_SIZE how big is our basis
+ * @param TARGET_WORDS if not NULL, only these rows get their BASIS_SIZE zeroes and the rest
+ * stay empty, so the memory goes with the number of targets rather than VOCAB_SIZE
+ */
+
+void init_word_vectors(vector< vector<float> > & WORD_VECTORS,
+    size_t VOCAB_SIZE,
+    size_t BASIS_SIZE,
+    const set<int> * TARGET_WORDS) {
+
+  if (TARGET_WORDS != NULL) {
+    vector<char> TARGET_ROWS = create_target_rows(*TARGET_WORDS, VOCAB_SIZE);
+    for (int i = 0; i < VOCAB_SIZE+1; ++i) {
+      WORD_VECTORS.push_back(vector<float> (TARGET_ROWS[i] ? BASIS_SIZE : 0, 0.0));
+    }
+    return;
+  }
+
+  for (int i =0; i < VOCAB_SIZE+1; ++i) {
+    vector<float> ti;   
+    ti.reserve(VOCAB_SIZE);
+    for (int j=0; j < BASIS_SIZE; ++j) {
+      ti.push_back(0.0);
+    }  
+    WORD_VECTORS.push_back(ti);
+  }
+}
+
+/**
+ * Write TARGETS_FILE_NAME for a targeted count so the readers can tell its zero rows from
+ * real ones, or remove any left over from an earlier targeted count if this one wasn't
+ * @param OUTPUT_DIR the output directory
+ * @param TARGET_WORDS the dictionary indices we counted, or NULL if we counted them all
+ * @return int a value to say if we succeeded or not
+ */
+
+static int write_word_targets(string OUTPUT_DIR, const set<int> * TARGET_WORDS) {
+  string path = OUTPUT_DIR + "/" + TARGETS_FILE_NAME;
+
+  if (TARGET_WORDS == NULL) {
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+    return 0;
+  }
+
+  TextFile targets_file;
+  if (!targets_file.open(path)) {
+    cout << "Unable to open " << path << " for writing" << endl;
+    return 1;
+  }
+  for (int w : *TARGET_WORDS) {
+    targets_file << w << '\n';
+  }
+  targets_file.close();
+  return 0;
+}
+
+/**
+ * Write the word vectors out once every file has been counted, as word_vectors.txt
+ * and as the binary VECTOR_FILE_NAME the readers map. Rows left empty by a targeted
+ * count are written as zeroes, and TARGETS_FILE_NAME says which rows those are not.
+ * @param OUTPUT_DIR the output directory
+ * @param WORD_VECTORS the vector of vectors we built
+ * @param TARGET_WORDS the rows a targeted count filled, or NULL
+ * @return int a value to say if we succeeded or not
+ */
+
+int write_word_vectors(string OUTPUT_DIR,
+    vector< vector<float> > & WORD_VECTORS,
+    const set<int> * TARGET_WORDS) {
+
+  StatsStage stage ("write_word_vectors");
+
+  if (write_word_targets(OUTPUT_DIR, TARGET_WORDS) != 0) { return 1; }
+
+  size_t num_cols = 0;
+  for (const vector<float> & tv : WORD_VECTORS) { num_cols = std::max(num_cols, tv.size()); }
+
+  TextFile wv_file;
+  if (wv_file.open(OUTPUT_DIR + "/word_vectors.txt")) {
+    text_file_write_rows(wv_file, WORD_VECTORS.size(), [&](size_t r, TextBuffer & out) {
+      const vector<float> & tv = WORD_VECTORS[r];
+      for (float tf : tv){
+        out << static_cast<int>(tf) << ' ';
+      }
+      for (size_t c = tv.size(); c < num_cols; ++c) {
+        out << "0 ";
+      }
+      out << '\n';
+    });
+    wv_file.close();
+  } else {
+    cout << "Unable to open word_vec file for writing" << endl;
+    return 1;
+  }
+
+  return vector_file_write(OUTPUT_DIR + "/" + VECTOR_FILE_NAME, WORD_VECTORS, num_cols);
+}
+
+/**
+ * Write sparse word vectors out in the same forms as the dense ones, zeroes and all
+ * @param OUTPUT_DIR the output directory
+ * @param WORD_VECTORS the sparse rows we built
+ * @param TARGET_WORDS the rows a targeted count filled, or NULL
+ * @return int a value to say if we succeeded or not
+ */
+
+int write_word_vectors(string OUTPUT_DIR,
+    const SparseVectors & WORD_VECTORS,
+    const set<int> * TARGET_WORDS) {
+
+  StatsStage stage ("write_word_vectors");
+
+  if (write_word_targets(OUTPUT_DIR, TARGET_WORDS) != 0) { return 1; }
+
+  TextFile wv_file;
+  if (!wv_file.open(OUTPUT_DIR + "/word_vectors.txt")) {
+    cout << "Unable to open word_vec file for writing" << endl;
+    return 1;
+  }
+
+  text_file_write_rows(wv_file, WORD_VECTORS.rows(), [&](size_t r, TextBuffer & out) {
+    size_t k = WORD_VECTORS.row_ptr[r];
+    size_t end = WORD_VECTORS.row_ptr[r+1];
+    for (size_t c = 0; c < WORD_VECTORS.num_cols; ++c) {
+      int ti = 0;
+      if (k < end && WORD_VECTORS.col_idx[k] == c) {
+        ti = static_cast<int>(WORD_VECTORS.vals[k++]);
+      }
+      out << ti << ' ';
+    }
+    out << '\n';
+  });
+  wv_file.close();
+
+  return vector_file_write(OUTPUT_DIR + "/" + VECTOR_FILE_NAME, WORD_VECTORS);
+}
+
 /**
  * Create our word vectors - the BIG function
  * @param OUTPUT_DIR the output directory
@@ -323,6 +723,10 @@ int create_freq(vector<string> filenames,
  * @param BASIS_SIZE how big is our basis
  * @param WINDOW_SIZE how many words either side will we consider
  * @param LEMMA_TIME are we using the lemmatized version of the word?
+ * @param SPARSE keep the counts as sparse rows rather than a dense VOCAB_SIZE x BASIS_SIZE block.
+ * WORD_VECTORS is left empty, but word_vectors.txt is the same.
+ * @param TARGET_WORDS if not NULL, only count the rows of these dictionary indices. Every
+ * other row is written as zeroes.
  * @return int a value to say if we succeeded or not
  */
 
@@ -330,7 +734,7 @@ int create_word_vectors(vector<string> filenames,
     string OUTPUT_DIR,
     map<string, size_t> & FREQ, 
     vector< pair<string,size_t> > & FREQ_FLIPPED,
-    map<string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     vector<string> & DICTIONARY, 
     vector<int> & BASIS_VECTOR,
     set<string> & WORD_IGNORES,
@@ -339,148 +743,105 @@ int create_word_vectors(vector<string> filenames,
     size_t VOCAB_SIZE,
     size_t BASIS_SIZE,
     size_t WINDOW_SIZE,
-    bool LEMMA_TIME) {
+    bool LEMMA_TIME,
+    bool SPARSE,
+    const set<int> * TARGET_WORDS) {
   
-  int num_blocks =1; 
-    
+  SparseCounts counts;
 
-  // Start by setting the counts - we add an extra 1 for the UNK value (but UNK does not occur in the basis)
-  for (int i =0; i < VOCAB_SIZE+1; ++i) {
-    vector<float> ti;   
-    ti.reserve(VOCAB_SIZE);
-    for (int j=0; j < BASIS_SIZE; ++j) {
-      ti.push_back(0.0);
-    }  
-    WORD_VECTORS.push_back(ti);
+  if (SPARSE) {
+    sparse_counts_init(counts, VOCAB_SIZE + 1, BASIS_SIZE);
+  } else {
+    init_word_vectors(WORD_VECTORS, VOCAB_SIZE, BASIS_SIZE, TARGET_WORDS);
+  }
+  if (TARGET_WORDS != NULL) {
+    cout << "Counting word vectors for " << TARGET_WORDS->size() << " target words" << endl;
   }
 
-  for( string filepath : filenames) {
+  CooccurrenceCounter counter (DICTIONARY_FAST, BASIS_VECTOR, WORD_VECTORS, VOCAB_SIZE, BASIS_SIZE, WINDOW_SIZE, LEMMA_TIME, SPARSE ? &counts : NULL, TARGET_WORDS);
+  vector<SentenceConsumer*> consumers {&counter};
+  if (corpus_scan(filenames, consumers) != 0) { return 1; }
 
-    char ** block_pointer;
-    size_t * block_size;
+  // Finished all the files, now quit
+  if (SPARSE) {
+    SparseVectors sparse;
+    sparse_from_counts(counts, sparse);
+    cout << "Word vectors have " << sparse.nnz() << " non-zero counts" << endl;
+    return write_word_vectors(OUTPUT_DIR, sparse, TARGET_WORDS);
+  }
 
-    // Cant pass this into _breakup sadly
-    file_mapping m_file(filepath.c_str(), read_only);
-    mapped_region region(m_file, read_only);  
+  return write_word_vectors(OUTPUT_DIR, WORD_VECTORS, TARGET_WORDS);
+}
 
-    int result = breakup(block_pointer, block_size, m_file, region, num_blocks );
-    if (result == -1){
-      return -1;
-    }  
 
-    cout << "Reading file " << filepath << endl;
-
-    omp_set_num_threads(num_blocks);
-    #pragma omp parallel
-    {   
-      int block_id = omp_get_thread_num();
-      char *mem = block_pointer[block_id];
-      size_t file_count = 0;
-      std::string str;
-      std::vector<int> sentence;
-      bool recording = false;
-
-      for(std::size_t i = 0; i < block_size[block_id]; ++i){
-        char data = *mem;
-        if (data != '\n' && data != '\r'){
-          str += data;
-        } else {  
-          //  Can now look at the string and work on our FREQ
-          vector<string> tokens = s9::SplitStringWhitespace(str);  
-          
-          // Essentially, we capture a sentence and then look at each word
-          // and the WINDOW_SIZE of words before and after it, and update a 
-          // count if that word occurs in the BASIS_VECTOR 
-
-          if (tokens.size() > 0){
-            string val = s9::ToLower(tokens[0]);
-
-            if (s9::StringContains(val,"</s>")){
-              // Stop sentence
-              recording = false;
-              // Now update the counts
-              for (int idw = 0; idw < sentence.size(); ++idw){
-                // look below
-                for (int jdw = idw-1; jdw > idw - WINDOW_SIZE && jdw >= 0; --jdw){
-                  int ji = sentence[jdw];
-
-                  for (int bv = 0; bv < BASIS_SIZE; ++bv){
-                    if (BASIS_VECTOR[bv] == ji){
-                      // Probably could be faster here
-                      #pragma omp atomic
-                      WORD_VECTORS[ sentence[idw] ][bv] += 1.0;
-                      break;
-                    }
-                  }    
-                }
-
-                // look above
-                for (int jdw = idw+1; jdw < idw + WINDOW_SIZE && jdw < sentence.size(); ++jdw){
-
-                  int ji = sentence[jdw];
-                  for (int bv = 0; bv < BASIS_SIZE; ++bv){
-
-                    if (BASIS_VECTOR[bv] == ji){
-                      #pragma omp atomic
-                      WORD_VECTORS[ sentence[idw] ][bv] +=1.0;
-                      break;
-                    }
-                  }    
-                } 
-              }
-              sentence.clear(); 
-
-            } else if (s9::StringContains(val,"<s>")){
-              // start sentence
-              recording = true;
-            } else if (recording) {
-
-              if (tokens.size() > 1) {
-                string lemma = val;
-              
-                if (LEMMA_TIME) {
-                  lemma = s9::ToLower(tokens[1]);
-                }
-
-                if (DICTIONARY_FAST.find(lemma) == DICTIONARY_FAST.end()){
-                  sentence.push_back(VOCAB_SIZE);
-                } else {
-                  sentence.push_back(DICTIONARY_FAST[lemma] );
-                }
-              }
-            }
-          } 
-          str = "";
-        }
-        mem++;
-      }    
-    } // end parallel bit
-    
-    // These need to be freed as breakup assigns them. A bit naughty
-    //free(block_pointer);
-    //free(block_size);
+/**
+ * Write the integer files for every sentence we are handed, one token stream and index for
+ * each ukwac file whatever the number of threads.
+ * @param OUTPUT_DIR the output directory
+ * @param WORD_IGNORES the nonsense words to ignore
+ * @param DICTIONARY_FAST the fast dictionary
+ * @param VOCAB_SIZE how big is the dictionary
+ * @param LEMMA_TIME are we using the lemmatized version of the word?
+ */
+
+IntegerWriter::IntegerWriter(string OUTPUT_DIR,
+    set<string> & WORD_IGNORES,
+    Dictionary & DICTIONARY_FAST,
+    size_t VOCAB_SIZE,
+    bool LEMMA_TIME) :
+  output_dir_(OUTPUT_DIR), ignores_(WORD_IGNORES), dictionary_(DICTIONARY_FAST),
+  vocab_size_(VOCAB_SIZE), lemma_time_(LEMMA_TIME), col_(NULL) {}
+
+int IntegerWriter::begin_file(const Corpus & corpus, const string & name) {
+  col_ = lemma_time_ ? corpus.lemma : corpus.word;
+
+  // -1 for words we skip, otherwise the dictionary index or VOCAB_SIZE for unknowns
+  lookup_.assign(corpus.header->num_strings, -1);
+  for (size_t i = 0; i < lookup_.size(); ++i) {
+    string val = s9::ToLower(corpus_string(corpus, i));
+    if (s9::IsAsciiPrintableString(val) && ignores_.find(val) == ignores_.end()) {
+      int id = dictionary_.find(val);
+      lookup_[i] = id < 0 ? vocab_size_ : id;
+    }
   }
 
-  // Finished all the files, now quit
-  std::ofstream wv_file (OUTPUT_DIR + "/word_vectors.txt");
-  if (wv_file.is_open()) {
-    size_t idx = 0;
-    for (vector<float> tv : WORD_VECTORS){
-      for (float tf : tv){
-        int ti = static_cast<int>(tf);
-        wv_file << s9::ToString(ti) << " ";
+  // Count the tokens we keep in each sentence, so we know where every sentence goes in the
+  // stream before any thread writes one
+  long num_sentences = corpus.header->num_sentences;
+  vector<uint64_t> starts (num_sentences + 1, 0);
+  uint64_t num_known = 0;
+
+  #pragma omp parallel for schedule(dynamic, 4096) reduction(+:num_known)
+  for (long s = 0; s < num_sentences; ++s) {
+    uint64_t kept = 0;
+    for (uint64_t i = corpus.sentences[s]; i < corpus.sentences[s+1]; ++i) {
+      int v = lookup_[col_[i]];
+      if (v >= 0) {
+        kept++;
+        if (v != vocab_size_) { num_known++; }
       }
-      wv_file << endl;
     }
-    wv_file.close();
-  } else {
-    cout << "Unable to open word_vec file for writing" << endl;
-    return 1;
+    starts[s + 1] = kept;
   }
+  std::partial_sum(starts.begin(), starts.end(), starts.begin());
 
-  return 0;
+  return file_.open(output_dir_ + "/integers_" + name, starts, num_known);
+}
+
+void IntegerWriter::sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) {
+  const uint64_t * sentences_end = corpus.sentences + corpus.header->num_sentences;
+  size_t s = std::lower_bound(corpus.sentences, sentences_end, start) - corpus.sentences;
+
+  uint32_t * out = file_.sentence(s);
+  for (uint64_t i = start; i < end; ++i) {
+    int v = lookup_[col_[i]];
+    if (v >= 0) { *out++ = v; }
+  }
 }
 
+int IntegerWriter::end_file(const Corpus & corpus) {
+  return file_.close();
+}
 
 /**
  * Convert ukwac to numbers as indices into the dictionary. Useful for tensorflow
@@ -495,93 +856,15 @@ int create_word_vectors(vector<string> filenames,
 int create_integers(vector<string> filenames,
     string OUTPUT_DIR, 
     set<string> & WORD_IGNORES,
-    map<string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     size_t VOCAB_SIZE,
     bool LEMMA_TIME) {
 
   cout << "Creating Integer Files" << endl;
-  // Scan directory for the files
-  for( string filepath : filenames) {
-    int num_blocks =1; 
-      
-    char ** block_pointer;
-    size_t * block_size;
-
-    // Cant pass this into _breakup sadly
-    // break the file we are looking at into chunks to process
-    file_mapping m_file(filepath.c_str(), read_only);
-    mapped_region region(m_file, read_only);  
-
-    int result = breakup(block_pointer, block_size, m_file, region, num_blocks );
-    if (result == -1){
-      return -1;
-    }  
-    
-    omp_set_num_threads(num_blocks);
-    #pragma omp parallel
-    {   
-      int block_id = omp_get_thread_num();
-      char *mem = block_pointer[block_id];
-      size_t file_count = 0;
-      std::string str;
-
-      string filename = OUTPUT_DIR + "/integers_" + s9::FilenameFromPath(filepath) + "_" + s9::ToString(block_id) + ".txt";
-      
-      std::ofstream int_file (filename);
-
-      if (!int_file.is_open()) {
-        cout << "ERROR: Unable to up " << filename << " for writing." << endl;
-      }
-
-      for(std::size_t i = 0; i < block_size[block_id]; ++i){
-        char data = *mem;
-        if (data != '\n' && data != '\r'){
-          str += data;
-        } else {       
-          // Can now look at the string and work on our FREQ
-          
-          vector<string> tokens = s9::SplitStringWhitespace(str);  
-          if (tokens.size() > 5) {
-            string val = s9::ToLower(tokens[0]);
-            
-            if (LEMMA_TIME) {
-              val = s9::ToLower(tokens[1]);
-            }
-
-            if (s9::IsAsciiPrintableString(val)){
-            
-              if (WORD_IGNORES.find(val) == WORD_IGNORES.end()){  
-      
-                if (DICTIONARY_FAST.find(val) == DICTIONARY_FAST.end()){
-                  int_file << s9::ToString(VOCAB_SIZE) << endl;
-                } else {
-                  int_file << s9::ToString( DICTIONARY_FAST[val] ) << endl;
-                  #pragma omp critical
-                  file_count++;
-                }
-              }
-            }
-          } 
-          str = "";
-        }
-        mem++;
-      }    
-      int_file.flush();
-      int_file.close();
-
-      filename = OUTPUT_DIR + "/size_" + s9::FilenameFromPath(filepath) + "_" + s9::ToString(block_id) + ".txt";
-      std::ofstream size_file (filename);
-      size_file << s9::ToString(file_count) << endl;
-      size_file.close();
-    }
 
-    // These need to be freed as breakup assigns them. A bit naughty
-    free(block_pointer);
-    free(block_size);
-
-  }
-
-  return 0;
+  IntegerWriter writer (OUTPUT_DIR, WORD_IGNORES, DICTIONARY_FAST, VOCAB_SIZE, LEMMA_TIME);
+  vector<SentenceConsumer*> consumers {&writer};
+  return corpus_scan(filenames, consumers);
 }
 
 
@@ -0,0 +1,123 @@
+/**
+* @brief The corpus as binary dictionary indices, for Tensorflow
+* @file wacky_integers.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_integers.hpp"
+
+#include <cstring>
+#include <algorithm>
+
+#include <boost/filesystem.hpp>
+
+using namespace boost::interprocess;
+using namespace std;
+
+/**
+ * Create the token stream for one ukwac file and map it for writing
+ * @param path_base the path without an extension, such as OUTPUT_DIR/integers_ukwac1
+ * @param starts where each sentence starts, num_sentences + 1 of them, the last being the
+ * number of tokens. We take these over.
+ * @param num_known how many of the tokens are in the dictionary
+ * @return int a value to say if we succeeded or not
+ */
+
+int IntegerFile::open(string path_base, vector<uint64_t> & starts, uint64_t num_known) {
+  path_base_ = path_base;
+  starts_.swap(starts);
+  num_known_ = num_known;
+  data_ = nullptr;
+
+  string path = path_base + INTEGER_DATA_EXTENSION;
+  std::ofstream data (path, std::ios::binary | std::ios::trunc);
+  if (!data.is_open()) {
+    cout << "ERROR: Unable to open " << path << " for writing." << endl;
+    return 1;
+  }
+  data.close();
+
+  // An empty stream can't be mapped, but it is still a stream
+  uint64_t size = starts_.back() * sizeof(uint32_t);
+  if (size == 0) { return 0; }
+
+  try {
+    boost::filesystem::resize_file(path, size);
+    file_mapping file (path.c_str(), read_write);
+    mapped_region region (file, read_write);
+    file_.swap(file);
+    region_.swap(region);
+  } catch (std::exception &ex) {
+    cout << "ERROR: Unable to map " << path << " for writing: " << ex.what() << endl;
+    return 1;
+  }
+
+  data_ = static_cast<uint32_t*>(region_.get_address());
+  return 0;
+}
+
+/**
+ * Finish the token stream and write the index beside it
+ * @return int a value to say if we succeeded or not
+ */
+
+int IntegerFile::close() {
+  int result = 0;
+  if (data_ != nullptr && !region_.flush()) { result = 1; }
+  mapped_region().swap(region_);
+  file_mapping().swap(file_);
+  data_ = nullptr;
+
+  // Sentences with no tokens start where the next one does
+  starts_.erase(std::unique(starts_.begin(), starts_.end()), starts_.end());
+
+  IntegerIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "WBI1", 4);
+  header.version = INTEGER_FILE_VERSION;
+  header.num_tokens = starts_.back();
+  header.num_known = num_known_;
+  header.num_sentences = starts_.size() - 1;
+
+  string path = path_base_ + INTEGER_INDEX_EXTENSION;
+  std::ofstream index (path, std::ios::binary);
+  if (!index.is_open()) {
+    cout << "Unable to open " << path << " for writing" << endl;
+    return 1;
+  }
+  index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  index.write(reinterpret_cast<const char*>(&starts_[0]), (header.num_sentences + 1) * sizeof(uint64_t));
+  index.close();
+
+  starts_.clear();
+  return result;
+}
+
+/**
+ * Read a file's index
+ * @param path the .idx file
+ * @param header the header we fill in
+ * @param sentences filled with the num_sentences + 1 sentence starts
+ * @return int a value to say if we succeeded or not
+ */
+
+int integer_index_read(string path, IntegerIndexHeader & header, vector<uint64_t> & sentences) {
+  std::ifstream index (path, std::ios::binary);
+  if (!index.is_open()) { return 1; }
+
+  index.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!index || memcmp(header.magic, "WBI1", 4) != 0 || header.version != INTEGER_FILE_VERSION) {
+    cout << path << " is not a version " << INTEGER_FILE_VERSION << " integer index" << endl;
+    return 1;
+  }
+
+  sentences.resize(header.num_sentences + 1);
+  index.read(reinterpret_cast<char*>(&sentences[0]), sentences.size() * sizeof(uint64_t));
+  if (!index) {
+    cout << path << " is truncated" << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,582 @@
+/**
+* @brief Similarities between Kronecker sums without building the dense tensors
+* @file wacky_kron.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_kron.hpp"
+
+using namespace std;
+
+// How many terms we take from each sum at once when building the gram matrices
+static const size_t KRN_TILE = 64;
+
+// How many terms go into each GEMM when we build a dense tensor
+static const size_t KRN_DENSE_TILE = 256;
+
+// How many rows of a packed tensor we fill with one GEMM
+static const int KRN_PACKED_ROWS = 64;
+
+// Go dense once the grams would cost more than this times the flops of building the dense
+// tensors. The dense build skips zeros and streams its rows so each flop is about three
+// times cheaper - at a basis of 300 the two cross over near 200 terms.
+static const double KRN_DENSE_RATIO = 1.0 / 3.0;
+
+/**
+ * Unpack a run of factor rows into one contiguous tile, applying the scale if there is one
+ * @param k the KronSum
+ * @param idx either k.left or k.right
+ * @param start the first term to copy
+ * @param count how many terms to copy
+ * @param tile where we copy to - count * basis floats
+ */
+
+static void krn_gather(const KronSum & k, const vector<int> & idx, size_t start, size_t count, float * tile) {
+  for (size_t i = 0; i < count; ++i) {
+    float * dst = tile + (i * k.basis);
+    krn_row(k, idx[start + i], dst);
+
+    if (!k.scale.empty()) {
+      for (int j = 0; j < k.basis; ++j) {
+        dst[j] *= k.scale[j];
+      }
+    }
+  }
+}
+
+/**
+ * The gram matrix between two tiles of rows, gram = t0 * t1^T
+ * @param t0 the first tile, n0 rows
+ * @param t1 the second tile, n1 rows
+ * @param basis the length of each row
+ * @param gram a KRN_TILE * KRN_TILE matrix we write into
+ */
+
+static void krn_gram(const float * t0, size_t n0, const float * t1, size_t n1, int basis, float * gram) {
+#ifdef _USE_MKL
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasTrans, n0, n1, basis, 1.0f, t0, basis, t1, basis, 0.0f, gram, KRN_TILE);
+#else
+  for (size_t i = 0; i < n0; ++i) {
+    const float * a = t0 + (i * basis);
+    for (size_t j = 0; j < n1; ++j) {
+      const float * b = t1 + (j * basis);
+      float dot = 0;
+      for (int m = 0; m < basis; ++m) {
+        dot += a[m] * b[m];
+      }
+      gram[(i * KRN_TILE) + j] = dot;
+    }
+  }
+#endif
+}
+
+/**
+ * Reset a KronSum so it has no terms
+ * @param k the KronSum to reset
+ * @param rows the word vectors that positive factor indices refer to
+ * @param basis the length of the factor vectors
+ */
+
+void krn_sum_init(KronSum & k, const SparseVectors & rows, int basis) {
+  k.basis = basis;
+  k.rows = &rows;
+  k.left.clear();
+  k.right.clear();
+  k.weight.clear();
+  k.extra.clear();
+  k.scale.clear();
+}
+
+/**
+ * Add the term weight * (rows[left] (x) rows[right])
+ * @param k the KronSum
+ * @param left the index of the left word vector
+ * @param right the index of the right word vector
+ * @param weight how much this term counts for
+ */
+
+void krn_sum_add(KronSum & k, int left, int right, float weight) {
+  k.left.push_back(left);
+  k.right.push_back(right);
+  k.weight.push_back(weight);
+}
+
+/**
+ * Add the term weight * (left (x) right) for vectors that are not word vectors
+ * @param k the KronSum
+ * @param left pointer to basis floats
+ * @param right pointer to basis floats
+ * @param weight how much this term counts for
+ */
+
+void krn_sum_add(KronSum & k, const float * left, const float * right, float weight) {
+  int li = -static_cast<int>(k.extra.size() / k.basis) - 1;
+  k.extra.insert(k.extra.end(), left, left + k.basis);
+
+  int ri = li;
+  if (right != left) {
+    ri = li - 1;
+    k.extra.insert(k.extra.end(), right, right + k.basis);
+  }
+
+  krn_sum_add(k, li, ri, weight);
+}
+
+/**
+ * Elementwise multiply a Kronecker sum by v (x) v. Each term a (x) b becomes (a o v) (x) (b o v)
+ * so we only need to remember v.
+ * @param r the KronSum we write into
+ * @param k the KronSum we start from
+ * @param v pointer to basis floats
+ */
+
+void krn_sum_hadamard(KronSum & r, const KronSum & k, const float * v) {
+  r = k;
+  if (r.scale.empty()) {
+    r.scale.assign(v, v + k.basis);
+  } else {
+    for (int i = 0; i < k.basis; ++i) {
+      r.scale[i] *= v[i];
+    }
+  }
+}
+
+/**
+ * Build the dense BASIS_SIZE x BASIS_SIZE tensor a Kronecker sum represents. If L and R hold
+ * the left and right factors as rows then the sum is L^T * diag(weight) * R, so we gather the
+ * rows a tile at a time and do one GEMM per tile instead of a rank-1 update per term.
+ * @param k the KronSum
+ * @param out basis * basis floats, row major, which we overwrite
+ * @param work where the tiles come from, or null to allocate them here
+ */
+
+void krn_sum_dense(const KronSum & k, float * out, Workspace * work) {
+  size_t n = k.weight.size();
+  int basis = k.basis;
+
+  std::fill(out, out + (static_cast<size_t>(basis) * basis), 0.0f);
+
+  Workspace own;
+  Workspace & w = work == nullptr ? own : *work;
+  size_t mark = w.mark();
+  float * lt = w.take(KRN_DENSE_TILE * basis);
+  float * rt = w.take(KRN_DENSE_TILE * basis);
+
+  for (size_t i = 0; i < n; i += KRN_DENSE_TILE) {
+    size_t ni = std::min(KRN_DENSE_TILE, n - i);
+    krn_gather(k, k.left, i, ni, lt);
+    krn_gather(k, k.right, i, ni, rt);
+
+    for (size_t a = 0; a < ni; ++a) {
+      float weight = k.weight[i + a];
+      if (weight != 1.0f) {
+        for (int j = 0; j < basis; ++j) { lt[(a * basis) + j] *= weight; }
+      }
+    }
+
+#ifdef _USE_MKL
+    cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, basis, basis, ni, 1.0f, lt, basis, rt, basis, 1.0f, out, basis);
+#else
+    // Each output row stays in cache while the whole tile is added into it
+    for (int r = 0; r < basis; ++r) {
+      float * orow = out + (static_cast<size_t>(r) * basis);
+      for (size_t a = 0; a < ni; ++a) {
+        float x = lt[(a * basis) + r];
+        if (x == 0.0f) { continue; }
+        const float * rrow = &rt[a * basis];
+        for (int c = 0; c < basis; ++c) {
+          orow[c] += x * rrow[c];
+        }
+      }
+    }
+#endif
+  }
+
+  w.rewind(mark);
+}
+
+/**
+ * Where row r starts in a packed upper triangle. Row r holds columns r to basis - 1.
+ * @param r the row
+ * @param basis the length of a full row
+ * @return the offset in floats
+ */
+
+static inline size_t krn_packed_row(int r, int basis) {
+  return (static_cast<size_t>(r) * basis) - ((static_cast<size_t>(r) * (r - 1)) / 2);
+}
+
+/**
+ * Build the packed upper triangle of a sum of self products, sum_i weight_i * (s_i (x) s_i).
+ * The tensor is symmetric, so this is a SYRK - we only work out the columns at or right of
+ * the diagonal, which is half the memory and half the multiplies of krn_sum_dense.
+ * @param k the KronSum, every term having the same left and right factor
+ * @param out krn_packed_size(basis) floats, which we overwrite
+ * @param work where the tiles come from, or null to allocate them here
+ */
+
+void krn_sum_packed(const KronSum & k, float * out, Workspace * work) {
+  size_t n = k.weight.size();
+  int basis = k.basis;
+
+  std::fill(out, out + krn_packed_size(basis), 0.0f);
+
+  Workspace own;
+  Workspace & w = work == nullptr ? own : *work;
+  size_t mark = w.mark();
+  float * lt = w.take(KRN_DENSE_TILE * basis);
+  float * rt = w.take(KRN_DENSE_TILE * basis);
+#ifdef _USE_MKL
+  float * block = w.take(static_cast<size_t>(KRN_PACKED_ROWS) * basis);
+#endif
+
+  for (size_t i = 0; i < n; i += KRN_DENSE_TILE) {
+    size_t ni = std::min(KRN_DENSE_TILE, n - i);
+    krn_gather(k, k.right, i, ni, rt);
+    std::copy(rt, rt + (ni * basis), lt);
+
+    for (size_t a = 0; a < ni; ++a) {
+      float weight = k.weight[i + a];
+      if (weight != 1.0f) {
+        for (int j = 0; j < basis; ++j) { lt[(a * basis) + j] *= weight; }
+      }
+    }
+
+#ifdef _USE_MKL
+    // One GEMM per band of rows, from the diagonal block rightwards, then keep the upper part
+    for (int r0 = 0; r0 < basis; r0 += KRN_PACKED_ROWS) {
+      int nr = std::min(KRN_PACKED_ROWS, basis - r0);
+      int nc = basis - r0;
+      cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, nr, nc, ni, 1.0f, lt + r0, basis, rt + r0, basis, 0.0f, block, nc);
+
+      for (int r = 0; r < nr; ++r) {
+        float * orow = out + krn_packed_row(r0 + r, basis);
+        const float * brow = &block[(static_cast<size_t>(r) * nc) + r];
+        for (int c = 0; c < nc - r; ++c) {
+          orow[c] += brow[c];
+        }
+      }
+    }
+#else
+    for (int r = 0; r < basis; ++r) {
+      float * orow = out + krn_packed_row(r, basis) - r;
+      for (size_t a = 0; a < ni; ++a) {
+        float x = lt[(a * basis) + r];
+        if (x == 0.0f) { continue; }
+        const float * rrow = &rt[a * basis];
+        for (int c = r; c < basis; ++c) {
+          orow[c] += x * rrow[c];
+        }
+      }
+    }
+#endif
+  }
+
+  w.rewind(mark);
+}
+
+/**
+ * Build the packed upper triangle of v (x) v
+ * @param v pointer to basis floats
+ * @param basis the length of v
+ * @param out krn_packed_size(basis) floats, which we overwrite
+ */
+
+void krn_packed_self(const float * v, int basis, float * out) {
+  for (int r = 0; r < basis; ++r) {
+    float * orow = out + krn_packed_row(r, basis) - r;
+    for (int c = r; c < basis; ++c) {
+      orow[c] = v[r] * v[c];
+    }
+  }
+}
+
+/**
+ * Find the cosine similarity between two symmetric tensors held as packed upper triangles.
+ * Every entry off the diagonal stands for two in the full tensor so counts twice.
+ * @param p0 the first packed tensor
+ * @param p1 the second packed tensor
+ * @param basis the length of a full row
+ * @return a float from 1.0 to 0.0 or 2.0 if there was an error
+ */
+
+float krn_packed_cosine_sim(const float * p0, const float * p1, int basis) {
+  double dot = 0, l0 = 0, l1 = 0;
+
+  for (int r = 0; r < basis; ++r) {
+    const float * a = p0 + krn_packed_row(r, basis);
+    const float * b = p1 + krn_packed_row(r, basis);
+    double rdot = 0, rl0 = 0, rl1 = 0;
+    for (int c = 1; c < basis - r; ++c) {
+      rdot += a[c] * b[c];
+      rl0 += a[c] * a[c];
+      rl1 += b[c] * b[c];
+    }
+    dot += (2.0 * rdot) + (a[0] * b[0]);
+    l0 += (2.0 * rl0) + (a[0] * a[0]);
+    l1 += (2.0 * rl1) + (b[0] * b[0]);
+  }
+
+  float dist = -1.0;
+  double d = sqrt(l0) * sqrt(l1);
+
+  if (d != 0.0) {
+    // Rounding can push a tensor's similarity with itself just past 1
+    float sim = std::max(-1.0f, std::min(1.0f, static_cast<float>(dot / d)));
+    dist = acos(sim) / M_PI;
+  }
+
+  return 1.0 - dist;
+}
+
+/**
+ * How many floats of Workspace krn_sum_packed takes - two tiles of rows, and a band of
+ * output rows when the bands are GEMMs
+ * @param basis the length of the factor vectors
+ * @return the number of floats
+ */
+
+size_t krn_packed_workspace_floats(int basis) {
+  size_t floats = 2 * Workspace::slice(KRN_DENSE_TILE * basis);
+#ifdef _USE_MKL
+  floats += Workspace::slice(static_cast<size_t>(KRN_PACKED_ROWS) * basis);
+#endif
+  return floats;
+}
+
+/**
+ * How many floats of Workspace krn_sum_dot takes - four tiles of rows and two gram matrices.
+ * The dense path builds its tensors a band of rows at a time in the same room.
+ * @param basis the length of the factor vectors
+ * @return the number of floats
+ */
+
+size_t krn_workspace_floats(int basis) {
+  return (4 * Workspace::slice(KRN_TILE * basis)) + (2 * Workspace::slice(KRN_TILE * KRN_TILE));
+}
+
+/**
+ * Whether building the dense tensors beats the gram matrices. The grams cost n0 * n1 * basis
+ * but the dense tensors only (n0 + n1) * basis^2, so long sums - frequent verbs with many
+ * subjects - are quicker dense.
+ * @param n0 the terms in the first sum
+ * @param n1 the terms in the second sum
+ * @param basis the length of the factor vectors
+ * @param same whether both sums are the same one, which we then build once
+ * @return true if we should go dense
+ */
+
+static bool krn_dense_cheaper(size_t n0, size_t n1, int basis, bool same) {
+  double gram = static_cast<double>(n0) * n1 * basis;
+  double dense = static_cast<double>(same ? n0 : n0 + n1) * basis * basis;
+  if (same) { gram *= 0.5; }
+  return dense * KRN_DENSE_RATIO < gram;
+}
+
+/**
+ * Build rows [r0, r0 + nr) of the dense tensor a Kronecker sum represents. Row r of the
+ * tensor is sum_i weight_i * left_i[r] * right_i, so we gather a tile of terms at a time and
+ * add each term's right factor into every row of the band.
+ * @param k the KronSum
+ * @param r0 the first row of the band
+ * @param nr how many rows, at most KRN_TILE
+ * @param band nr * basis floats, which we overwrite
+ * @param lt a tile of KRN_TILE * basis floats for the left factors
+ * @param rt a tile of KRN_TILE * basis floats for the right factors
+ * @param lw KRN_TILE * KRN_TILE floats for the weighted band columns of the left factors
+ */
+
+static void krn_dense_band(const KronSum & k, int r0, int nr, float * band, float * lt, float * rt, float * lw) {
+  size_t n = k.weight.size();
+  int basis = k.basis;
+  bool sym = k.left == k.right;
+
+  std::fill(band, band + (static_cast<size_t>(nr) * basis), 0.0f);
+
+  for (size_t i = 0; i < n; i += KRN_TILE) {
+    size_t ni = std::min(KRN_TILE, n - i);
+    krn_gather(k, k.right, i, ni, rt);
+    const float * lsrc = rt;
+    if (!sym) {
+      krn_gather(k, k.left, i, ni, lt);
+      lsrc = lt;
+    }
+
+    // Only the band's columns of the left factors are needed, weighted, as an ni x nr matrix
+    for (size_t a = 0; a < ni; ++a) {
+      float weight = k.weight[i + a];
+      for (int r = 0; r < nr; ++r) {
+        lw[(a * nr) + r] = lsrc[(a * basis) + r0 + r] * weight;
+      }
+    }
+
+#ifdef _USE_MKL
+    cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, nr, basis, ni, 1.0f, lw, nr, rt, basis, 1.0f, band, basis);
+#else
+    for (int r = 0; r < nr; ++r) {
+      float * brow = band + (static_cast<size_t>(r) * basis);
+      for (size_t a = 0; a < ni; ++a) {
+        float x = lw[(a * nr) + r];
+        if (x == 0.0f) { continue; }
+        const float * rrow = &rt[a * basis];
+        for (int c = 0; c < basis; ++c) {
+          brow[c] += x * rrow[c];
+        }
+      }
+    }
+#endif
+  }
+}
+
+/**
+ * The inner product of two Kronecker sums by building both dense tensors, a band of rows at a
+ * time so we never hold more than a few tiles rather than two basis^2 tensors
+ * @param k0 the first KronSum
+ * @param k1 the second KronSum
+ * @param w where the tiles and bands come from
+ * @return the inner product as a double
+ */
+
+static double krn_dense_dot(const KronSum & k0, const KronSum & k1, Workspace & w) {
+  int basis = k0.basis;
+  bool same = &k0 == &k1;
+  size_t mark = w.mark();
+
+  float * lt = w.take(KRN_TILE * basis);
+  float * rt = w.take(KRN_TILE * basis);
+  float * b0 = w.take(KRN_TILE * basis);
+  float * b1 = same ? b0 : w.take(KRN_TILE * basis);
+  float * lw = w.take(KRN_TILE * KRN_TILE);
+
+  double dot = 0;
+
+  for (int r0 = 0; r0 < basis; r0 += KRN_TILE) {
+    int nr = std::min(static_cast<int>(KRN_TILE), basis - r0);
+    size_t size = static_cast<size_t>(nr) * basis;
+    krn_dense_band(k0, r0, nr, b0, lt, rt, lw);
+    if (!same) { krn_dense_band(k1, r0, nr, b1, lt, rt, lw); }
+
+#ifdef _USE_MKL
+    dot += cblas_dsdot(size, b0, 1, b1, 1);
+#else
+    for (size_t i = 0; i < size; ++i) {
+      dot += static_cast<double>(b0[i]) * b1[i];
+    }
+#endif
+  }
+
+  w.rewind(mark);
+  return dot;
+}
+
+/**
+ * The inner product of the dense tensors two Kronecker sums represent. For short sums we use
+ * <a (x) b, c (x) d> = <a,c><b,d> so the cost is O(terms0 * terms1 * basis) and the memory
+ * is a few tiles rather than basis^2. Long sums are cheaper to build dense and dot, which we
+ * do a band of rows at a time in the same few tiles.
+ * @param k0 the first KronSum
+ * @param k1 the second KronSum
+ * @param work where the tiles come from, or null to allocate them here
+ * @return the inner product as a double
+ */
+
+double krn_sum_dot(const KronSum & k0, const KronSum & k1, Workspace * work) {
+  size_t n0 = k0.weight.size();
+  size_t n1 = k1.weight.size();
+  int basis = k0.basis;
+
+  // Sums of self products (subject (x) subject) have the same gram on both sides
+  bool sym = k0.left == k0.right && k1.left == k1.right;
+  bool same = &k0 == &k1;
+
+  Workspace own;
+  Workspace & w = work == nullptr ? own : *work;
+
+  if (krn_dense_cheaper(n0, n1, basis, same)) {
+    return krn_dense_dot(k0, k1, w);
+  }
+
+  size_t mark = w.mark();
+  float * l0 = w.take(KRN_TILE * basis);
+  float * r0 = w.take(KRN_TILE * basis);
+  float * l1 = w.take(KRN_TILE * basis);
+  float * r1 = w.take(KRN_TILE * basis);
+  float * gl = w.take(KRN_TILE * KRN_TILE);
+  float * gr = w.take(KRN_TILE * KRN_TILE);
+
+  double dot = 0;
+
+  for (size_t i = 0; i < n0; i += KRN_TILE) {
+    size_t ni = std::min(KRN_TILE, n0 - i);
+    krn_gather(k0, k0.left, i, ni, l0);
+    if (!sym) { krn_gather(k0, k0.right, i, ni, r0); }
+
+    // With the same sum on both sides we only need the upper triangle of tiles
+    for (size_t j = same ? i : 0; j < n1; j += KRN_TILE) {
+      size_t nj = std::min(KRN_TILE, n1 - j);
+      krn_gather(k1, k1.left, j, nj, l1);
+      krn_gram(l0, ni, l1, nj, basis, gl);
+
+      if (!sym) {
+        krn_gather(k1, k1.right, j, nj, r1);
+        krn_gram(r0, ni, r1, nj, basis, gr);
+      }
+
+      const float * g = sym ? gl : gr;
+      double tile = 0;
+
+      for (size_t a = 0; a < ni; ++a) {
+        double row = 0;
+        for (size_t b = 0; b < nj; ++b) {
+          size_t t = (a * KRN_TILE) + b;
+          row += static_cast<double>(k1.weight[j + b]) * gl[t] * g[t];
+        }
+        tile += row * k0.weight[i + a];
+      }
+
+      if (same && j != i) { tile *= 2.0; }
+      dot += tile;
+    }
+  }
+
+  w.rewind(mark);
+  return dot;
+}
+
+/**
+ * Find the cosine similarity between two Kronecker sums. This matches cosine_sim on the
+ * dense tensors.
+ * @param k0 the first KronSum
+ * @param k1 the second KronSum
+ * @return a float from 1.0 to 0.0 or 2.0 if there was an error
+ */
+
+float krn_cosine_sim(const KronSum & k0, const KronSum & k1) {
+  return krn_cosine_sim(k0, k1, krn_sum_dot(k0, k0), krn_sum_dot(k1, k1));
+}
+
+/**
+ * Find the cosine similarity between two Kronecker sums whose squared lengths we already know
+ * @param k0 the first KronSum
+ * @param k1 the second KronSum
+ * @param l0 krn_sum_dot(k0, k0)
+ * @param l1 krn_sum_dot(k1, k1)
+ * @param work where krn_sum_dot takes its tiles from, or null
+ * @return a float from 1.0 to 0.0 or 2.0 if there was an error
+ */
+
+float krn_cosine_sim(const KronSum & k0, const KronSum & k1, double l0, double l1, Workspace * work) {
+  float dist = -1.0;
+  double dot = krn_sum_dot(k0, k1, work);
+  double d = sqrt(l0) * sqrt(l1);
+
+  if (d != 0.0) {
+    // Rounding can push a tensor's similarity with itself just past 1
+    float sim = std::max(-1.0f, std::min(1.0f, static_cast<float>(dot / d)));
+    dist = acos(sim) / M_PI;
+  }
+
+  return 1.0 - dist;
+}
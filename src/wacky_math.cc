@@ -61,6 +61,18 @@ void krn_mul( vector<float> & a, vector<float> & b, vector<float> & r) {
  */
 
 float cosine_sim(vector<float> & v0, vector<float> & v1, int size) {
+  return cosine_sim(&v0[0], &v1[0], size);
+}
+
+/**
+ * Find the cosine similarity between two runs of floats, such as Workspace slices
+ * @param v0 pointer to size floats
+ * @param v1 pointer to size floats
+ * @param size how many floats
+ * @return a float from 1.0 to 0.0 or 2.0 if there was an error
+ */
+
+float cosine_sim(const float * v0, const float * v1, int size) {
   float dist = -1.0;  
   float dot = 0;
   float l0 = 0;
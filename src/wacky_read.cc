@@ -19,18 +19,16 @@ using namespace std;
  * @return int a value to say if we succeeded or not
  */
 
-int read_dictionary(string OUTPUT_DIR, map<string,int> & DICTIONARY_FAST, vector<string> & DICTIONARY, size_t & VOCAB_SIZE){
+int read_dictionary(string OUTPUT_DIR, Dictionary & DICTIONARY_FAST, vector<string> & DICTIONARY, size_t & VOCAB_SIZE){
 
   std::ifstream dictionary_file (OUTPUT_DIR + "/dictionary.txt");
   string line;
-  size_t idx = 0;
   
   if (dictionary_file.is_open()) {
     while ( getline (dictionary_file,line) ) {
       string word = s9::RemoveChar(line,'\n'); 
       DICTIONARY.push_back(word);
-      DICTIONARY_FAST[word] = idx;
-      idx+=1;
+      DICTIONARY_FAST.insert(word);
     }
     VOCAB_SIZE = DICTIONARY.size();
     return 0;
@@ -88,10 +86,29 @@ int read_insist_words(std::string OUTPUT_DIR, std::set<std::string> & INSIST_BAS
 }
 
 
+/**
+ * Check the first line of a verb list file is the VERB_LIST_HEADER we write. Older files
+ * have no header and hold one number per entry, which the stride check alone can miss.
+ * @param list_file the open file
+ * @param name the name of the file, for the error
+ * @param stride how many numbers make up one entry
+ * @return int value to say if we succeeded or not
+ */
+
+static int read_verb_list_header(std::ifstream & list_file, string name, int stride) {
+  string want = string(VERB_LIST_HEADER) + " " + s9::ToString(stride);
+  string line;
+  if (!getline(list_file, line) || s9::RemoveChar(line, '\r') != want) {
+    cout << name << " does not start with '" << want << "'. It was written by an older wacky so run -b again" << endl;
+    return 1;
+  }
+  return 0;
+}
+
 /**
  * Read in the file that contains verb subjects
  * @param OUTPUT_DIR the output directory
- * @param VERB_SUBJECTS a vector of vector of ints we shall file
+ * @param VERB_SUBJECTS a vector of vector of (subject, count) pairs we shall fill
  * @return int value to say if we succeeded or not
  */
 
@@ -102,11 +119,16 @@ int read_subject_file(string OUTPUT_DIR, vector< vector<int> > & VERB_SUBJECTS)
   cout << "Reading Subject File" << endl;
 
   if (total_file.is_open()) {
+    if (read_verb_list_header(total_file, "verb_subjects.txt", 2) != 0) { return 1; }
     while ( getline (total_file,line) ) {
       line = s9::RemoveChar(line,'\n');
       vector<string> tokens =  s9::SplitStringWhitespace(line);
 
       if (tokens.size() > 1) {
+        if ((tokens.size() - 1) % 2 != 0) {
+          cout << "verb_subjects.txt is not in (subject, count) form" << endl;
+          return 1;
+        }
         int idx = s9::FromString<int>(tokens[0]);
         for (int i= 1; i < tokens.size(); ++i) {
           int sbj_idx = s9::FromString<int>(tokens[i]);
@@ -122,7 +144,7 @@ int read_subject_file(string OUTPUT_DIR, vector< vector<int> > & VERB_SUBJECTS)
 /**
  * Read the subject object pairing file
  * @param OUTPUT_DIR the output directory
- * @param VERB_SBJ_OBJ a vector of vector of ints we shall file
+ * @param VERB_SBJ_OBJ a vector of vector of (subject, object, count) triples we shall fill
  * @return int value to say if we succeeded or not
  */
 
@@ -133,11 +155,16 @@ int read_subject_object_file(string OUTPUT_DIR, vector< vector<int> > & VERB_SBJ
   cout << "Reading Subject Object File" << endl;
 
   if (total_file.is_open()) {
+    if (read_verb_list_header(total_file, "verb_sbj_obj.txt", 3) != 0) { return 1; }
     while ( getline (total_file,line) ) {
       line = s9::RemoveChar(line,'\n');
       vector<string> tokens =  s9::SplitStringWhitespace(line);
 
       if (tokens.size() > 1) {
+        if ((tokens.size() - 1) % 3 != 0) {
+          cout << "verb_sbj_obj.txt is not in (subject, object, count) form" << endl;
+          return 1;
+        }
         for (int i= 1; i < tokens.size(); ++i) {
           int idx = s9::FromString<int>(tokens[i]);
           VERB_SBJ_OBJ[s9::FromString<int>(tokens[0])].push_back(idx);
@@ -314,7 +341,7 @@ int read_freq(string OUTPUT_DIR, map<string, size_t> & FREQ, vector< pair<string
   return 1;
 }
 
-void generate_words_to_check(set<int> & WORDS_TO_CHECK, vector< vector<int> > & VERB_SBJ_OBJ, vector< vector<int> > & VERB_SUBJECTS, vector< vector<int> > & VERB_OBJECTS, vector<VerbPair> & VERBS_TO_CHECK, map<string,int> DICTIONARY_FAST ) {
+void generate_words_to_check(set<int> & WORDS_TO_CHECK, vector< vector<int> > & VERB_SBJ_OBJ, vector< vector<int> > & VERB_SUBJECTS, vector< vector<int> > & VERB_OBJECTS, vector<VerbPair> & VERBS_TO_CHECK, Dictionary & DICTIONARY_FAST ) {
 
   for (VerbPair vp : VERBS_TO_CHECK){
     int idx0 = DICTIONARY_FAST[vp.v0];
@@ -323,27 +350,29 @@ void generate_words_to_check(set<int> & WORDS_TO_CHECK, vector< vector<int> > &
     WORDS_TO_CHECK.insert(idx0);
     WORDS_TO_CHECK.insert(idx1);
 
-    for (int j =0; j < VERB_SBJ_OBJ[idx0].size(); ++j){
-      WORDS_TO_CHECK.insert(VERB_SBJ_OBJ[idx0][j]);      
+    for (int j =0; j < VERB_SBJ_OBJ[idx0].size(); j+=3){
+      WORDS_TO_CHECK.insert(VERB_SBJ_OBJ[idx0][j]);
+      WORDS_TO_CHECK.insert(VERB_SBJ_OBJ[idx0][j+1]);
     }
 
-    for (int j =0; j < VERB_SBJ_OBJ[idx1].size(); ++j){
-      WORDS_TO_CHECK.insert(VERB_SBJ_OBJ[idx1][j]);      
+    for (int j =0; j < VERB_SBJ_OBJ[idx1].size(); j+=3){
+      WORDS_TO_CHECK.insert(VERB_SBJ_OBJ[idx1][j]);
+      WORDS_TO_CHECK.insert(VERB_SBJ_OBJ[idx1][j+1]);
     }
     
-    for (int j =0; j < VERB_SUBJECTS[idx0].size(); ++j){
+    for (int j =0; j < VERB_SUBJECTS[idx0].size(); j+=2){
       WORDS_TO_CHECK.insert(VERB_SUBJECTS[idx0][j]);      
     }
 
-    for (int j =0; j < VERB_SUBJECTS[idx1].size(); ++j){
+    for (int j =0; j < VERB_SUBJECTS[idx1].size(); j+=2){
       WORDS_TO_CHECK.insert(VERB_SUBJECTS[idx1][j]);      
     }
     
-    for (int j =0; j < VERB_OBJECTS[idx0].size(); ++j){
+    for (int j =0; j < VERB_OBJECTS[idx0].size(); j+=2){
       WORDS_TO_CHECK.insert(VERB_OBJECTS[idx0][j]);      
     }
 
-    for (int j =0; j < VERB_OBJECTS[idx1].size(); ++j){
+    for (int j =0; j < VERB_OBJECTS[idx1].size(); j+=2){
       WORDS_TO_CHECK.insert(VERB_OBJECTS[idx1][j]);      
     }  
   }
@@ -352,18 +381,139 @@ void generate_words_to_check(set<int> & WORDS_TO_CHECK, vector< vector<int> > &
 
 
 /**
- * Read in the word vector counts for analysis. It converts the vectors to probabilities
+ * Turn the non-zero counts of one row of word_vectors into PMI values and add them as a sparse row
+ * @param cols the columns of the counts
+ * @param counts the non-zero counts for the row
+ * @param idx the dictionary index of the word this row is for
+ * @param FREQ the map of frequency
+ * @param DICTIONARY the dictionary
+ * @param BASIS_VECTOR the vector of ints that represents the basis
+ * @param TOTAL_COUNT the total count of all the words in ukwac
+ * @param WORD_VECTORS the sparse rows we are adding to
+ */
+
+static void push_row_pmi(const vector<int> & cols, vector<float> & counts, size_t idx, map<string, size_t> & FREQ, vector<string> & DICTIONARY, vector<int>  & BASIS_VECTOR, size_t TOTAL_COUNT, SparseVectors & WORD_VECTORS) {
+  for (int k =0; k < counts.size(); ++k) {
+    float ct = static_cast<float>(FREQ[DICTIONARY[BASIS_VECTOR[cols[k]]]]);
+    float pmi = 0;
+    if (ct != 0.0){          
+      float cc = static_cast<float>(FREQ[DICTIONARY[idx]]);
+      if (cc != 0.0) {
+        float cct = counts[k];
+        if (cct != 0.0) {
+          pmi = log( (cct/ ct) / (cc / static_cast<float>(TOTAL_COUNT)));
+        }
+      }
+    }
+    counts[k] = pmi;
+  }
+
+  sparse_push_row(WORD_VECTORS, cols, counts);
+}
+
+/**
+ * Turn one line of word_vectors.txt into the columns and values of its non-zero counts
+ * @param line the line
+ * @param cols set to the columns of the non-zero counts
+ * @param counts set to the counts
+ */
+
+static void count_row_text(const string & line, vector<int> & cols, vector<float> & counts) {
+  vector<string> tokens = s9::SplitStringWhitespace(line);
+  cols.clear();
+  counts.clear();
+  for (int i=0; i < tokens.size(); ++i) {
+    float cct = s9::FromString<float>(tokens[i]);
+    if (cct != 0.0) {
+      cols.push_back(i);
+      counts.push_back(cct);
+    }
+  }
+}
+
+/**
+ * Map the binary word vectors if they are there and up to date
+ * @param OUTPUT_DIR the output directory
+ * @param vf the VectorFile to open
+ * @param DICTIONARY the dictionary; we never read past its last word
+ * @param num_rows set to how many rows we shall read
+ * @return true if we can read from vf rather than word_vectors.txt
+ */
+
+static bool open_vector_file(string OUTPUT_DIR, VectorFile & vf, vector<string> & DICTIONARY, size_t & num_rows) {
+  if (!vector_file_current(OUTPUT_DIR) || vector_file_open(vf, OUTPUT_DIR + "/" + VECTOR_FILE_NAME) != 0) {
+    return false;
+  }
+  num_rows = std::min(static_cast<size_t>(vf.header->num_rows), DICTIONARY.size());
+  return true;
+}
+
+/**
+ * If the word vectors came from a targeted count, check it counted every word we want.
+ * The rows it skipped are zeroes that look just like real ones.
+ * @param OUTPUT_DIR the output directory
+ * @param WORDS_TO_CHECK the dictionary indices we are about to read
+ * @return int 0 if every word was counted
+ */
+
+static int check_word_targets(string OUTPUT_DIR, const set<int> & WORDS_TO_CHECK) {
+  std::ifstream targets_file (OUTPUT_DIR + "/" + TARGETS_FILE_NAME);
+  if (!targets_file.is_open()) { return 0; }
+
+  set<int> counted;
+  int w;
+  while (targets_file >> w) { counted.insert(w); }
+
+  size_t missing = 0;
+  for (int idx : WORDS_TO_CHECK) {
+    if (counted.find(idx) == counted.end()) { missing++; }
+  }
+
+  if (missing > 0) {
+    cout << missing << " of the " << WORDS_TO_CHECK.size() << " words to check were left out of the targeted word vector count in "
+      << OUTPUT_DIR << ". Run -w -T again with this simverb file, or -w without -T" << endl;
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * Read in the word vector counts for analysis. It converts the vectors to probabilities.
+ * Every word gets a row but only those in WORDS_TO_CHECK have anything in them, and we
+ * only keep the non-zero PMI values. If VECTOR_FILE_NAME is current we map it and read
+ * the checked rows straight out of it.
  * @param OUTPUT_DIR the output directory
  * @param FREQ the map of frequency
  * @param DICTIONARY the dictionary
  * @param BASIS_VECTOR the vector of ints that represents the basis
- * @param WORD_VECTORS the vector of vectors we shall fill
+ * @param WORD_VECTORS the sparse rows we shall fill
  * @param TOTAL_COUNT the total count of all the words in ukwac
  * @return int whether we succeeded or not
  */
 
-int read_count(string OUTPUT_DIR, map<string, size_t> & FREQ, vector<string> & DICTIONARY, vector<int>  & BASIS_VECTOR, vector< vector<float> > & WORD_VECTORS, size_t TOTAL_COUNT, set<int> & WORDS_TO_CHECK) {
+int read_count(string OUTPUT_DIR, map<string, size_t> & FREQ, vector<string> & DICTIONARY, vector<int>  & BASIS_VECTOR, SparseVectors & WORD_VECTORS, size_t TOTAL_COUNT, set<int> & WORDS_TO_CHECK) {
   cout << "Reading the word_vectors count" << endl;
+  if (check_word_targets(OUTPUT_DIR, WORDS_TO_CHECK) != 0) { return 1; }
+
+  WORD_VECTORS = SparseVectors();
+  vector<int> cols;
+  vector<float> counts;
+
+  VectorFile vf;
+  size_t num_rows;
+  if (open_vector_file(OUTPUT_DIR, vf, DICTIONARY, num_rows)) {
+    WORD_VECTORS.num_cols = vf.header->num_cols;
+    for (size_t idx = 0; idx < num_rows; ++idx) {
+      if (WORDS_TO_CHECK.find(idx) != WORDS_TO_CHECK.end()) {
+        vector_file_row(vf, idx, cols, counts);
+        push_row_pmi(cols, counts, idx, FREQ, DICTIONARY, BASIS_VECTOR, TOTAL_COUNT, WORD_VECTORS);
+      } else {
+        sparse_push_empty(WORD_VECTORS);
+      }
+    }
+    return 0;
+  }
+
   std::ifstream count_file (OUTPUT_DIR + "/word_vectors.txt");
   string line;
   size_t idx = 0;
@@ -372,50 +522,52 @@ int read_count(string OUTPUT_DIR, map<string, size_t> & FREQ, vector<string> & D
     return 1;
   }
 
+  WORD_VECTORS.num_cols = BASIS_VECTOR.size();
   while ( getline (count_file,line) && idx < DICTIONARY.size()) {
-    line = s9::RemoveChar(line,'\n');
-    vector<string> tokens = s9::SplitStringWhitespace(line);
-   
-    vector<float> tv; 
-
     if (WORDS_TO_CHECK.find(idx) != WORDS_TO_CHECK.end())  {
-
-      for (int i =0; i < tokens.size(); ++i) {
-        float ct = static_cast<float>(FREQ[DICTIONARY[BASIS_VECTOR[i]]]);
-        float pmi = 0;
-
-        if (ct != 0.0){          
-          float cc = static_cast<float>(FREQ[DICTIONARY[idx]]);
-          if (cc != 0.0) {
-            float cct = s9::FromString<float>(tokens[i]);
-            if (cct != 0.0) {
-              pmi = log( (cct/ ct) / (cc / static_cast<float>(TOTAL_COUNT)));
-            }
-          }
-        }
-        tv.push_back(pmi);
-
-      }
+      count_row_text(s9::RemoveChar(line,'\n'), cols, counts);
+      push_row_pmi(cols, counts, idx, FREQ, DICTIONARY, BASIS_VECTOR, TOTAL_COUNT, WORD_VECTORS);
+    } else {
+      sparse_push_empty(WORD_VECTORS);
     }
-
-    WORD_VECTORS.push_back(tv);
     idx++;
   }
   return 0;
 }
 
-
 /**
- * Read in the word vector counts for analysis. We keep the RAW values
+ * Read in the word vector counts for analysis. We keep the RAW values.
+ * As with read_count only the rows in WORDS_TO_CHECK have anything in them.
  * @param OUTPUT_DIR the output directory
  * @param DICTIONARY the dictionary
  * @param BASIS_VECTOR the vector of ints that represents the basis
- * @param WORD_VECTORS the vector of vectors we shall fill
+ * @param WORD_VECTORS the sparse rows we shall fill
  * @return int whether we succeeded or not
  */
 
-int read_count_raw(string OUTPUT_DIR, vector<string> & DICTIONARY, vector<int>  & BASIS_VECTOR, vector< vector<float> > & WORD_VECTORS, set<int> & WORDS_TO_CHECK) {
+int read_count_raw(string OUTPUT_DIR, vector<string> & DICTIONARY, vector<int>  & BASIS_VECTOR, SparseVectors & WORD_VECTORS, set<int> & WORDS_TO_CHECK) {
   cout << "Reading the word_vectors count" << endl;
+  if (check_word_targets(OUTPUT_DIR, WORDS_TO_CHECK) != 0) { return 1; }
+
+  WORD_VECTORS = SparseVectors();
+  vector<int> cols;
+  vector<float> counts;
+
+  VectorFile vf;
+  size_t num_rows;
+  if (open_vector_file(OUTPUT_DIR, vf, DICTIONARY, num_rows)) {
+    WORD_VECTORS.num_cols = vf.header->num_cols;
+    for (size_t idx = 0; idx < num_rows; ++idx) {
+      if (WORDS_TO_CHECK.find(idx) != WORDS_TO_CHECK.end()) {
+        vector_file_row(vf, idx, cols, counts);
+        sparse_push_row(WORD_VECTORS, cols, counts);
+      } else {
+        sparse_push_empty(WORD_VECTORS);
+      }
+    }
+    return 0;
+  }
+
   std::ifstream count_file (OUTPUT_DIR + "/word_vectors.txt");
   string line;
   size_t idx = 0;
@@ -424,23 +576,15 @@ int read_count_raw(string OUTPUT_DIR, vector<string> & DICTIONARY, vector<int>
     return 1;
   }
 
+  WORD_VECTORS.num_cols = BASIS_VECTOR.size();
   while ( getline (count_file,line) && idx < DICTIONARY.size()) {
-    line = s9::RemoveChar(line,'\n');
-    vector<string> tokens = s9::SplitStringWhitespace(line);
-   
-    vector<float> tv; 
-
     if (WORDS_TO_CHECK.find(idx) != WORDS_TO_CHECK.end())  {
-      for (int i=0; i < tokens.size(); ++i) {
-        float cct = s9::FromString<float>(tokens[i]);
-        tv.push_back(cct);
-      }
+      count_row_text(s9::RemoveChar(line,'\n'), cols, counts);
+      sparse_push_row(WORD_VECTORS, cols, counts);
+    } else {
+      sparse_push_empty(WORD_VECTORS);
     }
-
-    WORD_VECTORS.push_back(tv);
     idx++;
   }
   return 0;
 }
-
-
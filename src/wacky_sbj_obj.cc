@@ -11,60 +11,53 @@
 using namespace boost::numeric;
 using namespace std;
 
+typedef VerbCache< ublas::vector<float> > TensorCache;
+
 /**
  * Given a verb, return the sums of the subjects and objects
  * @param verb a string we are looking at
  * @param DICTIONARY_FAST the fast lookup dictionary
- * @param VERB_SBJ_OBJ the vector of vectors of subjects and objects
+ * @param VERB_SBJ_OBJ the vector of vectors of (subject, object, count) triples
  * @param WORD_VECTORS the word vectors converted to probabilities
  * @param BASIS_SIZE the size of our word vectors
  * @param base_vector a ublas vector of verb x verb 
  * @param sum_subject a ublas vector of verb subjects summed
  * @param sum_object a ublas vector of the verb objects summed
- * @param sum_krn a ublas vector of the verb subs objs kroneckered
+ * @param sum_krn the verb subs objs kroneckered, kept as a KronSum
  */
 
-void read_subjects_objects(string verb, map<string,int> & DICTIONARY_FAST,
+void read_subjects_objects(string verb, Dictionary & DICTIONARY_FAST,
     vector< vector<int> > & VERB_SBJ_OBJ,
-    vector< vector<float> > & WORD_VECTORS,
+    SparseVectors & WORD_VECTORS,
     int BASIS_SIZE,
     ublas::vector<float> & base_vector,
     ublas::vector<float> & sum_subject,
     ublas::vector<float> & sum_object,
-    ublas::vector<float> & sum_krn) {
+    KronSum & sum_krn) {
 
   int vidx = DICTIONARY_FAST[verb];
-  vector<int> subs_obs = VERB_SBJ_OBJ[vidx];
+  vector<int> & subs_obs = VERB_SBJ_OBJ[vidx];
 
-  for (int i=0; i < BASIS_SIZE; ++i){
-    base_vector(i) = WORD_VECTORS[vidx][i];
-  } 
+  sparse_row_dense(WORD_VECTORS, vidx, &base_vector(0));
  
   for (int i=0; i < BASIS_SIZE; ++i){
     sum_subject(i) = 0.0f;
     sum_object(i) = 0.0f;
-    
-    for (int j=0; j < BASIS_SIZE; ++j){
-      sum_krn((BASIS_SIZE * i)+j) = 1.0f;
-    }
   }
 
-  for (int i =0; i < subs_obs.size(); i+=2) {
-    ublas::vector<float> sbj_vector (BASIS_SIZE);
-    ublas::vector<float> obj_vector (BASIS_SIZE);
+  // The dense tensor always started as all ones, which is the single term 1 (x) 1
+  vector<float> ones (BASIS_SIZE, 1.0f);
+  krn_sum_init(sum_krn, WORD_VECTORS, BASIS_SIZE);
+  krn_sum_add(sum_krn, &ones[0], &ones[0], 1.0f);
 
-    for (int j =0; j < BASIS_SIZE; ++j) {
-      sbj_vector(j) = WORD_VECTORS[ subs_obs[i] ][j];
-      obj_vector(j) = WORD_VECTORS[ subs_obs[i+1] ][j];
-    }
- 
-    ublas::vector<float> tk = krn_mul(sbj_vector, obj_vector);
-      
-    sum_krn = sum_krn + tk;
-    
-    sum_subject = sum_subject + sbj_vector;
-    sum_object = sum_object + obj_vector;
-  
+  // Each (subject, object, count) triple stands in for count identical terms
+  for (int i =0; i < subs_obs.size(); i+=3) {
+    float count = static_cast<float>(subs_obs[i+2]);
+
+    krn_sum_add(sum_krn, subs_obs[i], subs_obs[i+1], count);
+
+    sparse_axpy(WORD_VECTORS, subs_obs[i], count, &sum_subject(0));
+    sparse_axpy(WORD_VECTORS, subs_obs[i+1], count, &sum_object(0));
   }
 
 }
@@ -73,52 +66,43 @@ void read_subjects_objects(string verb, map<string,int> & DICTIONARY_FAST,
  * Given a verb, return the sums of the subjects and objects
  * @param verb a string we are looking at
  * @param DICTIONARY_FAST the fast lookup dictionary
- * @param VERB_SBJ_OBJ the vector of vectors of subjects and objects
+ * @param VERB_SBJ_OBJ the vector of vectors of (subject, object, count) triples
  * @param WORD_VECTORS the word vectors converted to probabilities
  * @param BASIS_SIZE the size of our word vectors
  * @param base_vector a ublas vector of verb x verb 
  * @param sum_subject a ublas vector of verb subjects summed
- * @param sum_krn a ublas vector of the verb subs objs kroneckered
+ * @param sum_krn the verb subs objs kroneckered, kept as a KronSum
  */
 
-void read_subjects_objects_few(string verb, map<string,int> & DICTIONARY_FAST,
+void read_subjects_objects_few(string verb, Dictionary & DICTIONARY_FAST,
     vector< vector<int> > & VERB_SBJ_OBJ,
-    vector< vector<float> > & WORD_VECTORS,
+    SparseVectors & WORD_VECTORS,
     int BASIS_SIZE,
     ublas::vector<float> & base_vector,
     ublas::vector<float> & sum_subject,
-    ublas::vector<float> & sum_krn) {
+    KronSum & sum_krn) {
 
   int vidx = DICTIONARY_FAST[verb];
-  vector<int> subs_obs = VERB_SBJ_OBJ[vidx];
+  vector<int> & subs_obs = VERB_SBJ_OBJ[vidx];
 
-  for (int i=0; i < BASIS_SIZE; ++i){
-    base_vector(i) = WORD_VECTORS[vidx][i];
-  } 
+  sparse_row_dense(WORD_VECTORS, vidx, &base_vector(0));
  
   for (int i=0; i < BASIS_SIZE; ++i){
     sum_subject(i) = 0.0f;
-    
-    for (int j=0; j < BASIS_SIZE; ++j){
-      sum_krn((BASIS_SIZE * i)+j) = 1.0f;
-    }
   }
 
-  for (int i =0; i < subs_obs.size(); i+=2) {
-    ublas::vector<float> sbj_vector (BASIS_SIZE);
-    ublas::vector<float> obj_vector (BASIS_SIZE);
+  // The dense tensor always started as all ones, which is the single term 1 (x) 1
+  vector<float> ones (BASIS_SIZE, 1.0f);
+  krn_sum_init(sum_krn, WORD_VECTORS, BASIS_SIZE);
+  krn_sum_add(sum_krn, &ones[0], &ones[0], 1.0f);
 
-    for (int j =0; j < BASIS_SIZE; ++j) {
-      sbj_vector(j) = WORD_VECTORS[ subs_obs[i] ][j];
-      obj_vector(j) = WORD_VECTORS[ subs_obs[i+1] ][j];
-    }
- 
-    ublas::vector<float> tk = krn_mul(sbj_vector, obj_vector);
-      
-    sum_krn = sum_krn + tk;
-    
-    sum_subject = sum_subject + sbj_vector + obj_vector;
-  
+  // Each (subject, object, count) triple stands in for count identical terms
+  for (int i =0; i < subs_obs.size(); i+=3) {
+    float count = static_cast<float>(subs_obs[i+2]);
+
+    krn_sum_add(sum_krn, subs_obs[i], subs_obs[i+1], count);
+
+    sparse_axpy(WORD_VECTORS, subs_obs[i], subs_obs[i+1], count, &sum_subject(0));
   }
 
 }
@@ -129,55 +113,57 @@ void read_subjects_objects_few(string verb, map<string,int> & DICTIONARY_FAST,
  * Given a verb, return the sums of the subjects and objects
  * @param verb a string we are looking at
  * @param DICTIONARY_FAST the fast lookup dictionary
- * @param VERB_SUBJECTS the vector of vectors of verb subjects
+ * @param VERB_SUBJECTS the vector of vectors of (subject, count) pairs
  * @param WORD_VECTORS the word vectors converted to probabilities
  * @param BASIS_SIZE the size of our word vectors
  * @param base_vector a ublas vector of verb x verb 
  * @param add_vector a ublas vector of subjects added
  * @param min_vector a ublas vector of minimums
  * @param max_vector a ublas vector of maximums 
- * @param krn_vector a ublas vector of verb (x) verb
+ * @param krn_vector the packed upper triangle of the subjects (x) themselves, left alone if empty
+ * @param krn_sum the subjects (x) themselves, kept as a KronSum
+ * @param work where krn_sum_packed takes its tiles from, or null to allocate them
  */
 
 
-void read_subjects(string verb, map<string,int> & DICTIONARY_FAST,
+void read_subjects(string verb, Dictionary & DICTIONARY_FAST,
     vector< vector<int> > & VERB_SUBJECTS,
-    vector< vector<float> > & WORD_VECTORS,
+    SparseVectors & WORD_VECTORS,
     int BASIS_SIZE,
     ublas::vector<float> & base_vector,
     ublas::vector<float> & add_vector,
     ublas::vector<float> & min_vector,
     ublas::vector<float> & max_vector,
-    ublas::vector<float> & krn_vector) {
+    ublas::vector<float> & krn_vector,
+    KronSum & krn_sum,
+    Workspace * work) {
  
   int vidx = DICTIONARY_FAST[verb];
-  vector<int> subjects = VERB_SUBJECTS[vidx];
+  vector<int> & subjects = VERB_SUBJECTS[vidx];
 
-  for (int i=0; i < BASIS_SIZE; ++i){
-    base_vector[i] = WORD_VECTORS[vidx][i];
-  } 
+  sparse_row_dense(WORD_VECTORS, vidx, &base_vector(0));
  
   for (int i=0; i < BASIS_SIZE; ++i){
     add_vector[i] = 0.0f;
     min_vector[i] = 10000000.0f; // TODO - replace with EPSILON
     max_vector[i] = -100000000.0f;
-    
-    for (int j=0; j < BASIS_SIZE; ++j){
-      krn_vector[(BASIS_SIZE * i) + j] = 0.0f;
-    }
   }
 
-  for (int i : subjects) {
-    ublas::vector<float> sbj_vector (BASIS_SIZE);
-  
-    for (int j =0; j < BASIS_SIZE; ++j) {
-      sbj_vector[j] = WORD_VECTORS[i][j];
-    }
+  // The subject (x) subject terms are summed with one GEMM per block of subjects at the end
+  krn_sum_init(krn_sum, WORD_VECTORS, BASIS_SIZE);
 
-    add_vector = add_vector + sbj_vector;
-    ublas::vector<float> tk  = krn_mul(sbj_vector, sbj_vector);
-      
-    krn_vector = krn_vector + tk;
+  // The min and max go over every column, zeroes included, so each subject is unpacked for them
+  vector<float> sbj_vector;
+
+  // subjects holds (subject, count) pairs
+  for (int s = 0; s < subjects.size(); s+=2) {
+    int i = subjects[s];
+    float count = static_cast<float>(subjects[s+1]);
+    sparse_row_dense(WORD_VECTORS, i, sbj_vector);
+
+    sparse_axpy(WORD_VECTORS, i, count, &add_vector[0]);
+
+    krn_sum_add(krn_sum, i, i, count);
 
     // Min and max vectors
     for (int j =0; j < BASIS_SIZE; ++j){
@@ -188,53 +174,51 @@ void read_subjects(string verb, map<string,int> & DICTIONARY_FAST,
       }
     } 
   }
+
+  if (krn_vector.size() > 0) {
+    krn_sum_packed(krn_sum, &krn_vector(0), work);
+  }
 }
 
 /**
  * Given a verb, return the sums of the subjects and objects
  * @param verb a string we are looking at
  * @param DICTIONARY_FAST the fast lookup dictionary
- * @param VERB_SUBJECTS the vector of vectors of verb subjects
+ * @param VERB_SUBJECTS the vector of vectors of (subject, count) pairs
  * @param WORD_VECTORS the word vectors converted to probabilities
  * @param BASIS_SIZE the size of our word vectors
  * @param base_vector a ublas vector of verb x verb 
  * @param add_vector a ublas vector of subjects added
- * @param krn_vector a ublas vector of verb (x) verb
+ * @param krn_vector the verb subjects (x) themselves, kept as a KronSum
  */
 
-void read_subjects_few(string verb, map<string,int> & DICTIONARY_FAST,
+void read_subjects_few(string verb, Dictionary & DICTIONARY_FAST,
     vector< vector<int> > & VERB_SUBJECTS,
-    vector< vector<float> > & WORD_VECTORS,
+    SparseVectors & WORD_VECTORS,
     int BASIS_SIZE,
     ublas::vector<float> & base_vector,
     ublas::vector<float> & add_vector,
-    ublas::vector<float> & krn_vector) {
+    KronSum & krn_vector) {
  
   int vidx = DICTIONARY_FAST[verb];
-  vector<int> subjects = VERB_SUBJECTS[vidx];
+  vector<int> & subjects = VERB_SUBJECTS[vidx];
 
-  for (int i=0; i < BASIS_SIZE; ++i){
-    base_vector[i] = WORD_VECTORS[vidx][i];
-  } 
+  sparse_row_dense(WORD_VECTORS, vidx, &base_vector(0));
  
   for (int i=0; i < BASIS_SIZE; ++i){
     add_vector[i] = 0.0f;
-    
-    for (int j=0; j < BASIS_SIZE; ++j){
-      krn_vector[(BASIS_SIZE * i) + j] = 0.0f;
-    }
   }
 
-  for (int i : subjects) {
-    ublas::vector<float> sbj_vector (BASIS_SIZE);
-  
-    for (int j =0; j < BASIS_SIZE; ++j) {
-      sbj_vector[j] = WORD_VECTORS[i][j];
-    }
+  krn_sum_init(krn_vector, WORD_VECTORS, BASIS_SIZE);
+
+  // subjects holds (subject, count) pairs
+  for (int s = 0; s < subjects.size(); s+=2) {
+    int i = subjects[s];
+    float count = static_cast<float>(subjects[s+1]);
+
+    sparse_axpy(WORD_VECTORS, i, count, &add_vector[0]);
 
-    add_vector = add_vector + sbj_vector;
-    ublas::vector<float> tk  = krn_mul(sbj_vector, sbj_vector);
-    krn_vector = krn_vector + tk;   
+    krn_sum_add(krn_vector, i, i, count);
   }
 }
 
@@ -245,8 +229,10 @@ void read_subjects_few(string verb, map<string,int> & DICTIONARY_FAST,
  * @param VERB_INTRANSITIVE the list of intransitive verbs
  * @param BASIS_SIZE the size of our word vectors
  * @param DICTIONARY_FAST the fast dictionary 
- * @param VERB_SUBJECTS the vector of vectors of verb subjects
+ * @param VERB_SUBJECTS the vector of vectors of (subject, count) pairs
  * @param WORD_VECTORS our word count vectors
+ * @param CACHE_MB how much memory the verb tensor cache may use
+ * @param SKETCH whether to add approximate Kronecker columns, or use only those
  */
 
 void intrans_count( std::string results_file,
@@ -254,102 +240,111 @@ void intrans_count( std::string results_file,
   set<string> & VERB_TRANSITIVE,
   set<string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  map<string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   vector< vector<int> > & VERB_SUBJECTS,
-  vector< vector<float> > & WORD_VECTORS) {
+  SparseVectors & WORD_VECTORS,
+  size_t CACHE_MB,
+  const SketchOptions & SKETCH) {
   
  // Open the file to write results
-  std::ofstream out_file (results_file);
-  if (!out_file.is_open()) {
+  TextFile out_file;
+  if (!out_file.open(results_file)) {
     cout << "Unable to open " << results_file << " for writing" << endl;
     return;
   }
 
-  out_file << "verb0,verb1,base_sim,add_sim,min_sim,max_sim,add_add_sim,add_mul_sim,min_add_sim,min_mul_sim,max_add_sim,max_mul_sim,krn_sim,krn_add_sim,krn_mul_sim,human_sim" << endl;
+  out_file << "verb0,verb1,base_sim,add_sim,min_sim,max_sim,add_add_sim,add_mul_sim,min_add_sim,min_mul_sim,max_add_sim,max_mul_sim"
+    << sketch_columns({"krn_sim", "krn_add_sim", "krn_mul_sim"}, SKETCH) << ",human_sim\n";
+
+  TensorCache cache (CACHE_MB);
+
+  bool sketching = SKETCH.epsilon > 0;
+  bool exact = !(sketching && SKETCH.only);
+  TensorSketch sketch;
+  if (sketching) { tensor_sketch_init(sketch, BASIS_SIZE, SKETCH); }
+
+  // Each verb is composed once, however many pairs it turns up in
+  auto compose = [&](const string & verb, Workspace & work) {
+    return cache.get(DICTIONARY_FAST[verb], MODEL_SBJ, [&](VerbTensor< ublas::vector<float> > & t) {
+      t.base.resize(BASIS_SIZE);
+      t.sum_subject.resize(BASIS_SIZE);
+      t.min.resize(BASIS_SIZE);
+      t.max.resize(BASIS_SIZE);
+      if (exact) { t.krn.resize(krn_packed_size(BASIS_SIZE)); }
+      read_subjects(verb, DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS, BASIS_SIZE, t.base, t.sum_subject, t.min, t.max, t.krn, t.krn_sum, &work);
+      if (sketching) { verb_tensor_sketch(t, sketch, &t.base(0)); }
+    });
+  };
+
+  StatsStage stage ("intrans_count");
+  stats_total(VERBS_TO_CHECK.size());
+  ResultRows rows (out_file, VERBS_TO_CHECK.size());
+  size_t psize = exact ? krn_packed_size(BASIS_SIZE) : 0;
 
   #pragma omp parallel
   {   
+    StatsBusy busy;
+
+    // The tiles for each verb's subject tensor, taken and handed back as it is composed
+    Workspace work (exact ? krn_packed_workspace_floats(BASIS_SIZE) : 0);
+
+    // Scratch for this thread, reused for every pair. noalias assignments write straight
+    // into these rather than building a temporary.
+    ublas::vector<float> add_base_add_vector0 (BASIS_SIZE);
+    ublas::vector<float> add_base_mul_vector0 (BASIS_SIZE);
+    ublas::vector<float> min_base_add_vector0 (BASIS_SIZE);
+    ublas::vector<float> min_base_mul_vector0 (BASIS_SIZE);
+    ublas::vector<float> max_base_add_vector0 (BASIS_SIZE);
+    ublas::vector<float> max_base_mul_vector0 (BASIS_SIZE);
+    ublas::vector<float> add_base_add_vector1 (BASIS_SIZE);
+    ublas::vector<float> add_base_mul_vector1 (BASIS_SIZE);
+    ublas::vector<float> min_base_add_vector1 (BASIS_SIZE);
+    ublas::vector<float> min_base_mul_vector1 (BASIS_SIZE);
+    ublas::vector<float> max_base_add_vector1 (BASIS_SIZE);
+    ublas::vector<float> max_base_mul_vector1 (BASIS_SIZE);
+    ublas::vector<float> krn_base_add_vector0 (psize);
+    ublas::vector<float> krn_base_mul_vector0 (psize);
+    ublas::vector<float> krn_base_add_vector1 (psize);
+    ublas::vector<float> krn_base_mul_vector1 (psize);
+    ublas::vector<float> td (psize);
     
-    #pragma omp parallel for
+    #pragma omp for nowait
     for (int i=0; i < VERBS_TO_CHECK.size(); ++i){
 
       VerbPair vp = VERBS_TO_CHECK[i];
+      stats_step();
 
       if(VERB_INTRANSITIVE.find(vp.v0) != VERB_INTRANSITIVE.end() &&
           VERB_INTRANSITIVE.find(vp.v1) != VERB_INTRANSITIVE.end()){
 
-        ublas::vector<float> base_vector0 (BASIS_SIZE);
-        ublas::vector<float> add_vector0 (BASIS_SIZE);
-        ublas::vector<float> min_vector0 (BASIS_SIZE);
-        ublas::vector<float> max_vector0 (BASIS_SIZE);
-        ublas::vector<float> add_base_add_vector0 (BASIS_SIZE);
-        ublas::vector<float> add_base_mul_vector0 (BASIS_SIZE);
-        ublas::vector<float> min_base_add_vector0 (BASIS_SIZE);
-        ublas::vector<float> min_base_mul_vector0 (BASIS_SIZE);
-        ublas::vector<float> max_base_add_vector0 (BASIS_SIZE);
-        ublas::vector<float> max_base_mul_vector0 (BASIS_SIZE);
-        ublas::vector<float> krn_vector0 (BASIS_SIZE * BASIS_SIZE);
-        ublas::vector<float> krn_base_add_vector0 (BASIS_SIZE * BASIS_SIZE);
-        ublas::vector<float> krn_base_mul_vector0 (BASIS_SIZE * BASIS_SIZE);
-    
-        ublas::vector<float> base_vector1 (BASIS_SIZE);
-        ublas::vector<float> add_vector1 (BASIS_SIZE);
-        ublas::vector<float> min_vector1 (BASIS_SIZE);
-        ublas::vector<float> max_vector1 (BASIS_SIZE);
-        ublas::vector<float> add_base_add_vector1 (BASIS_SIZE);
-        ublas::vector<float> add_base_mul_vector1 (BASIS_SIZE);
-        ublas::vector<float> min_base_add_vector1 (BASIS_SIZE);
-        ublas::vector<float> min_base_mul_vector1 (BASIS_SIZE);
-        ublas::vector<float> max_base_add_vector1 (BASIS_SIZE);
-        ublas::vector<float> max_base_mul_vector1 (BASIS_SIZE);
-        ublas::vector<float> krn_vector1 (BASIS_SIZE * BASIS_SIZE);
-        ublas::vector<float> krn_base_add_vector1 (BASIS_SIZE * BASIS_SIZE);
-        ublas::vector<float> krn_base_mul_vector1 (BASIS_SIZE * BASIS_SIZE);
-
-        read_subjects(vp.v0,
-            DICTIONARY_FAST,
-            VERB_SUBJECTS,
-            WORD_VECTORS,
-            BASIS_SIZE,
-            base_vector0,
-            add_vector0,
-            min_vector0,
-            max_vector0,
-            krn_vector0);
-
-        read_subjects(vp.v1,
-            DICTIONARY_FAST,
-            VERB_SUBJECTS,
-            WORD_VECTORS,
-            BASIS_SIZE, 
-            base_vector1,
-            add_vector1,
-            min_vector1,
-            max_vector1,
-            krn_vector1);
+        TensorCache::Entry t0 = compose(vp.v0, work);
+        TensorCache::Entry t1 = compose(vp.v1, work);
 
+        ublas::vector<float> & base_vector0 = t0->base;
+        ublas::vector<float> & add_vector0 = t0->sum_subject;
+        ublas::vector<float> & min_vector0 = t0->min;
+        ublas::vector<float> & max_vector0 = t0->max;
+    
+        ublas::vector<float> & base_vector1 = t1->base;
+        ublas::vector<float> & add_vector1 = t1->sum_subject;
+        ublas::vector<float> & min_vector1 = t1->min;
+        ublas::vector<float> & max_vector1 = t1->max;
 
         // Now we can perform the last step in our equation
   
-        add_base_add_vector0 = add_vector0 + base_vector0;
-        add_base_mul_vector0 = mul_vec(add_vector0,base_vector0);
-        min_base_add_vector0 = min_vector0 + base_vector0;
-        min_base_mul_vector0 = mul_vec(min_vector0, base_vector0);
-        max_base_add_vector0 = max_vector0 + base_vector0;
-        max_base_mul_vector0 = mul_vec(max_vector0, base_vector0);
-        ublas::vector<float> td = krn_mul(base_vector0, base_vector0);
-        krn_base_add_vector0 = krn_vector0 + td;
-        krn_base_mul_vector0 = mul_vec(krn_vector0,td);
- 
-        add_base_add_vector1 = add_vector1 + base_vector1;
-        add_base_mul_vector1 = mul_vec(add_vector1,base_vector1);
-        min_base_add_vector1 = min_vector1 + base_vector1;
-        min_base_mul_vector1 = mul_vec(min_vector1, base_vector1);
-        max_base_add_vector1 = max_vector1 + base_vector1;
-        max_base_mul_vector1 = mul_vec(max_vector1, base_vector1);
-        td = krn_mul(base_vector1, base_vector1);
-        krn_base_add_vector1 = krn_vector1 + td;
-        krn_base_mul_vector1 = mul_vec(krn_vector1,td);
+        noalias(add_base_add_vector0) = add_vector0 + base_vector0;
+        noalias(add_base_mul_vector0) = element_prod(add_vector0, base_vector0);
+        noalias(min_base_add_vector0) = min_vector0 + base_vector0;
+        noalias(min_base_mul_vector0) = element_prod(min_vector0, base_vector0);
+        noalias(max_base_add_vector0) = max_vector0 + base_vector0;
+        noalias(max_base_mul_vector0) = element_prod(max_vector0, base_vector0);
+
+        noalias(add_base_add_vector1) = add_vector1 + base_vector1;
+        noalias(add_base_mul_vector1) = element_prod(add_vector1, base_vector1);
+        noalias(min_base_add_vector1) = min_vector1 + base_vector1;
+        noalias(min_base_mul_vector1) = element_prod(min_vector1, base_vector1);
+        noalias(max_base_add_vector1) = max_vector1 + base_vector1;
+        noalias(max_base_mul_vector1) = element_prod(max_vector1, base_vector1);
 
         float c0 = cosine_sim(base_vector0, base_vector1);
         float c1 = cosine_sim(add_vector0, add_vector1);
@@ -361,36 +356,53 @@ void intrans_count( std::string results_file,
         float c7 = cosine_sim(min_base_mul_vector0, min_base_mul_vector1);
         float c8 = cosine_sim(max_base_add_vector0, max_base_add_vector1);
         float c9 = cosine_sim(max_base_mul_vector0, max_base_mul_vector1);
-        float c10 = cosine_sim(krn_vector0, krn_vector1);
-        float c11 = cosine_sim(krn_base_add_vector0, krn_base_add_vector1);
-        float c12 = cosine_sim(krn_base_mul_vector0, krn_base_mul_vector1);
-
-
-        std::stringstream stream;       
-        stream << vp.v0 << "," << vp.v1 << "," << s9::ToString(c0)
-          << "," << s9::ToString(c1)
-          << "," << s9::ToString(c2)
-          << "," << s9::ToString(c3)
-          << "," << s9::ToString(c4)
-          << "," << s9::ToString(c5)
-          << "," << s9::ToString(c6)
-          << "," << s9::ToString(c7)
-          << "," << s9::ToString(c8)
-          << "," << s9::ToString(c9)
-          << "," << s9::ToString(c10)
-          << "," << s9::ToString(c11)
-          << "," << s9::ToString(c12)
-          << "," << s9::ToString(vp.s)
-          << endl;
-  
-        #pragma omp critical
-        {
-          out_file << stream.str();
-          out_file.flush();
+
+        TextBuffer row;
+        row << vp.v0 << ',' << vp.v1 << ',' << c0
+          << ',' << c1
+          << ',' << c2
+          << ',' << c3
+          << ',' << c4
+          << ',' << c5
+          << ',' << c6
+          << ',' << c7
+          << ',' << c8
+          << ',' << c9;
+
+        if (exact) {
+          // The subject tensors are symmetric so everything Kronecker is kept as an upper triangle
+          ublas::vector<float> & krn_vector0 = t0->krn;
+          ublas::vector<float> & krn_vector1 = t1->krn;
+          krn_packed_self(&base_vector0(0), BASIS_SIZE, &td(0));
+          noalias(krn_base_add_vector0) = krn_vector0 + td;
+          noalias(krn_base_mul_vector0) = element_prod(krn_vector0, td);
+
+          krn_packed_self(&base_vector1(0), BASIS_SIZE, &td(0));
+          noalias(krn_base_add_vector1) = krn_vector1 + td;
+          noalias(krn_base_mul_vector1) = element_prod(krn_vector1, td);
+
+          float c10 = krn_packed_cosine_sim(&krn_vector0(0), &krn_vector1(0), BASIS_SIZE);
+          float c11 = krn_packed_cosine_sim(&krn_base_add_vector0(0), &krn_base_add_vector1(0), BASIS_SIZE);
+          float c12 = krn_packed_cosine_sim(&krn_base_mul_vector0(0), &krn_base_mul_vector1(0), BASIS_SIZE);
+          row << ',' << c10 << ',' << c11 << ',' << c12;
+        }
+
+        if (sketching) {
+          row << ',' << tensor_sketch_cosine_sim(t0->sketch_sum, t1->sketch_sum)
+            << ',' << tensor_sketch_cosine_sim(t0->sketch_add, t1->sketch_add)
+            << ',' << tensor_sketch_cosine_sim(t0->sketch_mul, t1->sketch_mul);
         }
+
+        row << ',' << vp.s << '\n';
+  
+        rows.set(i, row);
+      } else {
+        rows.skip(i);
       }
     }
   }
+  cout << "Verb cache hits: " << cache.hits() << " misses: " << cache.misses() << endl;
+  rows.finish();
   out_file.close();
 }
 
@@ -404,6 +416,8 @@ void intrans_count( std::string results_file,
  * @param DICTIONARY_FAST the fast dictionary 
  * @param VERB_SBJ_OBJ the vector of vectors of verb subject-object pairs
  * @param WORD_VECTORS our word count vectors
+ * @param CACHE_MB how much memory the verb tensor cache may use
+ * @param SKETCH whether to add approximate Kronecker columns, or use only those
  */
 
 void trans_count(std::string results_file,
@@ -411,9 +425,11 @@ void trans_count(std::string results_file,
   set<string> & VERB_TRANSITIVE,
   set<string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  map<string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   vector< vector<int> > & VERB_SBJ_OBJ,
-  vector< vector<float> > & WORD_VECTORS) {
+  SparseVectors & WORD_VECTORS,
+  size_t CACHE_MB,
+  const SketchOptions & SKETCH) {
 
   int total_verbs = 0;
   // Print out the total number we should expect
@@ -428,107 +444,117 @@ void trans_count(std::string results_file,
   }
 
   // Open the file to write results
-  std::ofstream out_file (results_file);
-  if (!out_file.is_open()) {
+  TextFile out_file;
+  if (!out_file.open(results_file)) {
     cout << "Unable to open " << results_file << " for writing" << endl;
     return;
   }
-  out_file << "verb0,verb1,base_sim,sbj_obj_sim,sbj_obj_add,sbj_obj_mul,sum_sbj_obj,sum_sbj_obj_mul,sum_sbj_obj_add,human_sim" << endl;
+  out_file << "verb0,verb1,base_sim" << sketch_columns({"sbj_obj_sim", "sbj_obj_add", "sbj_obj_mul"}, SKETCH)
+    << ",sum_sbj_obj,sum_sbj_obj_mul,sum_sbj_obj_add,human_sim\n";
+
+  TensorCache cache (CACHE_MB);
+
+  bool sketching = SKETCH.epsilon > 0;
+  bool exact = !(sketching && SKETCH.only);
+  TensorSketch sketch;
+  if (sketching) { tensor_sketch_init(sketch, BASIS_SIZE, SKETCH); }
+
+  // Each verb is composed once, however many pairs it turns up in
+  auto compose = [&](const string & verb) {
+    return cache.get(DICTIONARY_FAST[verb], MODEL_SBJ_OBJ, [&](VerbTensor< ublas::vector<float> > & t) {
+      t.base.resize(BASIS_SIZE);
+      t.sum_subject.resize(BASIS_SIZE);
+      t.sum_object.resize(BASIS_SIZE);
+      read_subjects_objects(verb, DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, t.base, t.sum_subject, t.sum_object, t.krn_sum);
+      if (exact) { verb_tensor_finish(t, &t.base(0)); }
+      if (sketching) { verb_tensor_sketch(t, sketch, &t.base(0)); }
+    });
+  };
+
+  StatsStage stage ("trans_count");
+  stats_total(VERBS_TO_CHECK.size());
+  ResultRows rows (out_file, VERBS_TO_CHECK.size());
 
   #pragma omp parallel
   {   
-    ublas::vector<float> base_vector0 (BASIS_SIZE);
-    ublas::vector<float> sum_subject0 (BASIS_SIZE);
-    ublas::vector<float> sum_object0 (BASIS_SIZE);
-    ublas::vector<float> sum_krn0 (BASIS_SIZE * BASIS_SIZE);
+    StatsBusy busy;
 
-    ublas::vector<float> base_vector1 (BASIS_SIZE);
-    ublas::vector<float> sum_subject1 (BASIS_SIZE);
-    ublas::vector<float> sum_object1 (BASIS_SIZE);
-    ublas::vector<float> sum_krn1 (BASIS_SIZE * BASIS_SIZE);
+    // Scratch for this thread, reused for every pair
+    ublas::vector<float> tm0 (BASIS_SIZE);
+    ublas::vector<float> tm1 (BASIS_SIZE);
+    Workspace work (krn_workspace_floats(BASIS_SIZE));
 
-    ublas::vector<float> krn_base0 (BASIS_SIZE * BASIS_SIZE);
-    ublas::vector<float> krn_base1 (BASIS_SIZE * BASIS_SIZE);
-
-    #pragma omp parallel for
+    #pragma omp for nowait
     for (int i=0; i < VERBS_TO_CHECK.size(); ++i){
 
       VerbPair vp = VERBS_TO_CHECK[i];
+      stats_step();
+
+      // A pair that went dense may have run over the workspace; this grows it to fit
+      work.reset();
 
       if(VERB_TRANSITIVE.find(vp.v0) != VERB_TRANSITIVE.end() &&
           VERB_TRANSITIVE.find(vp.v1) != VERB_TRANSITIVE.end()){
 
-        // Set the vectors to zeros
-        sum_subject0.clear();  
-        sum_subject1.clear();        
-        sum_object0.clear();
-        sum_object1.clear();
-        sum_krn0.clear();
-        sum_krn1.clear();
+        TensorCache::Entry t0 = compose(vp.v0);
+        TensorCache::Entry t1 = compose(vp.v1);
 
-        read_subjects_objects(vp.v0,DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, base_vector0, sum_subject0, sum_object0, sum_krn0);
-
-        read_subjects_objects(vp.v1,DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, base_vector1, sum_subject1, sum_object1, sum_krn1);
+        ublas::vector<float> & base_vector0 = t0->base;
+        ublas::vector<float> & sum_subject0 = t0->sum_subject;
+        ublas::vector<float> & sum_object0 = t0->sum_object;
+        ublas::vector<float> & base_vector1 = t1->base;
+        ublas::vector<float> & sum_subject1 = t1->sum_subject;
+        ublas::vector<float> & sum_object1 = t1->sum_object;
       
-        krn_base0 = krn_mul(base_vector0, base_vector0);
-        krn_base1 = krn_mul(base_vector1, base_vector1);
-        
         float c0 = cosine_sim(base_vector0, base_vector1);
-        float c1 = cosine_sim(sum_krn0, sum_krn1);
-
-        ublas::vector<float> tk0 (BASIS_SIZE * BASIS_SIZE);
-        tk0 = sum_krn0 + krn_base0;
-
-        ublas::vector<float> tk1 (BASIS_SIZE * BASIS_SIZE);
-        tk1 = sum_krn1 + krn_base1;
-        float c2 = cosine_sim(tk0, tk1);
-
-        tk0 = mul_vec(sum_krn0, krn_base0);
-        tk1 = mul_vec(sum_krn1,krn_base1);
-        float c3 = cosine_sim(tk0, tk1);
 
-        ublas::vector<float> tm0 (BASIS_SIZE);
-        ublas::vector<float> tm1 (BASIS_SIZE);
-
-        tm0 = sum_subject0 + sum_object0;
-        tm1 = sum_subject1 + sum_object1; 
+        noalias(tm0) = sum_subject0 + sum_object0;
+        noalias(tm1) = sum_subject1 + sum_object1; 
 
         float c4 = cosine_sim(tm0, tm1);
 
-        tm0 = sum_subject0 + sum_object0;
-        tm0 = mul_vec(tm0, base_vector0);
-        tm1 = sum_subject1 + sum_object1;
-        tm1 = mul_vec(tm1, base_vector1);
+        noalias(tm0) = element_prod(sum_subject0 + sum_object0, base_vector0);
+        noalias(tm1) = element_prod(sum_subject1 + sum_object1, base_vector1);
 
         float c5 = cosine_sim(tm0, tm1);
         
-        tm0 = sum_subject0 + sum_object0 + base_vector0;
-        tm1 = sum_subject1 + sum_object1 + base_vector1;
+        noalias(tm0) = sum_subject0 + sum_object0 + base_vector0;
+        noalias(tm1) = sum_subject1 + sum_object1 + base_vector1;
         
         float c6 = cosine_sim(tm0, tm1);
       
-        std::stringstream stream;
-
-        stream << vp.v0 << "," << vp.v1 << "," << s9::ToString(c0)
-          << "," << s9::ToString(c1)
-          << "," << s9::ToString(c2)
-          << "," << s9::ToString(c3)
-          << "," << s9::ToString(c4)
-          << "," << s9::ToString(c5)
-          << "," << s9::ToString(c6)
-          << "," << s9::ToString(vp.s)
-          << endl;
-
-        #pragma omp critical
-        {
-          out_file << stream.str();
-          out_file.flush();
+        TextBuffer row;
+
+        row << vp.v0 << ',' << vp.v1 << ',' << c0;
+
+        if (exact) {
+          float c1 = krn_cosine_sim(t0->krn_sum, t1->krn_sum, t0->krn_sum_norm, t1->krn_sum_norm, &work);
+          float c2 = krn_cosine_sim(t0->krn_add, t1->krn_add, t0->krn_add_norm, t1->krn_add_norm, &work);
+          float c3 = krn_cosine_sim(t0->krn_mul, t1->krn_mul, t0->krn_mul_norm, t1->krn_mul_norm, &work);
+          row << ',' << c1 << ',' << c2 << ',' << c3;
         }
 
+        if (sketching) {
+          row << ',' << tensor_sketch_cosine_sim(t0->sketch_sum, t1->sketch_sum)
+            << ',' << tensor_sketch_cosine_sim(t0->sketch_add, t1->sketch_add)
+            << ',' << tensor_sketch_cosine_sim(t0->sketch_mul, t1->sketch_mul);
+        }
+
+        row << ',' << c4
+          << ',' << c5
+          << ',' << c6
+          << ',' << vp.s
+          << '\n';
+
+        rows.set(i, row);
+      } else {
+        rows.skip(i);
       }
     }
   }
 
+  cout << "Verb cache hits: " << cache.hits() << " misses: " << cache.misses() << endl;
+  rows.finish();
   out_file.close();
 }
 
@@ -542,6 +568,8 @@ void trans_count(std::string results_file,
  * @param VERB_SBJ_OBJ the vector of vectors of verb subject-object pairs
  * @param VERB_SUBJECTS the vector of verb subjects
  * @param WORD_VECTORS our word count vectors
+ * @param CACHE_MB how much memory the verb tensor cache may use
+ * @param SKETCH whether to add approximate Kronecker columns, or use only those
  */
 
 void all_count(std::string results_file,
@@ -549,10 +577,12 @@ void all_count(std::string results_file,
   set<string> & VERB_TRANSITIVE,
   set<string> & VERB_INTRANSITIVE,
   int BASIS_SIZE,
-  map<string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   vector< vector<int> > & VERB_SBJ_OBJ,
   vector< vector<int> > & VERB_SUBJECTS,
-  vector< vector<float> > & WORD_VECTORS) {
+  SparseVectors & WORD_VECTORS,
+  size_t CACHE_MB,
+  const SketchOptions & SKETCH) {
 
   int total_verbs = 0;
   // Print out the total number we should expect
@@ -569,116 +599,106 @@ void all_count(std::string results_file,
   }
 
   // Open the file to write results
-  std::ofstream out_file (results_file);
-  if (!out_file.is_open()) {
+  TextFile out_file;
+  if (!out_file.open(results_file)) {
     cout << "Unable to open " << results_file << " for writing" << endl;
     return;
   }
  
-  out_file << "verb0,verb1,base_sim,cs1,cs2,cs3,cs4,cs5,cs6,human_sim" << endl;
+  out_file << "verb0,verb1,base_sim,cs1,cs2,cs3" << sketch_columns({"cs4", "cs5", "cs6"}, SKETCH) << ",human_sim\n";
+
+  TensorCache cache (CACHE_MB);
+
+  bool sketching = SKETCH.epsilon > 0;
+  bool exact = !(sketching && SKETCH.only);
+  TensorSketch sketch;
+  if (sketching) { tensor_sketch_init(sketch, BASIS_SIZE, SKETCH); }
+
+  // Each verb is composed once, however many pairs it turns up in. Transitive verbs use
+  // their subjects and objects, the rest just their subjects.
+  auto compose = [&](const string & verb) {
+    bool trans = VERB_TRANSITIVE.find(verb) != VERB_TRANSITIVE.end();
+    return cache.get(DICTIONARY_FAST[verb], trans ? MODEL_SBJ_OBJ_FEW : MODEL_SBJ_FEW, [&](VerbTensor< ublas::vector<float> > & t) {
+      t.base.resize(BASIS_SIZE);
+      t.sum_subject.resize(BASIS_SIZE);
+      if (trans) {
+        read_subjects_objects_few(verb, DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, t.base, t.sum_subject, t.krn_sum);
+      } else {
+        read_subjects_few(verb, DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS, BASIS_SIZE, t.base, t.sum_subject, t.krn_sum);
+      }
+      if (exact) { verb_tensor_finish(t, &t.base(0)); }
+      if (sketching) { verb_tensor_sketch(t, sketch, &t.base(0)); }
+    });
+  };
+
+  StatsStage stage ("all_count");
+  stats_total(VERBS_TO_CHECK.size());
+  ResultRows rows (out_file, VERBS_TO_CHECK.size());
 
   #pragma omp parallel
   {   
-    ublas::vector<float> base_vector0 (BASIS_SIZE);
-    ublas::vector<float> sum_subject0 (BASIS_SIZE);
-    ublas::vector<float> sum_krn0 (BASIS_SIZE * BASIS_SIZE);
-
-    ublas::vector<float> base_vector1 (BASIS_SIZE);
-    ublas::vector<float> sum_subject1 (BASIS_SIZE);
-    ublas::vector<float> sum_krn1 (BASIS_SIZE * BASIS_SIZE);
+    StatsBusy busy;
 
-    ublas::vector<float> krn_base0 (BASIS_SIZE * BASIS_SIZE);
-    ublas::vector<float> krn_base1 (BASIS_SIZE * BASIS_SIZE);
+    // Scratch for this thread, reused for every pair
+    ublas::vector<float> tv0 (BASIS_SIZE);
+    ublas::vector<float> tv1 (BASIS_SIZE);
+    Workspace work (krn_workspace_floats(BASIS_SIZE));
 
-    #pragma omp parallel for
+    #pragma omp for nowait
     for (int i=0; i < VERBS_TO_CHECK.size(); ++i){
 
       VerbPair vp = VERBS_TO_CHECK[i];
+      stats_step();
 
-      // Set the vectors to zeros
-      sum_subject0.clear();  
-      sum_subject1.clear();        
-      sum_krn0.clear();
-      sum_krn1.clear();
-
-      if(VERB_TRANSITIVE.find(vp.v0) != VERB_TRANSITIVE.end() &&
-          VERB_TRANSITIVE.find(vp.v1) != VERB_TRANSITIVE.end()){
-
-        read_subjects_objects_few(vp.v0,DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, base_vector0, sum_subject0, sum_krn0);
-
-        read_subjects_objects_few(vp.v1,DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, base_vector1, sum_subject1, sum_krn1);
+      // A pair that went dense may have run over the workspace; this grows it to fit
+      work.reset();
 
-      } else if(VERB_TRANSITIVE.find(vp.v0) == VERB_TRANSITIVE.end() &&
-          VERB_TRANSITIVE.find(vp.v1) != VERB_TRANSITIVE.end()){
-  
-        read_subjects_few(vp.v0,DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS, BASIS_SIZE, base_vector0, sum_subject0, sum_krn0);
+      TensorCache::Entry t0 = compose(vp.v0);
+      TensorCache::Entry t1 = compose(vp.v1);
 
-        read_subjects_objects_few(vp.v1,DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, base_vector1, sum_subject1, sum_krn1);
+      ublas::vector<float> & base_vector0 = t0->base;
+      ublas::vector<float> & sum_subject0 = t0->sum_subject;
+      ublas::vector<float> & base_vector1 = t1->base;
+      ublas::vector<float> & sum_subject1 = t1->sum_subject;
 
-      } else if(VERB_TRANSITIVE.find(vp.v0) != VERB_TRANSITIVE.end() &&
-          VERB_TRANSITIVE.find(vp.v1) == VERB_TRANSITIVE.end()){
+      float c0 = cosine_sim(base_vector0, base_vector1);
+      float c1 = cosine_sim(sum_subject0, sum_subject1);
       
-        read_subjects_objects_few(vp.v0,DICTIONARY_FAST, VERB_SBJ_OBJ, WORD_VECTORS, BASIS_SIZE, base_vector0, sum_subject0, sum_krn0);
+      noalias(tv0) = sum_subject0 + base_vector0;
+      noalias(tv1) = sum_subject1 + base_vector1;
 
-        read_subjects_few(vp.v1,DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS, BASIS_SIZE, base_vector1, sum_subject1, sum_krn1);
+      float c2 = cosine_sim(tv0,tv1);
+      noalias(tv0) = element_prod(sum_subject0, base_vector0);
+      noalias(tv1) = element_prod(sum_subject1, base_vector1);
+      float c3 = cosine_sim(tv0,tv1);
 
-      } else {
-      
-        read_subjects_few(vp.v0,DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS, BASIS_SIZE, base_vector0, sum_subject0, sum_krn0);
+      TextBuffer row;
 
-        read_subjects_few(vp.v1,DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS, BASIS_SIZE, base_vector1, sum_subject1, sum_krn1);
+      row << vp.v0 << ',' << vp.v1 << ',' << c0
+        << ',' << c1
+        << ',' << c2
+        << ',' << c3;
 
+      if (exact) {
+        float c4 = krn_cosine_sim(t0->krn_sum, t1->krn_sum, t0->krn_sum_norm, t1->krn_sum_norm, &work);
+        float c5 = krn_cosine_sim(t0->krn_add, t1->krn_add, t0->krn_add_norm, t1->krn_add_norm, &work);
+        float c6 = krn_cosine_sim(t0->krn_mul, t1->krn_mul, t0->krn_mul_norm, t1->krn_mul_norm, &work);
+        row << ',' << c4 << ',' << c5 << ',' << c6;
       }
 
-      krn_base0 = krn_mul(base_vector0, base_vector0);
-      krn_base1 = krn_mul(base_vector1, base_vector1);
-      
-      float c0 = cosine_sim(base_vector0, base_vector1);
-      float c1 = cosine_sim(sum_subject0, sum_subject1);
-      
-      ublas::vector<float> tv0 (BASIS_SIZE);
-      ublas::vector<float> tv1 (BASIS_SIZE);
+      if (sketching) {
+        row << ',' << tensor_sketch_cosine_sim(t0->sketch_sum, t1->sketch_sum)
+          << ',' << tensor_sketch_cosine_sim(t0->sketch_add, t1->sketch_add)
+          << ',' << tensor_sketch_cosine_sim(t0->sketch_mul, t1->sketch_mul);
+      }
 
-      tv0 = sum_subject0 + base_vector0;
-      tv1 = sum_subject1 + base_vector1;
+      row << ',' << vp.s << '\n';
 
-      float c2 = cosine_sim(tv0,tv1);
-      tv0 = mul_vec(sum_subject0,base_vector0);
-      tv1 = mul_vec(sum_subject1,base_vector1);
-      float c3 = cosine_sim(tv0,tv1);
-      float c4 = cosine_sim(sum_krn0, sum_krn1);
-  
-
-      ublas::vector<float> tk0 (BASIS_SIZE * BASIS_SIZE);
-      tk0 = sum_krn0 + krn_base0;
-
-      ublas::vector<float> tk1 (BASIS_SIZE * BASIS_SIZE);
-      tk1 = sum_krn1 + krn_base1;
-      float c5 = cosine_sim(tk0, tk1);
-
-      tk0 = mul_vec(sum_krn0, krn_base0);
-      tk1 = mul_vec(sum_krn1,krn_base1);
-      float c6 = cosine_sim(tk0, tk1);
-
-      std::stringstream stream;
-
-      stream << vp.v0 << "," << vp.v1 << "," << s9::ToString(c0)
-        << "," << s9::ToString(c1)
-        << "," << s9::ToString(c2)
-        << "," << s9::ToString(c3)
-        << "," << s9::ToString(c4)
-        << "," << s9::ToString(c5)
-        << "," << s9::ToString(c6)
-        << "," << s9::ToString(vp.s)
-        << endl;
-
-      #pragma omp critical
-      {
-        out_file << stream.str();
-        out_file.flush();
-      }
+      rows.set(i, row);
     }
   }
+  cout << "Verb cache hits: " << cache.hits() << " misses: " << cache.misses() << endl;
+  rows.finish();
   out_file.close();
 }
 
@@ -697,9 +717,9 @@ void all_count(std::string results_file,
 void variance_count( std::string results_file,
   std::vector<VerbPair> & VERBS_TO_CHECK,
   int BASIS_SIZE,
-  map<string,int> & DICTIONARY_FAST,
+  Dictionary & DICTIONARY_FAST,
   vector< vector<int> > & VERB_SBJ_OBJ,
-  vector< vector<float> > & WORD_VECTORS) {
+  SparseVectors & WORD_VECTORS) {
 
   // Get all the unique verbs in the set to check
   set<string> verbs_to_check_set;
@@ -713,101 +733,87 @@ void variance_count( std::string results_file,
   std::copy(verbs_to_check_set.begin(), verbs_to_check_set.end(), std::back_inserter(verbs_to_check));
 
   // Open the file to write results
-  std::ofstream out_file (results_file);
-  if (!out_file.is_open()) {
+  TextFile out_file;
+  if (!out_file.open(results_file)) {
     cout << "Unable to open " << results_file << " for writing" << endl;
     return;
   }
   
-  out_file << "verb,variance" << endl;
+  out_file << "verb,variance\n";
   
+  StatsStage stage ("variance_count");
+  stats_total(verbs_to_check.size());
+  ResultRows rows (out_file, verbs_to_check.size());
+
   // TODO - Better to use a for loop so that fast threads can do work and not sit still
   #pragma omp parallel
   {   
-    std::string status;
+    StatsBusy busy;
 
-    #pragma omp for
+    #pragma omp for nowait
     for (int i=0; i < verbs_to_check.size(); ++i){
     
       string verb = verbs_to_check[i];
+      stats_step();
 
-      /*status = "Verb: " + verb + "                                 " + s9::ToString(i) + "of" + s9::ToString(VERBS_TO_CHECK.size()) + "  ";
-  
-      int thread_num = omp_get_thread_num();
-      printf("\033[%d;0H%d-%s",thread_num+1, thread_num, status.c_str()); 
-      fflush(stdout);
-    */
       int vidx = DICTIONARY_FAST[verb];
-      vector<int> subobs = VERB_SBJ_OBJ[vidx];
-      vector<float> distances;
-
-      for (int j=0; j < subobs.size()-1; ++j){
-          
-        int sidx = subobs[j];
-        ublas::vector<float> wvj (BASIS_SIZE);
-          
-        for (int k = 0; k < BASIS_SIZE; k++){
-          wvj(k) = WORD_VECTORS[sidx][k];
-        }
-
-        for (int k=j+1; k < subobs.size(); ++k){
-
-          int tidx = subobs[k];
-          ublas::vector<float> wvk(BASIS_SIZE);
-        
-          for (int m = 0; m < BASIS_SIZE; m++){
-            wvk(m) = WORD_VECTORS[sidx][m];
-          }
-    
-      
-          // Now compute the distance
-
-          float dd = 0;
-          for (int m = 0; m < BASIS_SIZE; ++m){
-            float tf = static_cast<float>(wvj[m] - wvk[m]);
-            dd += (tf*tf);
-          }
-
-          float distance = sqrt(dd);
-          
-          distances.push_back(distance);
-
-          //float distance = cosine_sim(wvj,wvk);
-
-          //if (distance < 2.0) { distances.push_back(distance); }
+      vector<int> & subobs = VERB_SBJ_OBJ[vidx];
+
+      // Subjects and objects each count once per occurrence, so a triple gives two weighted words
+      vector<int> words;
+      vector<double> counts;
+      for (int j=0; j < subobs.size(); j+=3){
+        words.push_back(subobs[j]);
+        words.push_back(subobs[j+1]);
+        counts.push_back(subobs[j+2]);
+        counts.push_back(subobs[j+2]);
+      }
 
+      // Distinct entries j,k stand for c_j * c_k pairs. Repeats of one entry are c(c-1)/2 pairs at 0
+      vector<float> distances;
+      vector<double> weights;
+      double total = 0;
+
+      for (int j=0; j < words.size(); ++j){
+        distances.push_back(0.0f);
+        weights.push_back(counts[j] * (counts[j] - 1.0) * 0.5);
+
+        for (int k=j+1; k < words.size(); ++k){
+          // Now compute the distance, over only the columns either word has
+          float dd = sparse_dist2(WORD_VECTORS, words[j], WORD_VECTORS, words[k]);
+          distances.push_back(sqrt(dd));
+          weights.push_back(counts[j] * counts[k]);
         }
       }
 
+      double variance = 0;
+      double mean = 0;
 
-      float variance = 0;
-      float mean = 0;
-
-      for (float tf : distances){
-        mean += tf;
+      for (int j=0; j < distances.size(); ++j){
+        mean += weights[j] * distances[j];
+        total += weights[j];
       }
 
-      mean = mean / static_cast<float>(distances.size());
+      if (total > 0) {
+        mean = mean / total;
+
+        for (int j=0; j < distances.size(); ++j){
+          double tt = distances[j] - mean;
+          variance += weights[j] * (tt * tt);
+        }
 
-      for (float tf : distances){
-        float tt = tf - mean;
-        variance += (tt * tt); 
+        variance *= 1.0 / total;
       }
-      
-      variance *= 1.0/static_cast<float>(distances.size());
 
-      std::stringstream stream;
+      TextBuffer row;
     
-      stream << verb << "," << s9::ToString(variance) << endl;
+      row << verb << ',' << static_cast<float>(variance) << '\n';
 
-      #pragma omp critical
-      {
-        out_file << stream.str();
-        out_file.flush();
-      }
+      rows.set(i, row);
     }    
 
   }
 
+  rows.finish();
   out_file.close();
 }
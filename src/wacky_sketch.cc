@@ -0,0 +1,246 @@
+/**
+* @brief Approximate Kronecker similarities through TensorSketch
+* @file wacky_sketch.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_sketch.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+using namespace std;
+
+// The variance of an order two TensorSketch inner product is at most (2 + 3^2) / dim
+// times the squared lengths (Avron, Nguyen and Woodruff)
+#define SKETCH_VARIANCE 11.0
+
+// Never go wider than this, however tight the bound we are asked for
+#define SKETCH_MAX_DIM (1 << 22)
+
+/**
+ * The width of sketch we need. Chebyshev says P(|error| >= epsilon) <= variance / epsilon^2
+ * so we want dim >= SKETCH_VARIANCE / (epsilon^2 * delta), rounded up to a power of two.
+ * The error here is that of one inner product relative to |a| * |b|. The similarities we
+ * report go through acos, which has no such bound near a cosine of 1.
+ * @param epsilon the error we allow, relative to the lengths of the tensors
+ * @param delta the chance of missing it
+ * @return the width
+ */
+
+int tensor_sketch_dim(float epsilon, float delta) {
+  double want = SKETCH_VARIANCE / (static_cast<double>(epsilon) * epsilon * delta);
+  int dim = 2;
+  while (dim < want && dim < SKETCH_MAX_DIM) { dim <<= 1; }
+  return dim;
+}
+
+/**
+ * Set up the hash functions and FFT tables for a TensorSketch
+ * @param ts the TensorSketch
+ * @param basis the length of the word vectors
+ * @param options epsilon, delta and the seed
+ */
+
+void tensor_sketch_init(TensorSketch & ts, int basis, const SketchOptions & options) {
+  ts.basis = basis;
+  ts.dim = tensor_sketch_dim(options.epsilon, options.delta);
+
+  std::mt19937 rng (options.seed);
+  std::uniform_int_distribution<int> bucket (0, ts.dim - 1);
+  std::uniform_int_distribution<int> sign (0, 1);
+
+  ts.bucket0.resize(basis);
+  ts.bucket1.resize(basis);
+  ts.sign0.resize(basis);
+  ts.sign1.resize(basis);
+  for (int i = 0; i < basis; ++i) {
+    ts.bucket0[i] = bucket(rng);
+    ts.bucket1[i] = bucket(rng);
+    ts.sign0[i] = sign(rng) ? 1.0f : -1.0f;
+    ts.sign1[i] = sign(rng) ? 1.0f : -1.0f;
+  }
+
+  ts.twiddle.resize(ts.dim / 2);
+  for (int k = 0; k < ts.dim / 2; ++k) {
+    double a = -2.0 * M_PI * k / ts.dim;
+    ts.twiddle[k] = complex<float>(cos(a), sin(a));
+  }
+
+  int bits = 0;
+  while ((1 << bits) < ts.dim) { bits++; }
+  ts.reverse.resize(ts.dim);
+  for (int i = 0; i < ts.dim; ++i) {
+    int r = 0;
+    for (int b = 0; b < bits; ++b) {
+      if (i & (1 << b)) { r |= 1 << (bits - 1 - b); }
+    }
+    ts.reverse[i] = r;
+  }
+}
+
+/**
+ * Multiply two complex numbers. std::complex checks for infinities, which we don't need.
+ * @param a the first
+ * @param b the second
+ * @return a * b
+ */
+
+static inline complex<float> sketch_mul(complex<float> a, complex<float> b) {
+  return complex<float>((a.real() * b.real()) - (a.imag() * b.imag()), (a.real() * b.imag()) + (a.imag() * b.real()));
+}
+
+/**
+ * An in place radix 2 FFT
+ * @param ts the TensorSketch, which holds the twiddles and the bit reversal
+ * @param z dim complex values
+ */
+
+static void sketch_fft(const TensorSketch & ts, complex<float> * z) {
+  int n = ts.dim;
+  for (int i = 0; i < n; ++i) {
+    int j = ts.reverse[i];
+    if (i < j) { std::swap(z[i], z[j]); }
+  }
+
+  for (int len = 2; len <= n; len <<= 1) {
+    int half = len >> 1;
+    int step = n / len;
+    for (int i = 0; i < n; i += len) {
+      for (int j = 0; j < half; ++j) {
+        complex<float> u = z[i + j];
+        complex<float> v = sketch_mul(z[i + j + half], ts.twiddle[j * step]);
+        z[i + j] = u + v;
+        z[i + j + half] = u - v;
+      }
+    }
+  }
+}
+
+/**
+ * Add the sketch of weight * ((a o scale) (x) (b o scale)) to out. We count sketch a into the
+ * real part and b into the imaginary part, so one FFT Z gives both: A_k = (Z_k + conj(Z_-k)) / 2
+ * and B_k = (Z_k - conj(Z_-k)) / 2i, whose product is (Z_k^2 - conj(Z_-k)^2) / 4i.
+ * @param ts the TensorSketch
+ * @param a pointer to basis floats
+ * @param b pointer to basis floats
+ * @param scale pointer to basis floats, or null
+ * @param weight how much the term counts for
+ * @param z dim complex values of scratch
+ * @param out the sketch we add to
+ */
+
+static void sketch_term(const TensorSketch & ts, const float * a, const float * b, const float * scale,
+    float weight, complex<float> * z, Sketch & out) {
+
+  std::fill(z, z + ts.dim, complex<float>(0, 0));
+
+  // Word vectors are mostly zeros so the count sketches are cheap
+  for (int i = 0; i < ts.basis; ++i) {
+    float x = scale == nullptr ? a[i] : a[i] * scale[i];
+    if (x != 0.0f) { z[ts.bucket0[i]] += complex<float>(ts.sign0[i] * x, 0); }
+    float y = scale == nullptr ? b[i] : b[i] * scale[i];
+    if (y != 0.0f) { z[ts.bucket1[i]] += complex<float>(0, ts.sign1[i] * y); }
+  }
+
+  sketch_fft(ts, z);
+
+  float w = weight * 0.25f;
+  for (int k = 0; k <= ts.dim / 2; ++k) {
+    complex<float> zk = z[k];
+    complex<float> zm = conj(z[(ts.dim - k) & (ts.dim - 1)]);
+    complex<float> d = sketch_mul(zk, zk) - sketch_mul(zm, zm);
+    // Dividing by i turns x + iy into y - ix
+    out[k] += complex<float>(w * d.imag(), -w * d.real());
+  }
+}
+
+/**
+ * Sketch everything in a KronSum
+ * @param ts the TensorSketch
+ * @param k the KronSum
+ * @param out the sketch, which we overwrite
+ */
+
+void tensor_sketch_krn(const TensorSketch & ts, const KronSum & k, Sketch & out) {
+  out.assign((ts.dim / 2) + 1, complex<float>(0, 0));
+  vector< complex<float> > z (ts.dim);
+  vector<float> a (k.basis), b (k.basis);
+  const float * scale = k.scale.empty() ? nullptr : &k.scale[0];
+
+  for (size_t t = 0; t < k.weight.size(); ++t) {
+    krn_row(k, k.left[t], &a[0]);
+    krn_row(k, k.right[t], &b[0]);
+    sketch_term(ts, &a[0], &b[0], scale, k.weight[t], &z[0], out);
+  }
+}
+
+/**
+ * Add one more term to a sketch
+ * @param ts the TensorSketch
+ * @param a pointer to basis floats
+ * @param b pointer to basis floats
+ * @param weight how much the term counts for
+ * @param out the sketch we add to
+ */
+
+void tensor_sketch_add(const TensorSketch & ts, const float * a, const float * b, float weight, Sketch & out) {
+  if (out.empty()) { out.assign((ts.dim / 2) + 1, complex<float>(0, 0)); }
+  vector< complex<float> > z (ts.dim);
+  sketch_term(ts, a, b, nullptr, weight, &z[0], out);
+}
+
+/**
+ * Find the cosine similarity of two sketched tensors. By Parseval the inner product of two
+ * sketches is the real part of sum_k X_k conj(Y_k) over the whole FFT, up to a factor that
+ * cancels. We only hold up to dim / 2, the rest being the conjugates, so the middle terms
+ * count twice.
+ * @param x the first sketch
+ * @param y the second sketch
+ * @return a float from 1.0 to 0.0 or 2.0 if there was an error
+ */
+
+float tensor_sketch_cosine_sim(const Sketch & x, const Sketch & y) {
+  double dot = 0, l0 = 0, l1 = 0;
+  size_t last = x.size() - 1;
+
+  for (size_t k = 0; k <= last; ++k) {
+    double f = (k == 0 || k == last) ? 1.0 : 2.0;
+    dot += f * ((x[k].real() * y[k].real()) + (x[k].imag() * y[k].imag()));
+    l0 += f * norm(x[k]);
+    l1 += f * norm(y[k]);
+  }
+
+  float dist = -1.0;
+  double d = sqrt(l0) * sqrt(l1);
+
+  if (d != 0.0) {
+    float sim = static_cast<float>(dot / d);
+    sim = std::max(-1.0f, std::min(1.0f, sim));
+    dist = acos(sim) / M_PI;
+  }
+
+  return 1.0 - dist;
+}
+
+/**
+ * The header names for a set of Kronecker columns. The exact ones come first unless we
+ * are leaving them out, then the approximate ones if we are sketching.
+ * @param names the exact column names
+ * @param options the sketch options
+ * @return the names, each after a comma
+ */
+
+string sketch_columns(const vector<string> & names, const SketchOptions & options) {
+  string columns;
+  if (!options.only || options.epsilon <= 0) {
+    for (const string & n : names) { columns += "," + n; }
+  }
+  if (options.epsilon > 0) {
+    for (const string & n : names) { columns += "," + n + "_approx"; }
+  }
+  return columns;
+}
@@ -0,0 +1,410 @@
+/**
+* @brief Compressed sparse row storage for the count and PMI word vectors
+* @file wacky_sparse.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_sparse.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+using namespace std;
+
+/**
+ * Make an empty set of counts
+ * @param counts the SparseCounts to reset
+ * @param num_rows how many rows (VOCAB_SIZE + 1 for the word vectors)
+ * @param num_cols how many columns (the BASIS_SIZE)
+ */
+
+void sparse_counts_init(SparseCounts & counts, size_t num_rows, size_t num_cols) {
+  counts.num_rows = num_rows;
+  counts.num_cols = num_cols;
+  counts.shards.clear();
+  counts.shards.resize(SPARSE_COUNT_SHARDS);
+}
+
+/**
+ * Merge two sorted runs into one, adding the counts of keys that are in both
+ * @param a the first run
+ * @param b the second run
+ * @param out the run we fill
+ */
+
+static void merge_runs(const SparseRun & a, const SparseRun & b, SparseRun & out) {
+  out.keys.clear();
+  out.vals.clear();
+  out.keys.reserve(a.keys.size() + b.keys.size());
+  out.vals.reserve(a.keys.size() + b.keys.size());
+
+  size_t i = 0, j = 0;
+  while (i < a.keys.size() && j < b.keys.size()) {
+    if (a.keys[i] < b.keys[j]) {
+      out.keys.push_back(a.keys[i]);
+      out.vals.push_back(a.vals[i++]);
+    } else if (a.keys[i] > b.keys[j]) {
+      out.keys.push_back(b.keys[j]);
+      out.vals.push_back(b.vals[j++]);
+    } else {
+      out.keys.push_back(a.keys[i]);
+      out.vals.push_back(a.vals[i++] + b.vals[j++]);
+    }
+  }
+  out.keys.insert(out.keys.end(), a.keys.begin() + i, a.keys.end());
+  out.vals.insert(out.vals.end(), a.vals.begin() + i, a.vals.end());
+  out.keys.insert(out.keys.end(), b.keys.begin() + j, b.keys.end());
+  out.vals.insert(out.vals.end(), b.vals.begin() + j, b.vals.end());
+}
+
+/**
+ * Merge the top two runs of a shard into one
+ * @param runs the shard's stack of runs
+ */
+
+static void merge_top(vector<SparseRun> & runs) {
+  SparseRun merged;
+  merge_runs(runs[runs.size() - 2], runs.back(), merged);
+  runs.pop_back();
+  runs.back() = std::move(merged);
+}
+
+/**
+ * Add a batch of hits to a shard. The batch is sorted into a run of its own and pushed on
+ * the shard's stack, then runs are merged while the one below is no bigger than the top.
+ * @param counts the SparseCounts
+ * @param shard the shard every row in the batch belongs to
+ * @param hits (row, col) pairs one after the other, each counting one
+ */
+
+void sparse_counts_add(SparseCounts & counts, size_t shard, const vector<int> & hits) {
+  if (hits.empty()) { return; }
+
+  vector<uint64_t> keys;
+  keys.reserve(hits.size() / 2);
+  for (size_t i = 0; i < hits.size(); i += 2) {
+    keys.push_back(static_cast<uint64_t>(hits[i]) * counts.num_cols + hits[i+1]);
+  }
+  std::sort(keys.begin(), keys.end());
+
+  SparseRun run;
+  for (size_t i = 0; i < keys.size(); ) {
+    size_t j = i + 1;
+    while (j < keys.size() && keys[j] == keys[i]) { ++j; }
+    run.keys.push_back(keys[i]);
+    run.vals.push_back(static_cast<float>(j - i));
+    i = j;
+  }
+
+  vector<SparseRun> & runs = counts.shards[shard];
+  runs.push_back(std::move(run));
+  while (runs.size() > 1 && runs[runs.size() - 2].keys.size() <= runs.back().keys.size()) {
+    merge_top(runs);
+  }
+}
+
+/**
+ * Pack the counts into sparse rows. Each shard's runs are merged down to one, which holds
+ * its rows in order and each row by column, so they drop straight into place.
+ * @param counts the counts from the counting pass, whose runs this merges
+ * @param sparse the SparseVectors we fill
+ */
+
+void sparse_from_counts(SparseCounts & counts, SparseVectors & sparse) {
+  size_t num_cols = counts.num_cols;
+  int num_shards = counts.shards.size();
+
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int s = 0; s < num_shards; ++s) {
+    vector<SparseRun> & runs = counts.shards[s];
+    while (runs.size() > 1) { merge_top(runs); }
+  }
+
+  sparse.num_cols = num_cols;
+  sparse.row_ptr.assign(counts.num_rows + 1, 0);
+  for (const vector<SparseRun> & runs : counts.shards) {
+    if (runs.empty()) { continue; }
+    for (uint64_t key : runs[0].keys) { sparse.row_ptr[key / num_cols + 1]++; }
+  }
+  for (size_t r = 0; r < counts.num_rows; ++r) {
+    sparse.row_ptr[r + 1] += sparse.row_ptr[r];
+  }
+
+  sparse.col_idx.resize(sparse.row_ptr.back());
+  sparse.vals.resize(sparse.row_ptr.back());
+  vector<size_t> next (sparse.row_ptr.begin(), sparse.row_ptr.end() - 1);
+
+  // No row is in two shards, so the shards can fill their rows at once
+  #pragma omp parallel for schedule(dynamic, 1)
+  for (int s = 0; s < num_shards; ++s) {
+    if (counts.shards[s].empty()) { continue; }
+    const SparseRun & run = counts.shards[s][0];
+    for (size_t k = 0; k < run.keys.size(); ++k) {
+      size_t pos = next[run.keys[k] / num_cols]++;
+      sparse.col_idx[pos] = run.keys[k] % num_cols;
+      sparse.vals[pos] = run.vals[k];
+    }
+  }
+}
+
+/**
+ * Add a row to the end of a SparseVectors
+ * @param sparse the SparseVectors we are building
+ * @param row the dense row, whose zeroes we drop
+ */
+
+void sparse_push_row(SparseVectors & sparse, const vector<float> & row) {
+  if (sparse.row_ptr.empty()) { sparse.row_ptr.push_back(0); }
+
+  for (size_t i = 0; i < row.size(); ++i) {
+    if (row[i] != 0.0f) {
+      sparse.col_idx.push_back(i);
+      sparse.vals.push_back(row[i]);
+    }
+  }
+  sparse.row_ptr.push_back(sparse.vals.size());
+}
+
+/**
+ * Add a row we already have as its non-zeroes to the end of a SparseVectors
+ * @param sparse the SparseVectors we are building
+ * @param cols the columns of the row, in order
+ * @param vals the value at each column, whose zeroes we drop
+ */
+
+void sparse_push_row(SparseVectors & sparse, const vector<int> & cols, const vector<float> & vals) {
+  if (sparse.row_ptr.empty()) { sparse.row_ptr.push_back(0); }
+
+  for (size_t k = 0; k < vals.size(); ++k) {
+    if (vals[k] != 0.0f) {
+      sparse.col_idx.push_back(cols[k]);
+      sparse.vals.push_back(vals[k]);
+    }
+  }
+  sparse.row_ptr.push_back(sparse.vals.size());
+}
+
+/**
+ * Add a row with nothing in it
+ * @param sparse the SparseVectors we are building
+ */
+
+void sparse_push_empty(SparseVectors & sparse) {
+  if (sparse.row_ptr.empty()) { sparse.row_ptr.push_back(0); }
+  sparse.row_ptr.push_back(sparse.vals.size());
+}
+
+/**
+ * Pack dense rows into sparse rows
+ * @param dense the dense rows. Short or empty rows are fine.
+ * @param num_cols how many columns a full row has
+ * @param sparse the SparseVectors we fill
+ */
+
+void sparse_from_dense(const vector< vector<float> > & dense, size_t num_cols, SparseVectors & sparse) {
+  sparse.num_cols = num_cols;
+  sparse.row_ptr.assign(1, 0);
+  sparse.col_idx.clear();
+  sparse.vals.clear();
+
+  for (const vector<float> & row : dense) {
+    sparse_push_row(sparse, row);
+  }
+}
+
+/**
+ * Unpack one row
+ * @param sparse the SparseVectors
+ * @param row which row
+ * @param out set to num_cols floats
+ */
+
+void sparse_row_dense(const SparseVectors & sparse, size_t row, vector<float> & out) {
+  out.assign(sparse.num_cols, 0.0f);
+  for (size_t k = sparse.row_ptr[row]; k < sparse.row_ptr[row+1]; ++k) {
+    out[sparse.col_idx[k]] = sparse.vals[k];
+  }
+}
+
+/**
+ * Unpack one row into a block of floats
+ * @param sparse the SparseVectors
+ * @param row which row
+ * @param out num_cols floats, which we overwrite
+ */
+
+void sparse_row_dense(const SparseVectors & sparse, size_t row, float * out) {
+  std::fill(out, out + sparse.num_cols, 0.0f);
+  for (size_t k = sparse.row_ptr[row]; k < sparse.row_ptr[row+1]; ++k) {
+    out[sparse.col_idx[k]] = sparse.vals[k];
+  }
+}
+
+/**
+ * The dot product of two sparse rows, walking both in column order
+ * @param a the first SparseVectors
+ * @param ra the row in a
+ * @param b the second SparseVectors
+ * @param rb the row in b
+ * @return the dot product
+ */
+
+float sparse_dot(const SparseVectors & a, size_t ra, const SparseVectors & b, size_t rb) {
+  size_t i = a.row_ptr[ra], ie = a.row_ptr[ra+1];
+  size_t j = b.row_ptr[rb], je = b.row_ptr[rb+1];
+  float dot = 0;
+
+  while (i < ie && j < je) {
+    if (a.col_idx[i] < b.col_idx[j]) {
+      ++i;
+    } else if (a.col_idx[i] > b.col_idx[j]) {
+      ++j;
+    } else {
+      dot += a.vals[i++] * b.vals[j++];
+    }
+  }
+  return dot;
+}
+
+/**
+ * The squared distance between two sparse rows. We walk the columns either row has in
+ * order, so the sum comes out the same as going over every column of the dense rows.
+ * @param a the first SparseVectors
+ * @param ra the row in a
+ * @param b the second SparseVectors
+ * @param rb the row in b
+ * @return the sum of the squared differences
+ */
+
+float sparse_dist2(const SparseVectors & a, size_t ra, const SparseVectors & b, size_t rb) {
+  size_t i = a.row_ptr[ra], ie = a.row_ptr[ra+1];
+  size_t j = b.row_ptr[rb], je = b.row_ptr[rb+1];
+  float dd = 0;
+
+  while (i < ie || j < je) {
+    float d;
+    if (j == je || (i < ie && a.col_idx[i] < b.col_idx[j])) {
+      d = a.vals[i++];
+    } else if (i == ie || a.col_idx[i] > b.col_idx[j]) {
+      d = -b.vals[j++];
+    } else {
+      d = a.vals[i++] - b.vals[j++];
+    }
+    dd += d * d;
+  }
+  return dd;
+}
+
+/**
+ * The squared length of a sparse row
+ * @param a the SparseVectors
+ * @param ra the row
+ * @return the sum of the squares
+ */
+
+static float sparse_norm2(const SparseVectors & a, size_t ra) {
+  float l = 0;
+  for (size_t k = a.row_ptr[ra]; k < a.row_ptr[ra+1]; ++k) {
+    l += a.vals[k] * a.vals[k];
+  }
+  return l;
+}
+
+/**
+ * Turn a dot product and two squared lengths into the same measure cosine_sim gives
+ * @param dot the dot product
+ * @param l0 the squared length of the first vector
+ * @param l1 the squared length of the second vector
+ * @return a float from 1.0 to 0.0 or 2.0 if either vector was zero
+ */
+
+static float angular_sim(float dot, float l0, float l1) {
+  float dist = -1.0;
+  float d = sqrt(l0) * sqrt(l1);
+  if (d != 0.0f) {
+    // Rounding can push a vector's similarity with itself just past 1
+    float sim = std::max(-1.0f, std::min(1.0f, dot / d));
+    dist = acos(sim) / M_PI;
+  }
+  return 1.0 - dist;
+}
+
+/**
+ * Find the cosine similarity between two sparse rows. The cost is the number of non-zeroes.
+ * @param a the first SparseVectors
+ * @param ra the row in a
+ * @param b the second SparseVectors
+ * @param rb the row in b
+ * @return a float from 1.0 to 0.0 or 2.0 if there was an error
+ */
+
+float sparse_cosine_sim(const SparseVectors & a, size_t ra, const SparseVectors & b, size_t rb) {
+  return angular_sim(sparse_dot(a, ra, b, rb), sparse_norm2(a, ra), sparse_norm2(b, rb));
+}
+
+/**
+ * Find the cosine similarity between a sparse row and a dense vector
+ * @param a the SparseVectors
+ * @param ra the row in a
+ * @param v a dense vector of at least num_cols
+ * @return a float from 1.0 to 0.0 or 2.0 if there was an error
+ */
+
+float sparse_cosine_sim(const SparseVectors & a, size_t ra, const vector<float> & v) {
+  float dot = 0;
+  for (size_t k = a.row_ptr[ra]; k < a.row_ptr[ra+1]; ++k) {
+    dot += a.vals[k] * v[a.col_idx[k]];
+  }
+
+  float l1 = 0;
+  for (float f : v) { l1 += f * f; }
+
+  return angular_sim(dot, sparse_norm2(a, ra), l1);
+}
+
+/**
+ * Add a scaled sparse row to a dense vector, y += alpha * row. This is the summation
+ * kernel for adding up subject and object vectors.
+ * @param a the SparseVectors
+ * @param row the row to add
+ * @param alpha the scale, usually how many times we saw the word
+ * @param y the dense vector, at least num_cols long
+ */
+
+void sparse_axpy(const SparseVectors & a, size_t row, float alpha, float * y) {
+  for (size_t k = a.row_ptr[row]; k < a.row_ptr[row+1]; ++k) {
+    y[a.col_idx[k]] += alpha * a.vals[k];
+  }
+}
+
+/**
+ * Add the scaled sum of two sparse rows to a dense vector, y += alpha * (row a + row b).
+ * Where both rows have a column their values are added first, as the dense sum does.
+ * @param a the SparseVectors
+ * @param ra the first row to add
+ * @param rb the second row to add
+ * @param alpha the scale, usually how many times we saw the pair
+ * @param y the dense vector, at least num_cols long
+ */
+
+void sparse_axpy(const SparseVectors & a, size_t ra, size_t rb, float alpha, float * y) {
+  size_t i = a.row_ptr[ra], ie = a.row_ptr[ra+1];
+  size_t j = a.row_ptr[rb], je = a.row_ptr[rb+1];
+
+  while (i < ie || j < je) {
+    if (j == je || (i < ie && a.col_idx[i] < a.col_idx[j])) {
+      y[a.col_idx[i]] += alpha * a.vals[i];
+      ++i;
+    } else if (i == ie || a.col_idx[i] > a.col_idx[j]) {
+      y[a.col_idx[j]] += alpha * a.vals[j];
+      ++j;
+    } else {
+      y[a.col_idx[i]] += alpha * (a.vals[i] + a.vals[j]);
+      ++i;
+      ++j;
+    }
+  }
+}
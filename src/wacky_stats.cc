@@ -0,0 +1,285 @@
+/**
+* @brief Timings, throughput and memory for each stage of a run, reported as JSON
+* @file wacky_stats.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_stats.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <vector>
+
+#include <omp.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "wacky_output.hpp"
+
+using namespace std;
+
+struct StageRecord {
+  std::string name;
+  int depth;
+  double start;
+  double seconds;
+  bool open;
+  std::atomic<long> peak_rss_kb {0};
+  std::atomic<uint64_t> bytes {0};
+  std::atomic<uint64_t> sentences {0};
+  std::atomic<uint64_t> tokens {0};
+  std::atomic<uint64_t> steps {0};
+  std::atomic<uint64_t> total {0};
+  double busy[STATS_MAX_THREADS];
+};
+
+static std::deque<StageRecord> STAGES;
+static std::vector<size_t> OPEN_STAGES;
+static std::string REPORT_PATH;
+static std::string COMMAND;
+static int THREADS = 1;
+static double RUN_START = omp_get_wtime();
+static std::atomic<int64_t> NEXT_STATUS_MS {0};
+static std::atomic<int64_t> NEXT_RSS_MS {0};
+
+static StageRecord * current_stage() {
+  return OPEN_STAGES.empty() ? NULL : &STAGES[OPEN_STAGES.back()];
+}
+
+//! the most memory the process has held at any one time since it started
+static long peak_rss_kb() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) { return 0; }
+  return usage.ru_maxrss;
+}
+
+//! the memory the process holds right now, or 0 if there is no /proc to ask
+static long current_rss_kb() {
+  FILE * file = fopen("/proc/self/statm", "r");
+  if (file == NULL) { return 0; }
+  long size = 0, resident = 0;
+  int read = fscanf(file, "%ld %ld", &size, &resident);
+  fclose(file);
+  if (read != 2) { return 0; }
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+//! raise a stage's peak to rss_kb if that is higher. Safe from any thread.
+static void raise_peak(StageRecord & stage, long rss_kb) {
+  long peak = stage.peak_rss_kb.load(std::memory_order_relaxed);
+  while (rss_kb > peak && !stage.peak_rss_kb.compare_exchange_weak(peak, rss_kb, std::memory_order_relaxed)) {}
+}
+
+static void json_string(TextBuffer & out, const std::string & s) {
+  out << '"';
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char tmp[8];
+      snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+      out << tmp;
+    } else {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+static double stage_seconds(const StageRecord & stage, double now) {
+  return stage.open ? now - stage.start : stage.seconds;
+}
+
+/**
+ * Write what the current stage has done so far to the status file. We write a new file
+ * and rename it over the old one so a reader never sees half of it.
+ * @param now the time from omp_get_wtime
+ */
+
+static void write_status(double now) {
+  TextBuffer out;
+  StageRecord * stage = current_stage();
+  out << "elapsed " << now - RUN_START << " s\n";
+
+  if (stage != NULL) {
+    double seconds = stage_seconds(*stage, now);
+    out << "stage ";
+    for (size_t i : OPEN_STAGES) { out << STAGES[i].name << (i == OPEN_STAGES.back() ? "\n" : " > "); }
+    out << "stage_elapsed " << seconds << " s\n";
+    out << "steps " << stage->steps.load();
+    if (stage->total.load() > 0) {
+      out << " of " << stage->total.load() << " (" << 100.0 * stage->steps.load() / stage->total.load() << "%)";
+    }
+    out << '\n';
+    if (seconds <= 0) { seconds = 1e-9; }
+    out << "bytes " << stage->bytes.load() << " (" << stage->bytes.load() / (seconds * 1048576.0) << " MB/s)\n";
+    out << "sentences " << stage->sentences.load() << '\n';
+    out << "tokens " << stage->tokens.load() << " (" << stage->tokens.load() / seconds << " per s)\n";
+  }
+  if (stage != NULL) { out << "stage_peak_rss_kb " << stage->peak_rss_kb.load() << '\n'; }
+  out << "rss_kb " << current_rss_kb() << '\n';
+  out << "peak_rss_kb " << peak_rss_kb() << '\n';
+
+  string tmp = REPORT_PATH + ".status.tmp";
+  TextFile file;
+  if (!file.open(tmp)) { return; }
+  file.write(out);
+  file.close();
+  rename(tmp.c_str(), (REPORT_PATH + ".status").c_str());
+}
+
+/**
+ * Sample the memory into the current stage's peak if it is time to, then rewrite the status
+ * file if it is time to. Only the thread that moves a deadline on does either.
+ */
+
+static void maybe_status() {
+  double now = omp_get_wtime();
+  int64_t ms = static_cast<int64_t>(now * 1000.0);
+
+  int64_t next_rss = NEXT_RSS_MS.load(std::memory_order_relaxed);
+  if (ms >= next_rss && NEXT_RSS_MS.compare_exchange_strong(next_rss, ms + static_cast<int64_t>(STATS_RSS_SECONDS * 1000.0))) {
+    StageRecord * stage = current_stage();
+    if (stage != NULL) { raise_peak(*stage, current_rss_kb()); }
+  }
+
+  if (REPORT_PATH.empty()) { return; }
+  int64_t next = NEXT_STATUS_MS.load(std::memory_order_relaxed);
+  if (ms < next) { return; }
+  if (!NEXT_STATUS_MS.compare_exchange_strong(next, ms + static_cast<int64_t>(STATS_STATUS_SECONDS * 1000.0))) { return; }
+  write_status(now);
+}
+
+/**
+ * Write the JSON report with every stage we timed. Registered with atexit by stats_init.
+ */
+
+static void write_report() {
+  double now = omp_get_wtime();
+  TextBuffer out;
+  out << "{\n  \"command\": ";
+  json_string(out, COMMAND);
+  out << ",\n  \"threads\": " << THREADS;
+  out << ",\n  \"seconds\": " << now - RUN_START;
+  out << ",\n  \"peak_rss_kb\": " << peak_rss_kb();
+  out << ",\n  \"stages\": [";
+
+  for (size_t i = 0; i < STAGES.size(); ++i) {
+    const StageRecord & stage = STAGES[i];
+    double seconds = stage_seconds(stage, now);
+    uint64_t bytes = stage.bytes.load();
+    uint64_t tokens = stage.tokens.load();
+
+    out << (i == 0 ? "\n" : ",\n") << "    {\"name\": ";
+    json_string(out, stage.name);
+    out << ", \"depth\": " << stage.depth;
+    out << ", \"seconds\": " << seconds;
+    out << ", \"bytes\": " << bytes;
+    out << ", \"sentences\": " << stage.sentences.load();
+    out << ", \"tokens\": " << tokens;
+    out << ", \"mb_per_second\": " << (seconds > 0 ? bytes / (seconds * 1048576.0) : 0.0);
+    out << ", \"tokens_per_second\": " << (seconds > 0 ? tokens / seconds : 0.0);
+    out << ", \"steps\": " << stage.steps.load();
+    out << ", \"peak_rss_kb\": " << stage.peak_rss_kb.load();
+
+    int last = STATS_MAX_THREADS - 1;
+    while (last >= 0 && stage.busy[last] == 0) { --last; }
+    out << ", \"thread_busy_seconds\": [";
+    for (int t = 0; t <= last; ++t) { out << (t == 0 ? "" : ", ") << stage.busy[t]; }
+    out << "]}";
+  }
+  out << "\n  ]\n}\n";
+
+  TextFile file;
+  if (!file.open(REPORT_PATH)) {
+    cout << "Unable to open " << REPORT_PATH << " for writing" << endl;
+    return;
+  }
+  file.write(out);
+  file.close();
+  cout << "Wrote the run report to " << REPORT_PATH << endl;
+}
+
+/**
+ * Start reporting on this run
+ * @param report_path where the JSON report goes. Progress goes beside it with .status on the end
+ * @param argc the argument count from main
+ * @param argv the arguments from main, kept for the report
+ */
+
+void stats_init(string report_path, int argc, char* argv[]) {
+  REPORT_PATH = report_path;
+  THREADS = omp_get_max_threads();
+  COMMAND.clear();
+  for (int i = 0; i < argc; ++i) {
+    if (i > 0) { COMMAND += " "; }
+    COMMAND += argv[i];
+  }
+  std::atexit(write_report);
+  write_status(omp_get_wtime());
+}
+
+StatsStage::StatsStage(const string & name) {
+  STAGES.emplace_back();
+  StageRecord & stage = STAGES.back();
+  stage.name = name;
+  stage.depth = OPEN_STAGES.size();
+  stage.start = omp_get_wtime();
+  stage.seconds = 0;
+  stage.open = true;
+  raise_peak(stage, current_rss_kb());
+  for (double & b : stage.busy) { b = 0; }
+
+  index_ = STAGES.size() - 1;
+  OPEN_STAGES.push_back(index_);
+  maybe_status();
+}
+
+StatsStage::~StatsStage() {
+  StageRecord & stage = STAGES[index_];
+  stage.seconds = omp_get_wtime() - stage.start;
+  stage.open = false;
+  raise_peak(stage, current_rss_kb());
+  OPEN_STAGES.pop_back();
+
+  // Whatever an inner stage held, the stage around it held too
+  StageRecord * outer = current_stage();
+  if (outer != NULL) { raise_peak(*outer, stage.peak_rss_kb.load()); }
+}
+
+void stats_count(uint64_t bytes, uint64_t sentences, uint64_t tokens) {
+  StageRecord * stage = current_stage();
+  if (stage == NULL) { return; }
+  if (bytes > 0) { stage->bytes.fetch_add(bytes, std::memory_order_relaxed); }
+  if (sentences > 0) { stage->sentences.fetch_add(sentences, std::memory_order_relaxed); }
+  if (tokens > 0) { stage->tokens.fetch_add(tokens, std::memory_order_relaxed); }
+  maybe_status();
+}
+
+void stats_total(uint64_t steps) {
+  StageRecord * stage = current_stage();
+  if (stage != NULL) { stage->total.store(steps); }
+}
+
+void stats_step() {
+  StageRecord * stage = current_stage();
+  if (stage == NULL) { return; }
+  stage->steps.fetch_add(1, std::memory_order_relaxed);
+  maybe_status();
+}
+
+StatsBusy::StatsBusy() : start_(omp_get_wtime()) {}
+
+StatsBusy::~StatsBusy() {
+  StageRecord * stage = current_stage();
+  if (stage == NULL) { return; }
+  double elapsed = omp_get_wtime() - start_;
+  double & busy = stage->busy[omp_get_thread_num() % STATS_MAX_THREADS];
+  #pragma omp atomic
+  busy += elapsed;
+}
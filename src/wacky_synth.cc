@@ -0,0 +1,308 @@
+/**
+* @brief Synthetic ukWaC style corpora for benchmarking
+* @file wacky_synth.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_synth.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include <omp.h>
+
+#include "wacky_output.hpp"
+
+using namespace std;
+
+#define SYNTH_NOUN 0
+#define SYNTH_VERB 1
+#define SYNTH_ADJECTIVE 2
+#define SYNTH_CLASSES 3
+
+static const char * SYNTH_SYLLABLES[] = {"ba", "de", "ki", "lo", "mu", "ra", "se", "ti",
+  "vo", "ne", "pa", "gu", "fi", "ho", "zo", "we"};
+static const size_t SYNTH_NUM_SYLLABLES = 16;
+
+static const char * SYNTH_DETERMINERS[] = {"the", "a", "this", "some"};
+static const char * SYNTH_PREPOSITIONS[] = {"of", "in", "with", "on", "for", "from"};
+
+// How many sentences go in each <text> block
+#define SYNTH_DOCUMENT_SENTENCES 40
+
+struct SynthToken {
+  string word;
+  string lemma;
+  const char * pos;
+  int head;
+  const char * deprel;
+};
+
+//! Draws ranks 0 to n-1 with probability falling off as 1 / (rank + 1)^s
+class ZipfSampler {
+public:
+  ZipfSampler(size_t n, double s) : cdf_(std::max<size_t>(n, 1)) {
+    double total = 0;
+    for (size_t i = 0; i < cdf_.size(); ++i) {
+      total += 1.0 / pow(static_cast<double>(i + 1), s);
+      cdf_[i] = total;
+    }
+  }
+
+  size_t operator()(std::mt19937 & rng) const {
+    std::uniform_real_distribution<double> u (0, cdf_.back());
+    size_t r = std::upper_bound(cdf_.begin(), cdf_.end(), u(rng)) - cdf_.begin();
+    return std::min(r, cdf_.size() - 1);
+  }
+
+private:
+  vector<double> cdf_;
+};
+
+//! Everything one file needs to write sentences. The samplers are shared between threads.
+struct SynthGenerator {
+  const SynthOptions & options;
+  const ZipfSampler & nouns;
+  const ZipfSampler & verbs;
+  const ZipfSampler & adjectives;
+  const vector<char> & transitive;
+  std::mt19937 rng;
+
+  bool chance(double p) { return std::uniform_real_distribution<double>(0, 1)(rng) < p; }
+  size_t pick(size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(rng); }
+};
+
+/**
+ * The made up word for one entry of a word class. We write i * SYNTH_CLASSES + class in
+ * bijective base 16 with a syllable per digit, so no two entries share a word.
+ * @param i the index within the class, the most frequent being 0
+ * @param word_class noun, verb or adjective
+ * @return the word
+ */
+
+string synth_word(size_t i, int word_class) {
+  // Start past the single syllable words so every word has at least two
+  size_t n = i * SYNTH_CLASSES + word_class + SYNTH_NUM_SYLLABLES + 1;
+  string word;
+  while (n > 0) {
+    n -= 1;
+    word += SYNTH_SYLLABLES[n % SYNTH_NUM_SYLLABLES];
+    n /= SYNTH_NUM_SYLLABLES;
+  }
+  return word;
+}
+
+/**
+ * Add a noun phrase, a noun with perhaps a determiner and an adjective in front
+ * @param sentence the sentence so far
+ * @param gen the generator
+ * @param head the id of the token the noun hangs off
+ * @param deprel the relation of the noun to its head
+ */
+
+static void add_noun_phrase(vector<SynthToken> & sentence, SynthGenerator & gen, int head, const char * deprel) {
+  bool det = gen.chance(0.6);
+  bool adj = gen.chance(0.3);
+  int noun_id = sentence.size() + 1 + det + adj;
+
+  if (det) {
+    const char * d = SYNTH_DETERMINERS[gen.pick(4)];
+    sentence.push_back({d, d, "DT", noun_id, "NMOD"});
+  }
+  if (adj) {
+    string a = synth_word(gen.adjectives(gen.rng), SYNTH_ADJECTIVE);
+    sentence.push_back({a, a, "JJ", noun_id, "NMOD"});
+  }
+
+  string n = synth_word(gen.nouns(gen.rng), SYNTH_NOUN);
+  if (gen.chance(0.3)) {
+    sentence.push_back({n + "s", n, "NNS", head, deprel});
+  } else {
+    sentence.push_back({n, n, "NN", head, deprel});
+  }
+}
+
+/**
+ * Add a clause - subject, verb, perhaps an object and perhaps a prepositional phrase
+ * @param sentence the sentence so far
+ * @param gen the generator
+ * @param parent the id of the verb this clause is coordinated with, or 0 for the root
+ * @return the id of the clause's verb
+ */
+
+static int add_clause(vector<SynthToken> & sentence, SynthGenerator & gen, int parent) {
+  // The subject comes first, so work out where the verb will land before adding it
+  size_t start = sentence.size();
+  add_noun_phrase(sentence, gen, 0, "SBJ");
+  int verb_id = sentence.size() + 1;
+  for (size_t k = start; k < sentence.size(); ++k) {
+    if (sentence[k].head == 0) { sentence[k].head = verb_id; }
+  }
+
+  size_t v = gen.verbs(gen.rng);
+  string lemma = synth_word(v, SYNTH_VERB);
+  const char * pos[] = {"VV", "VVZ", "VVD", "VVG"};
+  const char * ending[] = {"", "s", "d", "ing"};
+  int form = gen.pick(4);
+  sentence.push_back({lemma + ending[form], lemma, pos[form], parent, parent == 0 ? "ROOT" : "COORD"});
+
+  if (gen.chance(gen.transitive[v] ? 0.85 : 0.1)) {
+    add_noun_phrase(sentence, gen, verb_id, "OBJ");
+  }
+
+  if (gen.chance(0.35)) {
+    int prep_id = sentence.size() + 1;
+    const char * p = SYNTH_PREPOSITIONS[gen.pick(6)];
+    sentence.push_back({p, p, "IN", verb_id, "ADV"});
+    add_noun_phrase(sentence, gen, prep_id, "PMOD");
+  }
+  return verb_id;
+}
+
+/**
+ * Write one file of the corpus
+ * @param filepath where it goes
+ * @param file_index which file this is, for the text ids
+ * @param num_tokens roughly how many tokens to write
+ * @param gen the generator, seeded for this file
+ * @param counts what we wrote
+ * @return a 1 or 0 for failure or success
+ */
+
+static int synth_file(string filepath, size_t file_index, size_t num_tokens, SynthGenerator & gen, SynthCounts & counts) {
+  TextFile out;
+  if (!out.open(filepath)) {
+    cout << "Unable to open " << filepath << " for writing" << endl;
+    return 1;
+  }
+
+  // Log-normal lengths with the mean we asked for
+  double sigma = 0.5;
+  std::lognormal_distribution<double> length (log(gen.options.mean_sentence) - sigma * sigma / 2, sigma);
+
+  vector<SynthToken> sentence;
+  TextBuffer text;
+  size_t document = 0;
+
+  while (counts.tokens < num_tokens) {
+    if (counts.sentences % SYNTH_DOCUMENT_SENTENCES == 0) {
+      if (counts.sentences > 0) { text << "</text>\n"; }
+      text << "<text id=\"synthetic:" << file_index << "-" << document++ << "\">\n";
+    }
+
+    size_t target = std::min(std::max(length(gen.rng), 3.0), 150.0);
+    sentence.clear();
+    int root = add_clause(sentence, gen, 0);
+    while (sentence.size() + 4 < target) {
+      if (gen.chance(0.5)) { sentence.push_back({",", ",", ",", root, "P"}); }
+      sentence.push_back({"and", "and", "CC", root, "CC"});
+      add_clause(sentence, gen, root);
+    }
+    sentence.push_back({".", ".", "SENT", root, "P"});
+    sentence[0].word[0] = toupper(sentence[0].word[0]);
+
+    text << "<s>\n";
+    for (size_t k = 0; k < sentence.size(); ++k) {
+      const SynthToken & t = sentence[k];
+      text << t.word << '\t' << t.lemma << '\t' << t.pos << '\t' << k + 1 << '\t' << t.head << '\t' << t.deprel << '\n';
+    }
+    text << "</s>\n";
+
+    counts.sentences++;
+    counts.tokens += sentence.size();
+    counts.bytes += text.size();
+    out.write(text);
+    text.clear();
+  }
+
+  out << "</text>\n";
+  counts.bytes += 8;
+  out.close();
+  return 0;
+}
+
+/**
+ * Write a synthetic corpus in the MaltParser format ukWaC uses, the files made in parallel
+ * @param OUTPUT_DIR the directory the files go in
+ * @param options the shape of the corpus
+ * @param filenames we add the path of each file we write
+ * @param counts the bytes, sentences and tokens we wrote
+ * @return a 1 or 0 for failure or success
+ */
+
+int synth_corpus(string OUTPUT_DIR, const SynthOptions & options,
+    vector<string> & filenames,
+    SynthCounts & counts) {
+
+  ZipfSampler nouns (options.num_nouns, options.zipf);
+  ZipfSampler verbs (options.num_verbs, options.zipf);
+  ZipfSampler adjectives (options.num_adjectives, options.zipf);
+
+  std::mt19937 rng (options.seed);
+  vector<char> transitive (std::max<size_t>(options.num_verbs, 1));
+  for (char & t : transitive) { t = std::uniform_real_distribution<double>(0, 1)(rng) < options.transitive; }
+
+  size_t num_files = std::max<size_t>(options.num_files, 1);
+  vector<string> paths (num_files);
+  vector<SynthCounts> file_counts (num_files);
+  int failed = 0;
+
+  #pragma omp parallel for schedule(dynamic, 1) reduction(+:failed)
+  for (size_t f = 0; f < num_files; ++f) {
+    char name[32];
+    snprintf(name, sizeof(name), "/ukwac_%02zu", f);
+    paths[f] = OUTPUT_DIR + name;
+
+    SynthGenerator gen {options, nouns, verbs, adjectives, transitive, std::mt19937(options.seed * 1000003u + f)};
+    size_t num_tokens = options.num_tokens / num_files + (f < options.num_tokens % num_files);
+    failed += synth_file(paths[f], f, num_tokens, gen, file_counts[f]);
+  }
+
+  if (failed > 0) { return 1; }
+
+  for (size_t f = 0; f < num_files; ++f) {
+    filenames.push_back(paths[f]);
+    counts.bytes += file_counts[f].bytes;
+    counts.sentences += file_counts[f].sentences;
+    counts.tokens += file_counts[f].tokens;
+  }
+  return 0;
+}
+
+/**
+ * Write verb pairs in the SimVerb-3500 layout, both verbs drawn evenly from the most
+ * frequent ones so they make it into the dictionary
+ * @param simverb_path the file to write
+ * @param options the corpus options, for the verbs and the seed
+ * @param num_pairs how many pairs
+ * @return a 1 or 0 for failure or success
+ */
+
+int synth_simverbs(string simverb_path, const SynthOptions & options, size_t num_pairs) {
+  TextFile out;
+  if (!out.open(simverb_path)) {
+    cout << "Unable to open " << simverb_path << " for writing" << endl;
+    return 1;
+  }
+
+  size_t num_verbs = std::min<size_t>(options.num_verbs, 200);
+  if (num_verbs < 2) { return 1; }
+
+  std::mt19937 rng (options.seed + 7);
+  std::uniform_int_distribution<size_t> verb (0, num_verbs - 1);
+  std::uniform_int_distribution<int> score (0, 1000);
+
+  for (size_t i = 0; i < num_pairs; ++i) {
+    size_t v0 = verb(rng);
+    size_t v1 = verb(rng);
+    while (v1 == v0) { v1 = verb(rng); }
+    out << synth_word(v0, SYNTH_VERB) << '\t' << synth_word(v1, SYNTH_VERB) << "\tV\t" << score(rng) / 100.0f << "\tNONE\n";
+  }
+  out.close();
+  return 0;
+}
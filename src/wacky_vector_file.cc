@@ -0,0 +1,249 @@
+/**
+* @brief A binary, memory mappable version of word_vectors.txt
+* @file wacky_vector_file.cc
+* @author Benjamin Blundell <oni@section9.co.uk>
+* @date 17/10/2026
+*
+*/
+
+#include "wacky_vector_file.hpp"
+#include "wacky_misc.hpp"
+
+#include <cstring>
+
+using namespace boost::filesystem;
+using namespace boost::interprocess;
+using namespace std;
+
+/**
+ * Write the header, row table and data. We go over the rows once per section so we
+ * never hold more than one row in memory beyond the vectors themselves.
+ * @param path the file to write
+ * @param num_rows how many rows
+ * @param num_cols how many columns a full row has
+ * @param nnz how many non-zero values there are in total
+ * @param row a function filling the column and value vectors with the non-zeroes of a row
+ * @return int a value to say if we succeeded or not
+ */
+
+template <typename RowFn>
+static int write_rows(string path, size_t num_rows, size_t num_cols, size_t nnz, RowFn row) {
+  std::ofstream out (path, std::ios::binary);
+  if (!out.is_open()) {
+    cout << "Unable to open " << path << " for writing" << endl;
+    return 1;
+  }
+
+  // A sparse entry costs a column and a value, so it only pays below half full
+  bool sparse = nnz * (sizeof(int32_t) + sizeof(float)) < num_rows * num_cols * sizeof(float);
+
+  VectorFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, "WBV1", 4);
+  header.version = VECTOR_FILE_VERSION;
+  header.num_rows = num_rows;
+  header.num_cols = num_cols;
+  header.nnz = sparse ? nnz : num_rows * num_cols;
+  header.sparse = sparse ? 1 : 0;
+  write_padded(out, &header, sizeof(header));
+
+  vector<int> cols;
+  vector<float> vals;
+  vector<uint64_t> starts (1, 0);
+  starts.reserve(num_rows + 1);
+  for (size_t r = 0; r < num_rows; ++r) {
+    if (sparse) {
+      row(r, cols, vals);
+      starts.push_back(starts.back() + vals.size());
+    } else {
+      starts.push_back(starts.back() + num_cols);
+    }
+  }
+  write_padded(out, &starts[0], starts.size() * sizeof(uint64_t));
+
+  if (sparse) {
+    vector<int32_t> c32;
+    for (size_t r = 0; r < num_rows; ++r) {
+      row(r, cols, vals);
+      c32.assign(cols.begin(), cols.end());
+      if (!c32.empty()) { out.write(reinterpret_cast<const char*>(&c32[0]), c32.size() * sizeof(int32_t)); }
+    }
+    write_padded(out, NULL, nnz * sizeof(int32_t));
+    for (size_t r = 0; r < num_rows; ++r) {
+      row(r, cols, vals);
+      if (!vals.empty()) { out.write(reinterpret_cast<const char*>(&vals[0]), vals.size() * sizeof(float)); }
+    }
+  } else {
+    vector<float> dense;
+    for (size_t r = 0; r < num_rows; ++r) {
+      row(r, cols, vals);
+      dense.assign(num_cols, 0.0f);
+      for (size_t k = 0; k < cols.size(); ++k) { dense[cols[k]] = vals[k]; }
+      if (num_cols > 0) { out.write(reinterpret_cast<const char*>(&dense[0]), num_cols * sizeof(float)); }
+    }
+  }
+
+  if (!out.good()) {
+    cout << "Failed writing " << path << endl;
+    return 1;
+  }
+  out.close();
+  return 0;
+}
+
+/**
+ * Write dense word vectors to a binary vector file
+ * @param path the file to write
+ * @param WORD_VECTORS the rows. Short rows are padded with zeroes.
+ * @param num_cols how many columns a full row has
+ * @return int a value to say if we succeeded or not
+ */
+
+int vector_file_write(string path, const vector< vector<float> > & WORD_VECTORS, size_t num_cols) {
+  size_t nnz = 0;
+  for (const vector<float> & tv : WORD_VECTORS) {
+    for (size_t c = 0; c < tv.size() && c < num_cols; ++c) {
+      if (tv[c] != 0.0f) { nnz++; }
+    }
+  }
+
+  return write_rows(path, WORD_VECTORS.size(), num_cols, nnz,
+    [&](size_t r, vector<int> & cols, vector<float> & vals) {
+      const vector<float> & tv = WORD_VECTORS[r];
+      cols.clear();
+      vals.clear();
+      for (size_t c = 0; c < tv.size() && c < num_cols; ++c) {
+        if (tv[c] != 0.0f) {
+          cols.push_back(c);
+          vals.push_back(tv[c]);
+        }
+      }
+    });
+}
+
+/**
+ * Write sparse word vectors to a binary vector file
+ * @param path the file to write
+ * @param WORD_VECTORS the sparse rows
+ * @return int a value to say if we succeeded or not
+ */
+
+int vector_file_write(string path, const SparseVectors & WORD_VECTORS) {
+  return write_rows(path, WORD_VECTORS.rows(), WORD_VECTORS.num_cols, WORD_VECTORS.nnz(),
+    [&](size_t r, vector<int> & cols, vector<float> & vals) {
+      size_t start = WORD_VECTORS.row_ptr[r];
+      size_t end = WORD_VECTORS.row_ptr[r+1];
+      cols.assign(WORD_VECTORS.col_idx.begin() + start, WORD_VECTORS.col_idx.begin() + end);
+      vals.assign(WORD_VECTORS.vals.begin() + start, WORD_VECTORS.vals.begin() + end);
+    });
+}
+
+/**
+ * Should the readers use the binary file? Only if it exists and was written no earlier
+ * than word_vectors.txt, so a text file from somewhere else is never shadowed.
+ * @param OUTPUT_DIR the output directory
+ * @return true if the binary file is there and current
+ */
+
+bool vector_file_current(string OUTPUT_DIR) {
+  path bin (OUTPUT_DIR + "/" + VECTOR_FILE_NAME);
+  path txt (OUTPUT_DIR + "/word_vectors.txt");
+  boost::system::error_code ec;
+
+  if (!is_regular_file(bin, ec)) { return false; }
+  if (!is_regular_file(txt, ec)) { return true; }
+  return last_write_time(bin, ec) >= last_write_time(txt, ec);
+}
+
+/**
+ * Map a vector file and point the sections at it
+ * @param vf the VectorFile to fill in
+ * @param path the .wbv file
+ * @return int a value to say if we succeeded or not
+ */
+
+int vector_file_open(VectorFile & vf, string path) {
+  try {
+    file_mapping file (path.c_str(), read_only);
+    mapped_region region (file, read_only);
+    vf.file.swap(file);
+    vf.region.swap(region);
+  } catch (interprocess_exception &ex) {
+    cout << "Unable to map " << path << ": " << ex.what() << endl;
+    return 1;
+  }
+
+  const char * base = static_cast<const char*>(vf.region.get_address());
+  size_t size = vf.region.get_size();
+
+  if (size < sizeof(VectorFileHeader)) {
+    cout << path << " is too small to be a vector file" << endl;
+    return 1;
+  }
+
+  vf.header = reinterpret_cast<const VectorFileHeader*>(base);
+  const VectorFileHeader & h = *vf.header;
+
+  if (memcmp(h.magic, "WBV1", 4) != 0 || h.version != VECTOR_FILE_VERSION) {
+    cout << path << " is not a version " << VECTOR_FILE_VERSION << " vector file" << endl;
+    return 1;
+  }
+
+  size_t offset = pad8(sizeof(VectorFileHeader));
+  size_t col_bytes = h.sparse ? pad8(h.nnz * sizeof(int32_t)) : 0;
+
+  if (size < offset + pad8((h.num_rows + 1) * sizeof(uint64_t)) + col_bytes + h.nnz * sizeof(float)) {
+    cout << path << " is truncated" << endl;
+    return 1;
+  }
+
+  vf.rows = reinterpret_cast<const uint64_t*>(base + offset);
+  offset += pad8((h.num_rows + 1) * sizeof(uint64_t));
+  vf.cols = h.sparse ? reinterpret_cast<const int32_t*>(base + offset) : NULL;
+  offset += col_bytes;
+  vf.vals = reinterpret_cast<const float*>(base + offset);
+  return 0;
+}
+
+/**
+ * Unpack one row
+ * @param vf an open VectorFile
+ * @param row which row
+ * @param out set to num_cols floats
+ */
+
+void vector_file_row(const VectorFile & vf, size_t row, vector<float> & out) {
+  uint64_t start = vf.rows[row];
+  uint64_t end = vf.rows[row + 1];
+
+  if (vf.header->sparse) {
+    out.assign(vf.header->num_cols, 0.0f);
+    for (uint64_t k = start; k < end; ++k) {
+      out[vf.cols[k]] = vf.vals[k];
+    }
+  } else {
+    out.assign(vf.vals + start, vf.vals + end);
+  }
+}
+
+/**
+ * Read the non-zeroes of one row without unpacking it
+ * @param vf an open VectorFile
+ * @param row which row
+ * @param cols set to the columns of the non-zeroes
+ * @param vals set to the values at those columns
+ */
+
+void vector_file_row(const VectorFile & vf, size_t row, vector<int> & cols, vector<float> & vals) {
+  uint64_t start = vf.rows[row];
+  uint64_t end = vf.rows[row + 1];
+  cols.clear();
+  vals.clear();
+
+  for (uint64_t k = start; k < end; ++k) {
+    if (vf.vals[k] != 0.0f) {
+      cols.push_back(vf.header->sparse ? vf.cols[k] : static_cast<int>(k - start));
+      vals.push_back(vf.vals[k]);
+    }
+  }
+}
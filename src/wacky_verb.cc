@@ -14,232 +14,260 @@ using namespace std;
 
 
 /**
- * Create a list of verb objects
- * @param str_buffer the sentence we are looking at from ukwac
- * @param verb_obj_pairs a list of verb object pairs
- * @param DICTIONARY_FAST the fast dictionary
- * @param VERB_OBJECTS the vector we will create
+ * Merge repeated entries of a flat list of fixed size records, summing their counts.
+ * The last int of each record is the count; the ones before it are the key.
+ * @param entries the flat list, which is replaced by the merged list sorted on the key
+ * @param stride the number of ints in each record
+ * @param unique if true every count is set to one
+ */
+
+void collapse_counts(vector<int> & entries, int stride, bool unique) {
+  size_t n = entries.size() / stride;
+  int klen = stride - 1;
+
+  vector<size_t> order (n);
+  for (size_t i = 0; i < n; ++i) { order[i] = i * stride; }
+
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return std::lexicographical_compare(&entries[a], &entries[a] + klen, &entries[b], &entries[b] + klen);
+  });
+
+  vector<int> merged;
+  merged.reserve(entries.size());
+
+  for (size_t i : order) {
+    size_t last = merged.size();
+    if (last > 0 && std::equal(&entries[i], &entries[i] + klen, &merged[last - stride])) {
+      merged[last - 1] += entries[i + klen];
+    } else {
+      merged.insert(merged.end(), &entries[i], &entries[i] + stride);
+    }
+  }
+
+  if (unique) {
+    for (size_t i = klen; i < merged.size(); i += stride) { merged[i] = 1; }
+  }
+
+  entries.swap(merged);
+}
+
+/**
+ * Fold the repeats from the last file into counts so the lists never hold more than one entry per word
+ * @param VERB_SBJ_OBJ a vector of vectors of (subject, object, count) triples
+ * @param VERB_SUBJECTS a vector of vectors of (subject, count) pairs
+ * @param VERB_OBJECTS a vector of vectors of (object, count) pairs
  * @param UNIQUE_OBJECTS do we count only one instance of an object
- * @param LEMMA_TIME are we using the lemmatized version of the words
+ * @param UNIQUE_SUBJECTS do we count only one instance of an subject
  */
 
-void create_verb_objects(string str_buffer, vector<int> & verb_obj_pairs,
-    map<string,int> & DICTIONARY_FAST,
+static void collapse_verb_lists(vector< vector<int> > & VERB_SBJ_OBJ,
+    vector< vector<int> > & VERB_SUBJECTS,
     vector< vector<int> > & VERB_OBJECTS,
     bool UNIQUE_OBJECTS,
-    bool LEMMA_TIME ) {
+    bool UNIQUE_SUBJECTS) {
 
-  vector<string> lines = s9::SplitStringNewline(str_buffer);
-  
-  for (int k = 0; k < lines.size(); ++k){
-    vector<string> tokens = s9::SplitStringWhitespace(lines[k]);  
-  
-    if (tokens.size() > 5) {  
-      // Find the Subjects
-      if (s9::StringContains(tokens[5],"OBJ") 
-           && ( s9::StringContains(tokens[2],"NN") || 
-              s9::StringContains(tokens[2],"JJ"))) {
-      //if (s9::StringContains(tokens[5],"SBJ")){
-        // Follow the chain to the root, stopping when we hit a verb
-       
-        int target = s9::FromString<int>(tokens[4]);
-        string sbj = s9::ToLower(tokens[0]);
-        // Not sure if we want lemma time here?
-        if (LEMMA_TIME){
-          sbj = s9::ToLower(tokens[1]);
+  #pragma omp parallel for schedule(dynamic, 64)
+  for (size_t v = 0; v < VERB_SBJ_OBJ.size(); ++v) {
+    collapse_counts(VERB_SUBJECTS[v], 2, UNIQUE_SUBJECTS);
+    collapse_counts(VERB_OBJECTS[v], 2, UNIQUE_OBJECTS);
+    collapse_counts(VERB_SBJ_OBJ[v], 3, UNIQUE_SUBJECTS || UNIQUE_OBJECTS);
+  }
+}
+
+/**
+ * Find the verbs that the subjects or objects in one sentence of a converted file hang off.
+ * We walk up the heads from each noun or adjective with the relation until we hit a verb.
+ * @param corpus an open Corpus
+ * @param start the first token of the sentence
+ * @param end one past the last token of the sentence
+ * @param col the word or lemma column
+ * @param lookup the dictionary index of each string, -1 if it isn't in the dictionary
+ * @param relation which deprel strings we are following
+ * @param noun which pos strings count as nouns
+ * @param verb which pos strings count as verbs
+ * @param heads the ids of the sentence, indexed
+ * @param pairs we add verb,id,word for each one we find
+ */
+
+static void corpus_verb_pairs(const Corpus & corpus, uint64_t start, uint64_t end,
+    const int32_t * col,
+    const vector<int> & lookup,
+    const vector<char> & relation,
+    const vector<char> & noun,
+    const vector<char> & verb,
+    const HeadIndex & heads,
+    vector<int> & pairs) {
+
+  for (uint64_t k = start; k < end; ++k) {
+    if (!relation[corpus.deprel[k]] || !noun[corpus.pos[k]]) { continue; }
+
+    int vidx = lookup[col[k]];
+    if (vidx < 0) { continue; }
+
+    // A badly parsed sentence can loop, so never take more steps than there are tokens
+    int target = corpus.head[k];
+    for (uint64_t steps = 0; target != 0 && steps < end - start; ++steps) {
+      int found = heads.find(target);
+      if (found == -1) { break; }
+      uint64_t tt = start + found;
+
+      target = corpus.head[tt];
+
+      if (verb[corpus.pos[tt]]) {
+        int widx = lookup[col[tt]];
+        if (widx >= 0) {
+          pairs.push_back(widx);
+          pairs.push_back(corpus.id[tt]);
+          pairs.push_back(vidx);
+          target = 0; // Just record the one direct verb
         }
-        
-        auto vidx = DICTIONARY_FAST.find(sbj); 
-                  
-        if (vidx != DICTIONARY_FAST.end()){
-          // Walk up the tree adding verbs till we get to root
-          while (target != 0){
-            // find the next line (we cant assume the indexing is perfect)
-            int tt = -1;
-            for (int j = 0; j < lines.size(); ++j){
-              vector<string> ttokens = s9::SplitStringWhitespace(lines[j]);
-              if (ttokens.size() > 5){
-                if (s9::FromString<int>(ttokens[3]) == target){
-                  tt = j;
-                  break;
-                }
-              }
-            }
-            
-            if (tt == -1){
-              break;
-            }
-
-            vector<string> tokens2 = s9::SplitStringWhitespace(lines[tt]); 
-            
-            if (tokens2.size() > 5) {
-              target = s9::FromString<int>(tokens2[4]);
-              
-              if (s9::StringContains(tokens2[2],"VV")){
-                // Do we use the actual root verb or the conjugated
-                string verb = s9::ToLower(tokens2[0]);
-                
-                if (LEMMA_TIME){
-                  verb = s9::ToLower(tokens2[1]);
-                }
-
-                auto widx = DICTIONARY_FAST.find(verb);
-                
-                if (widx != DICTIONARY_FAST.end()){  
-                  // We choose between unique or otherwise
-                  if (UNIQUE_OBJECTS){
-                    if (std::find(VERB_OBJECTS[widx->second].begin(), VERB_OBJECTS[widx->second].end(), vidx->second) == VERB_OBJECTS[widx->second].end()) {
-                      #pragma omp critical
-                      {
-                        VERB_OBJECTS[widx->second].push_back(vidx->second);
-                        verb_obj_pairs.push_back(widx->second);
-                        verb_obj_pairs.push_back(s9::FromString<int>(tokens2[3]));
-                        verb_obj_pairs.push_back(vidx->second);
-                      }
-                    }
-                  } else {
-                    #pragma omp critical
-                    {
-                      VERB_OBJECTS[widx->second].push_back(vidx->second);
-                      verb_obj_pairs.push_back(widx->second);
-                      verb_obj_pairs.push_back(s9::FromString<int>(tokens2[3]));
-                      verb_obj_pairs.push_back(vidx->second);
-
-                    }
-                  }
-                  target = 0; // Just record the one direct verb 
-                }
-              }
-            } else {
-              // We got a duff line so quit
-              break;
-            }
-          }
-        } 
       }
     }
   }
 }
 
 /**
- * Create a list of verb subjects
- * @param str_buffer the sentence we are looking at from ukwac
- * @param verb_sbj_pairs a list of verb object pairs
+ * Pull the verb subjects and objects out of every sentence we are handed
  * @param DICTIONARY_FAST the fast dictionary
- * @param VERB_SUBJECTS the vector we will create
+ * @param VERB_SBJ_OBJ a vector of vectors of (subject, object, count) triples
+ * @param VERB_SUBJECTS a vector of vectors of (subject, count) pairs
+ * @param VERB_OBJECTS a vector of vectors of (object, count) pairs
  * @param UNIQUE_OBJECTS do we count only one instance of an object
+ * @param UNIQUE_SUBJECTS do we count only one instance of an subject
  * @param LEMMA_TIME are we using the lemmatized version of the words
  */
 
-void create_verb_subjects(string str_buffer, vector<int> & verb_sbj_pairs,
-    map<string,int> & DICTIONARY_FAST,
+DependencyExtractor::DependencyExtractor(Dictionary & DICTIONARY_FAST,
+    vector< vector<int> > & VERB_SBJ_OBJ,
     vector< vector<int> > & VERB_SUBJECTS,
+    vector< vector<int> > & VERB_OBJECTS,
+    bool UNIQUE_OBJECTS,
     bool UNIQUE_SUBJECTS,
-    bool LEMMA_TIME ) {
+    bool LEMMA_TIME) :
+  dictionary_(DICTIONARY_FAST), sbj_obj_(VERB_SBJ_OBJ), subjects_(VERB_SUBJECTS),
+  objects_(VERB_OBJECTS), unique_objects_(UNIQUE_OBJECTS), unique_subjects_(UNIQUE_SUBJECTS),
+  lemma_time_(LEMMA_TIME), col_(NULL) {}
+
+int DependencyExtractor::begin_file(const Corpus & corpus, const string & name) {
+  col_ = lemma_time_ ? corpus.lemma : corpus.word;
+  lookup_ = corpus_dictionary_lookup(corpus, dictionary_, -1);
+  sbj_ = corpus_contains(corpus, "SBJ");
+  obj_ = corpus_contains(corpus, "OBJ");
+  noun_ = corpus_contains(corpus, "NN");
+  verb_ = corpus_contains(corpus, "VV");
+  vector<char> adj = corpus_contains(corpus, "JJ");
+  for (size_t i = 0; i < noun_.size(); ++i) { noun_[i] |= adj[i]; }
+
+  heads_.resize(omp_get_max_threads());
+  sbj_pairs_.resize(omp_get_max_threads());
+  obj_pairs_.resize(omp_get_max_threads());
+  return 0;
+}
 
-  vector<string> lines = s9::SplitStringNewline(str_buffer);
-  
-  for (int k = 0; k < lines.size(); ++k){
-    vector<string> tokens = s9::SplitStringWhitespace(lines[k]);  
-  
-    if (tokens.size() > 5) {  
-      // Find the Subjects
-      if (s9::StringContains(tokens[5],"SBJ")  && (
-            s9::StringContains(tokens[2],"NN") || 
-            s9::StringContains(tokens[2],"JJ"))){
-      //if (s9::StringContains(tokens[5],"SBJ")){
-        // Follow the chain to the root, stopping when we hit a verb
-       
-        int target = s9::FromString<int>(tokens[4]);
-        string sbj = s9::ToLower(tokens[0]);
-        // Not sure if we want lemma time here?
-        if (LEMMA_TIME){
-          sbj = s9::ToLower(tokens[1]);
+void DependencyExtractor::sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) {
+  vector<int> & verb_sbj_pairs = sbj_pairs_[thread];
+  vector<int> & verb_obj_pairs = obj_pairs_[thread];
+  verb_sbj_pairs.clear();
+  verb_obj_pairs.clear();
+
+  HeadIndex & heads = heads_[thread];
+  heads.build(corpus.id + start, end - start);
+
+  corpus_verb_pairs(corpus, start, end, col_, lookup_, sbj_, noun_, verb_, heads, verb_sbj_pairs);
+  corpus_verb_pairs(corpus, start, end, col_, lookup_, obj_, noun_, verb_, heads, verb_obj_pairs);
+
+  if (verb_sbj_pairs.empty() && verb_obj_pairs.empty()) { return; }
+
+  #pragma omp critical
+  {
+    for (size_t k = 0; k < verb_sbj_pairs.size(); k+=3) {
+      subjects_[verb_sbj_pairs[k]].push_back(verb_sbj_pairs[k+2]);
+      subjects_[verb_sbj_pairs[k]].push_back(1);
+    }
+
+    for (size_t j = 0; j < verb_obj_pairs.size(); j+=3) {
+      objects_[verb_obj_pairs[j]].push_back(verb_obj_pairs[j+2]);
+      objects_[verb_obj_pairs[j]].push_back(1);
+    }
+
+    for (size_t j = 0; j < verb_obj_pairs.size(); j+=3) {
+      for (size_t k = 0; k < verb_sbj_pairs.size(); k+=3) {
+        if (verb_obj_pairs[j+1] == verb_sbj_pairs[k+1]) {
+          sbj_obj_[verb_obj_pairs[j]].push_back(verb_sbj_pairs[k+2]);
+          sbj_obj_[verb_obj_pairs[j]].push_back(verb_obj_pairs[j+2]);
+          sbj_obj_[verb_obj_pairs[j]].push_back(1);
         }
-        
-        auto vidx = DICTIONARY_FAST.find(sbj); 
-                  
-        if (vidx != DICTIONARY_FAST.end()){
-          // Walk up the tree adding verbs till we get to root
-          while (target != 0){
-            // find the next line (we cant assume the indexing is perfect)
-            int tt = -1;
-            for (int j = 0; j < lines.size(); ++j){
-              vector<string> ttokens = s9::SplitStringWhitespace(lines[j]);
-              if (ttokens.size() > 5){
-                if (s9::FromString<int>(ttokens[3]) == target){
-                  tt = j;
-                  break;
-                }
-              }
-            }
-            
-            if (tt == -1){
-              break;
-            }
-
-            vector<string> tokens2 = s9::SplitStringWhitespace(lines[tt]); 
-            
-            if (tokens2.size() > 5) {
-              target = s9::FromString<int>(tokens2[4]);
-              
-              if (s9::StringContains(tokens2[2],"VV")){
-                // Do we use the actual root verb or the conjugated
-                string verb = s9::ToLower(tokens2[0]);
-                
-                if (LEMMA_TIME){
-                  verb = s9::ToLower(tokens2[1]);
-                }
-
-                auto widx = DICTIONARY_FAST.find(verb);
-              
-                   
-                if (widx != DICTIONARY_FAST.end()){  
-                  // We choose between unique or otherwise
-                  if (UNIQUE_SUBJECTS){
-                    if (std::find(VERB_SUBJECTS[widx->second].begin(), VERB_SUBJECTS[widx->second].end(), vidx->second) == VERB_SUBJECTS[widx->second].end()) {
-                      #pragma omp critical
-                      {
-                
-                        VERB_SUBJECTS[widx->second].push_back(vidx->second);
-                        verb_sbj_pairs.push_back(widx->second);
-                        verb_sbj_pairs.push_back(s9::FromString<int>(tokens2[3]));
-                        verb_sbj_pairs.push_back(vidx->second);                        
-                      }
-                    }
-                  } else {
-                    #pragma omp critical
-                    {
-                      VERB_SUBJECTS[widx->second].push_back(vidx->second);
-                      verb_sbj_pairs.push_back(widx->second);
-                      verb_sbj_pairs.push_back(s9::FromString<int>(tokens2[3]));
-                      verb_sbj_pairs.push_back(vidx->second);
-
-                    }
-                  }
-                  target = 0; // Just record the one direct verb 
-                }
-              }
-            } else {
-              // We got a duff line so quit
-              break;
-            }
-          }
-        } 
       }
     }
   }
 }
 
+int DependencyExtractor::end_file(const Corpus & corpus) {
+  collapse_verb_lists(sbj_obj_, subjects_, objects_, unique_objects_, unique_subjects_);
+  return 0;
+}
+
+/**
+ * Write one of our verb lists as lines of numbers, after a VERB_LIST_HEADER line. The
+ * first number is the verb, after which come the entries for that verb.
+ * @param filename the file to write
+ * @param VERB_LIST a vector of vectors of entries for each verb
+ * @param stride how many numbers make up one entry
+ * @return int a value to say if we succeeded or not
+ */
+
+static int write_verb_list(string filename, const vector< vector<int> > & VERB_LIST, int stride) {
+  TextFile list_file;
+  if (!list_file.open(filename)) {
+    cout << "Unable to open " << filename << " for writing" << endl;
+    return 1;
+  }
+
+  list_file << VERB_LIST_HEADER << ' ' << stride << '\n';
+
+  int idv = 0;
+  for (const vector<int> & verbs : VERB_LIST){
+    if (verbs.size() > 0 ){
+      list_file << idv << ' ';
+      for (int sb : verbs){
+        list_file << sb << ' ';
+      }
+      list_file << '\n';
+    }
+    idv++;
+  }
+
+  list_file.close();
+  return 0;
+}
+
+/**
+ * Write out verb_subjects.txt, verb_objects.txt and verb_sbj_obj.txt
+ * @param OUTPUT_DIR the output directory
+ * @param VERB_SBJ_OBJ a vector of vectors of (subject, object, count) triples
+ * @param VERB_SUBJECTS a vector of vectors of (subject, count) pairs
+ * @param VERB_OBJECTS a vector of vectors of (object, count) pairs
+ * @return int a value to say if we succeeded or not
+ */
+
+int write_verb_subject_object(string OUTPUT_DIR,
+    const vector< vector<int> > & VERB_SBJ_OBJ,
+    const vector< vector<int> > & VERB_SUBJECTS,
+    const vector< vector<int> > & VERB_OBJECTS) {
+
+  if (write_verb_list(OUTPUT_DIR + "/verb_subjects.txt", VERB_SUBJECTS, 2) != 0) { return 1; }
+  if (write_verb_list(OUTPUT_DIR + "/verb_objects.txt", VERB_OBJECTS, 2) != 0) { return 1; }
+  return write_verb_list(OUTPUT_DIR + "/verb_sbj_obj.txt", VERB_SBJ_OBJ, 3);
+}
 
 /**
  * Create a list of verb objects
  * @param str_buffer the sentence we are looking at from ukwac
  * @param verb_obj_pairs a list of verb object pairs
  * @param DICTIONARY_FAST the fast dictionary
- * @param VERB_SBJ_OBJ a vector of vectors of word pairs
- * @param VERB_OBJECTS the vector we will create
- * @param VERB_SUBJECTS the vector we will create
+ * @param VERB_SBJ_OBJ a vector of vectors of (subject, object, count) triples
+ * @param VERB_OBJECTS the vector we will create, as (object, count) pairs
+ * @param VERB_SUBJECTS the vector we will create, as (subject, count) pairs
  * @param UNIQUE_OBJECTS do we count only one instance of an object
  * @param UNIQUE_SUBJECTS do we count only one instance of an subject
  * @param LEMMA_TIME are we using the lemmatized version of the words
@@ -247,7 +275,7 @@ void create_verb_subjects(string str_buffer, vector<int> & verb_sbj_pairs,
 
 int create_verb_subject_object(vector<string> filenames,
     string OUTPUT_DIR, 
-    map<string,int> & DICTIONARY_FAST,
+    Dictionary & DICTIONARY_FAST,
     vector< vector<int> > & VERB_SBJ_OBJ,
     vector< vector<int> > & VERB_SUBJECTS,
     vector< vector<int> > & VERB_OBJECTS,
@@ -257,169 +285,147 @@ int create_verb_subject_object(vector<string> filenames,
 
   cout << "Creating Verb Subject" << endl;
 
-  size_t unk_count = 0;
-  size_t total_count = 0;
+  DependencyExtractor extractor (DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, UNIQUE_OBJECTS, UNIQUE_SUBJECTS, LEMMA_TIME);
+  vector<SentenceConsumer*> consumers {&extractor};
+  if (corpus_scan(filenames, consumers) != 0) { return 1; }
 
-  // Scan directory for the files
-  for( string filepath : filenames) {
-    int num_blocks = 1;  
-    char ** block_pointer;
-    size_t * block_size;
+  cout << endl;
 
-    // Cant pass this into _breakup sadly
-    file_mapping m_file(filepath.c_str(), read_only);
-    mapped_region region(m_file, read_only);  
+  // Write out the lists as lines of numbers, each starting with the verb
+  return write_verb_subject_object(OUTPUT_DIR, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS);
+}
 
-    int result = breakup(block_pointer, block_size, m_file, region, num_blocks );
-    if (result == -1){
-      return -1;
-    }  
- 
-    // Progress basically
-    size_t progress = 0;
-
-    omp_set_num_threads(num_blocks);
-    #pragma omp parallel
-    {   
-      int block_id = omp_get_thread_num();
-      char *mem = block_pointer[block_id];
-      size_t file_count = 0;
-      std::string str_buffer;
-      std::string ssmt = "0000";
-
-      //string filename = "subjects_" + s9::FilenameFromPath(filepath) + "_" + s9::ToString(block_id) + ".txt";
-      //std::ofstream sub_file (filename);
-      //if (!sub_file.is_open()) {
-      //  cout << "ERROR: Unable to up " << filename << " for writing." << endl;
-      //}
-
-      for(std::size_t i = 0; i < block_size[block_id]; ++i){
-        char data = *mem;
-        if (ssmt.compare("</s>") != 0){
-          str_buffer += data;
-          
-          ssmt[0] = ssmt[1];
-          ssmt[1] = ssmt[2];
-          ssmt[2] = ssmt[3];
-          ssmt[3] = data;
-          
-        } else {       
-          // Can now look at the sentence, derive its structure and find the bits we need
-          ssmt = "0000";
-
-          vector<int> verb_obj_pairs;
-          vector<int> verb_sbj_pairs;
-
-          create_verb_subjects(str_buffer, verb_sbj_pairs, DICTIONARY_FAST, VERB_SUBJECTS, UNIQUE_SUBJECTS, LEMMA_TIME);
-          create_verb_objects(str_buffer, verb_obj_pairs, DICTIONARY_FAST, VERB_OBJECTS, UNIQUE_OBJECTS,LEMMA_TIME );
-     
-          // We now need to match the objects and subjects to the same verb if it appears
-          // Each vector has verb,id,word, verb,id,word... indices into the dictionary
-
-          for (std::size_t j = 0; j < verb_obj_pairs.size(); j+=3){
-            for (std::size_t k = 0; k < verb_sbj_pairs.size(); k+=3){
-              if (verb_obj_pairs[j+1] == verb_sbj_pairs[k+1]){
-                #pragma omp critical
-                {
-                  VERB_SBJ_OBJ[verb_obj_pairs[j]].push_back(verb_sbj_pairs[k+2]);
-                  VERB_SBJ_OBJ[verb_obj_pairs[j]].push_back(verb_obj_pairs[j+2]);
-                }
-              }
-            }  
-          } 
-          str_buffer = "";
-        }
-    
-        mem++;
-        progress +=1;
-      }
-    }
-    
-    // These need to be freed as breakup assigns them. A bit naughty
-    //free(block_pointer);
-    //free(block_size);
+/**
+ * Count the simverbs in every sentence we are handed. This follows create_simverbs,
+ * checking whether each verb in a sentence has an object hanging directly off it.
+ * @param SIMVERBS the verbs we are counting
+ * @param SIMVERBS_COUNT the number of times this verb appears
+ * @param SIMVERBS_OBJECTS how many times the verb appears with an object
+ * @param SIMVERBS_ALONE how many times the verb appears without an object
+ * @param LEMMA_TIME are we using the lemmatized version of the words
+ */
+
+SimverbCounter::SimverbCounter(vector<string> & SIMVERBS,
+    vector<int> & SIMVERBS_COUNT,
+    vector<int> & SIMVERBS_OBJECTS,
+    vector<int> & SIMVERBS_ALONE,
+    bool LEMMA_TIME) :
+  simverbs_(SIMVERBS), count_(SIMVERBS_COUNT), objects_(SIMVERBS_OBJECTS),
+  alone_(SIMVERBS_ALONE), lemma_time_(LEMMA_TIME), col_(NULL) {}
+
+int SimverbCounter::begin_file(const Corpus & corpus, const string & name) {
+  col_ = lemma_time_ ? corpus.lemma : corpus.word;
+  verb_ = corpus_contains(corpus, "VV");
+  obj_ = corpus_contains(corpus, "OBJ");
+
+  // Which simverb each string is, or -1
+  map<string,int> sim_idx;
+  for (int i = 0; i < simverbs_.size(); ++i) {
+    sim_idx.insert(make_pair(simverbs_[i], i));
   }
 
-  cout << endl;
+  sim_.assign(corpus.header->num_strings, -1);
+  for (size_t i = 0; i < sim_.size(); ++i) {
+    auto it = sim_idx.find(s9::ToLower(corpus_string(corpus, i)));
+    if (it != sim_idx.end()) { sim_[i] = it->second; }
+  }
 
-  // Write out the subject file as lines of numbers.
-  // First number is the verb. All following numbers are the subjects
-  string filename = OUTPUT_DIR + "/verb_subjects.txt";
-  std::ofstream sub_file (filename);
-  int idv = 0;
+  threads_.clear();
+  threads_.resize(omp_get_max_threads());
+  for (ThreadCounts & tc : threads_) {
+    tc.count.assign(simverbs_.size(), 0);
+    tc.objects.assign(simverbs_.size(), 0);
+    tc.alone.assign(simverbs_.size(), 0);
+  }
+  return 0;
+}
 
-  for (vector<int> verbs : VERB_SUBJECTS){
-    if (verbs.size() > 0 ){
-      sub_file << s9::ToString(idv) << " ";
-      for (int sb : verbs){
-        sub_file << s9::ToString(sb) << " ";
+void SimverbCounter::sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) {
+  ThreadCounts & tc = threads_[thread];
+  tc.sim_indices.clear();
+  tc.verb_hit.clear();
+  tc.object_indices.clear();
+
+  // First find all the verbs in the sentence
+  for (uint64_t k = start; k < end; ++k) {
+    if (verb_[corpus.pos[k]]) {
+      if (sim_[col_[k]] >= 0) {
+        tc.sim_indices.push_back(sim_[col_[k]]);
+        tc.verb_hit.push_back(0);
       }
-      sub_file << endl;
+    } else if (obj_[corpus.deprel[k]]) {
+      tc.object_indices.push_back(k);
     }
-    idv++;
   }
-  
-  sub_file.close();
 
-  filename = OUTPUT_DIR + "/verb_objects.txt";
-  std::ofstream obj_file (filename);
-  idv = 0;
-  for (vector<int> verbs : VERB_OBJECTS){
-    if (verbs.size() > 0 ){
-      obj_file << s9::ToString(idv) << " ";
-      for (int sb : verbs){
-        obj_file << s9::ToString(sb) << " ";
+  // Now trace each object back to the verb it belongs to
+  if (!tc.object_indices.empty()) {
+    tc.heads.build(corpus.id + start, end - start);
+  }
+
+  for (uint64_t k : tc.object_indices) {
+    int target = corpus.head[k];
+    if (target <= 0) { continue; }
+
+    int found = -1;
+    if (tc.heads.unique()) {
+      found = tc.heads.find(target);
+      if (found != -1 && !verb_[corpus.pos[start + found]]) { found = -1; }
+    } else {
+      // Repeated ids, so look for the first verb carrying this one
+      for (uint64_t j = start; j < end; ++j) {
+        if (corpus.id[j] == target && verb_[corpus.pos[j]]) {
+          found = j - start;
+          break;
+        }
       }
-      obj_file << endl;
     }
-    idv++;
-  }
-  
-  obj_file.close();
 
-  // Finally, write out the verb subject object pairings
-  filename = OUTPUT_DIR + "/verb_sbj_obj.txt";
-  std::ofstream obj_sbj_file (filename);
-  idv = 0;
-  for (vector<int> verbs : VERB_SBJ_OBJ){
-    if (verbs.size() > 0 ){
-      obj_sbj_file << s9::ToString(idv) << " ";
-      for (int sb : verbs){
-        obj_sbj_file << s9::ToString(sb) << " ";
+    if (found != -1) {
+      uint64_t j = start + found;
+      for (int iv = 0; iv < tc.sim_indices.size(); ++iv) {
+        if (tc.sim_indices[iv] == sim_[col_[j]]) { tc.verb_hit[iv] = 1; }
       }
-      obj_sbj_file << endl;
     }
-    idv++;
   }
-  
-  obj_sbj_file.close();
 
+  for (int iv = 0; iv < tc.sim_indices.size(); ++iv) {
+    int ss = tc.sim_indices[iv];
+    if (tc.verb_hit[iv]) {
+      tc.objects[ss] += 1;
+    } else {
+      tc.alone[ss] += 1;
+    }
+    tc.count[ss] += 1;
+  }
+}
+
+int SimverbCounter::end_file(const Corpus & corpus) {
+  for (const ThreadCounts & tc : threads_) {
+    for (int i = 0; i < simverbs_.size(); ++i) {
+      count_[i] += tc.count[i];
+      objects_[i] += tc.objects[i];
+      alone_[i] += tc.alone[i];
+    }
+  }
   return 0;
 }
 
 /**
- * Create a list of verb objects
- * @param filenames  the list of ukwac files
+ * Read the verbs we want to count from the simverb file and zero their counts
  * @param simverb_path the path to the simverbs file
  * @param SIMVERBS our vector of verbs we shall create
  * @param SIMVERBS_COUNT the number of times this verb appears
- * @param SIMVERBS_OBJECTS verbs that have more objects and subjects than just subjects
- * @param SIMVERBS_SUBJECTS verbs that have more subjects than both subjects and objects
- * @param LEMMA_TIME are we using the lemmatized version of the words
+ * @param SIMVERBS_OBJECTS how many times the verb appears with an object
+ * @param SIMVERBS_ALONE how many times the verb appears without an object
+ * @return int a value to say if we succeeded or not
  */
 
-int create_simverbs(vector<string> filenames, string simverb_path,
-    string OUTPUT_DIR,
+int setup_simverbs(string simverb_path,
     vector<string> & SIMVERBS,
     vector<int> & SIMVERBS_COUNT,
     vector<int> & SIMVERBS_OBJECTS,
-    vector<int> & SIMVERBS_ALONE,
-    bool LEMMA_TIME ) {
-
-  size_t unk_count = 0;
-  size_t total_count = 0;
-
-  // Setup the basics from the simverb file
+    vector<int> & SIMVERBS_ALONE) {
 
   std::ifstream simverb_file(simverb_path);
   string line;
@@ -453,173 +459,69 @@ int create_simverbs(vector<string> filenames, string simverb_path,
   }
 
   cout << "simverbs size : " << SIMVERBS.size() << endl;
+  return 0;
+}
 
-  // Scan directory for the files
-  for( string filepath : filenames) {
-    int num_blocks =1; 
-       
-    char ** block_pointer;
-    size_t * block_size;
-
-    // Cant pass this into _breakup sadly
-    file_mapping m_file(filepath.c_str(), read_only);
-    mapped_region region(m_file, read_only);  
-
-    int result = breakup(block_pointer, block_size, m_file, region, num_blocks );
-    if (result == -1){
-      return -1;
-    }  
-
-    // Now do the search
-    omp_set_num_threads(num_blocks); 
-    #pragma omp parallel
-    {   
-      int block_id = omp_get_thread_num();
-      char *mem = block_pointer[block_id];
-      size_t file_count = 0;
-      std::string str_buffer;
-      std::string ssmt = "0000";
-
-      for(std::size_t i = 0; i < block_size[block_id]; ++i){
-        char data = *mem;
-        if (ssmt.compare("</s>") != 0){
-          str_buffer += data;
-          
-          ssmt[0] = ssmt[1];
-          ssmt[1] = ssmt[2];
-          ssmt[2] = ssmt[3];
-          ssmt[3] = data;
-          
-        } else {       
-          // Can now look at the sentence, derive its structure and find the bits we need
-          ssmt = "0000";
-          vector<string> lines = s9::SplitStringNewline(str_buffer);
-        
-          vector<bool> verb_hit;
-          vector<string> verbs;
-          vector<int> sim_indices;
-          vector<int> object_indices;
-
-          for (int k = 0; k < lines.size(); ++k){
-
-            // First find all the verbs in the sentence
-            vector<string> tokens = s9::SplitStringWhitespace(lines[k]);  
-            if (tokens.size() > 5) {
-    
-              if (s9::StringContains(tokens[2],"VV")){
-                // Do we use the actual root verb or the conjugated
-                string verb = s9::ToLower(tokens[0]);
-                if (LEMMA_TIME){
-                  verb = s9::ToLower(tokens[1]);
-                }
-
-                // Find the index of our verb
-                int isw = 0;
-                for (isw = 0; isw < SIMVERBS.size(); ++isw) {
-                  if (SIMVERBS[isw].compare(verb) == 0){
-                    verbs.push_back(verb);
-                    verb_hit.push_back(false);
-                    sim_indices.push_back(isw);
-                  }
-                }
-      
-              } else if (s9::StringContains(tokens[5],"OBJ")){
-                object_indices.push_back(k);
-              }
-            }
-          }
-
-          // Now we have all the objects and verbs collected. Trace the objects backward
-
-          for (int k : object_indices){
-            vector<string> tokens = s9::SplitStringWhitespace(lines[k]);
-            int target = s9::FromString<int>(tokens[4]);
-            int start = target;
-
-            while (target > 0){ 
-              // find the next line (we cant assume the indexing is perfect)
-              for (int j = 0; j < lines.size(); ++j) {
-                vector<string> target_tokens = s9::SplitStringWhitespace(lines[j]);
-                
-                if (target_tokens.size() > 5) {
-                  int st = s9::FromString<int>(target_tokens[3]); 
-                  
-                  if (st == target){
-                    target = st;
-                    
-                    if (target_tokens.size() > 5) {
-                    
-                      if (s9::StringContains(target_tokens[2],"VV")){
-                        string verb = s9::ToLower(target_tokens[0]);
-                      
-                        if (LEMMA_TIME){
-                          verb = s9::ToLower(target_tokens[1]);
-                        }
-                        
-                        for (int iv=0; iv < verbs.size(); ++iv){
-                          if (verbs[iv].compare(verb) == 0){
-                            verb_hit[iv] = true;
-                          }
-                        }
-                        // Stop here, we've found the direct verb
-                        target = 0;
-                        break;
-                      }             
-                    }
-                  }
-                }
-              }
-
-              if (target == start){
-                target = 0;
-                break;
-              } 
-            }
-          }
-
-          str_buffer = "";
-
-          // should be done with our sentence now so do some counting
-          // TODO - as these are just increments we could go a little better with OpenMP
-          for (int iv=0; iv < verbs.size(); ++iv){
-            int ss = sim_indices[iv];
-            if (verb_hit[iv]){
-              #pragma omp critical
-              SIMVERBS_OBJECTS[ss] +=1;               
-            } else {
-              #pragma omp critical
-              SIMVERBS_ALONE[ss] +=1;
-            }
-            #pragma omp critical
-            SIMVERBS_COUNT[ss] +=1;
-          }
-        }
-        mem++;
-      }
-    }
-
-    // These need to be freed as breakup assigns them. A bit naughty
-    //free(block_pointer);
-    //free(block_size);
+/**
+ * Write the simverb counts out to sim_stats.txt
+ * @param OUTPUT_DIR the output directory
+ * @param SIMVERBS the verbs we counted
+ * @param SIMVERBS_COUNT the number of times this verb appears
+ * @param SIMVERBS_OBJECTS how many times the verb appears with an object
+ * @param SIMVERBS_ALONE how many times the verb appears without an object
+ * @return int a value to say if we succeeded or not
+ */
 
-  }
+int write_simverbs(string OUTPUT_DIR,
+    vector<string> & SIMVERBS,
+    vector<int> & SIMVERBS_COUNT,
+    vector<int> & SIMVERBS_OBJECTS,
+    vector<int> & SIMVERBS_ALONE) {
 
   string filename = OUTPUT_DIR + "/sim_stats.txt";
-  std::ofstream sim_file (filename);
+  TextFile sim_file;
  
-  if (!sim_file.is_open()) {
+  if (!sim_file.open(filename)) {
     return 1;
   }
 
   int idv = 0;
   for (string verb : SIMVERBS){
-    sim_file << verb << " " << SIMVERBS_OBJECTS[idv] << " " << SIMVERBS_ALONE[idv] << " " << SIMVERBS_COUNT[idv] << endl;
+    sim_file << verb << ' ' << SIMVERBS_OBJECTS[idv] << ' ' << SIMVERBS_ALONE[idv] << ' ' << SIMVERBS_COUNT[idv] << '\n';
     idv++;
   }
   
   sim_file.close();
- 
   return 0;
 }
 
+/**
+ * Create a list of verb objects
+ * @param filenames  the list of ukwac files
+ * @param simverb_path the path to the simverbs file
+ * @param SIMVERBS our vector of verbs we shall create
+ * @param SIMVERBS_COUNT the number of times this verb appears
+ * @param SIMVERBS_OBJECTS verbs that have more objects and subjects than just subjects
+ * @param SIMVERBS_SUBJECTS verbs that have more subjects than both subjects and objects
+ * @param LEMMA_TIME are we using the lemmatized version of the words
+ */
+
+int create_simverbs(vector<string> filenames, string simverb_path,
+    string OUTPUT_DIR,
+    vector<string> & SIMVERBS,
+    vector<int> & SIMVERBS_COUNT,
+    vector<int> & SIMVERBS_OBJECTS,
+    vector<int> & SIMVERBS_ALONE,
+    bool LEMMA_TIME ) {
+
+  // Setup the basics from the simverb file
+  if (setup_simverbs(simverb_path, SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE) != 0) {
+    return 1;
+  }
 
+  SimverbCounter counter (SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE, LEMMA_TIME);
+  vector<SentenceConsumer*> consumers {&counter};
+  if (corpus_scan(filenames, consumers) != 0) { return 1; }
+
+  return write_simverbs(OUTPUT_DIR, SIMVERBS, SIMVERBS_COUNT, SIMVERBS_OBJECTS, SIMVERBS_ALONE);
+}
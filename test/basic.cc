@@ -4,6 +4,7 @@
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE wacky basic test suite
 #include <boost/test/included/unit_test.hpp>
+#include <boost/filesystem.hpp>
 
 
 #include <iostream>
@@ -15,6 +16,7 @@
 #include <dirent.h>
 #include <omp.h>
 #include <deque>
+#include <cmath>
 
 
 #include "string_utils.hpp"
@@ -23,6 +25,7 @@
 #include "wacky_create.hpp"
 #include "wacky_read.hpp"
 #include "wacky_verb.hpp"
+#include "wacky_synth.hpp"
 
 using namespace std;
 
@@ -34,7 +37,7 @@ BOOST_AUTO_TEST_CASE(dictionary_freq_create_test) {
   map<string, size_t> FREQ {};
   vector< pair<string,size_t> > FREQ_FLIPPED {};
   set<string> WORD_IGNORES {",","-",".","@card@", "<text","<s>xt","</s>SENT", "<s>>SENT", "<s>", "</s>", "<text>", "</text>"};
-  map<string,int> DICTIONARY_FAST {};
+  Dictionary DICTIONARY_FAST;
   vector<string> DICTIONARY {};
   set<string> ALLOWED_BASIS_WORDS;
   size_t VOCAB_SIZE = 5000;
@@ -97,7 +100,7 @@ BOOST_AUTO_TEST_CASE(dictionary_freq_read_test) {
   map<string, size_t> FREQ {};
   vector< pair<string,size_t> > FREQ_FLIPPED {};
   set<string> WORD_IGNORES {",","-",".","@card@", "<text","<s>xt","</s>SENT", "<s>>SENT", "<s>", "</s>", "<text>", "</text>"};
-  map<string,int> DICTIONARY_FAST {};
+  Dictionary DICTIONARY_FAST;
   vector<string> DICTIONARY {};
   set<string> ALLOWED_BASIS_WORDS;
   set<string> INSIST_BASIS_WORDS;
@@ -126,3 +129,722 @@ BOOST_AUTO_TEST_CASE(dictionary_freq_read_test) {
   BOOST_CHECK_EQUAL(BASIS_VECTOR.size(), 250);
   
 }
+
+
+// With a small vocab the dictionary only orders the top words, but the basis should still
+// reach past them and come out the same as from the full frequency list
+BOOST_AUTO_TEST_CASE(small_vocab_basis_test) {
+
+  map<string, size_t> FREQ {};
+  vector< pair<string,size_t> > FULL_FLIPPED {};
+  set<string> ALLOWED_BASIS_WORDS;
+  set<string> INSIST_BASIS_WORDS;
+
+  BOOST_CHECK_EQUAL(read_freq("./output", FREQ, FULL_FLIPPED, ALLOWED_BASIS_WORDS), 0);
+
+  string small_dir = "./output/small_vocab";
+  boost::filesystem::create_directories(small_dir);
+
+  vector< pair<string,size_t> > FREQ_FLIPPED {};
+  Dictionary DICTIONARY_FAST;
+  vector<string> DICTIONARY {};
+  size_t VOCAB_SIZE = 300;
+  BOOST_CHECK_EQUAL(create_dictionary(small_dir, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, VOCAB_SIZE), 0);
+  BOOST_CHECK_EQUAL(FREQ_FLIPPED.size(), 300);
+
+  vector<int> BASIS_VECTOR;
+  create_basis(small_dir, FREQ, FREQ_FLIPPED, DICTIONARY_FAST, BASIS_VECTOR, ALLOWED_BASIS_WORDS, INSIST_BASIS_WORDS, 250, 20);
+  BOOST_CHECK_EQUAL(BASIS_VECTOR.size(), 250);
+
+  vector<int> FULL_BASIS;
+  create_basis(small_dir, FREQ, FULL_FLIPPED, DICTIONARY_FAST, FULL_BASIS, ALLOWED_BASIS_WORDS, INSIST_BASIS_WORDS, 250, 20);
+  BOOST_CHECK(BASIS_VECTOR == FULL_BASIS);
+}
+
+// The binary corpus should give exactly the same frequencies as the text it came from
+BOOST_AUTO_TEST_CASE(corpus_freq_test) {
+
+  map<string, size_t> FREQ {};
+  map<string, size_t> CORPUS_FREQ {};
+  vector< pair<string,size_t> > FREQ_FLIPPED {};
+  set<string> WORD_IGNORES {",","-",".","@card@", "<text","<s>xt","</s>SENT", "<s>>SENT", "<s>", "</s>", "<text>", "</text>"};
+  set<string> ALLOWED_BASIS_WORDS;
+  vector<string> filenames;
+
+  DIR *dir;
+  struct dirent *ent;
+  dir = opendir ("./ukwac");
+
+  while ((ent = readdir (dir)) != NULL) {
+    if (strcmp(ent->d_name,".") == 0 || strcmp(ent->d_name,"..") == 0){
+      continue;
+    }
+    filenames.push_back("./ukwac/" + string(ent->d_name));
+  }
+
+  int r0 = create_corpus(filenames, "./output/corpus");
+  BOOST_CHECK_EQUAL(r0, 0);
+
+  vector<string> corpus_files = corpus_filenames("./output/corpus");
+  BOOST_CHECK_EQUAL(corpus_files.size(), filenames.size());
+
+  Corpus corpus;
+  int r1 = corpus_open(corpus, corpus_files[0]);
+  BOOST_CHECK_EQUAL(r1, 0);
+  BOOST_CHECK(corpus.header->num_sentences > 0);
+  BOOST_CHECK_EQUAL(corpus.sentences[corpus.header->num_sentences], corpus.header->num_tokens);
+
+  int r2 = create_freq(filenames, "./output/corpus", FREQ, FREQ_FLIPPED, WORD_IGNORES, ALLOWED_BASIS_WORDS, true);
+  int r3 = create_freq(corpus_files, "./output/corpus", CORPUS_FREQ, FREQ_FLIPPED, WORD_IGNORES, ALLOWED_BASIS_WORDS, true);
+  BOOST_CHECK_EQUAL(r2, 0);
+  BOOST_CHECK_EQUAL(r3, 0);
+
+  BOOST_CHECK(FREQ == CORPUS_FREQ);
+  BOOST_CHECK_EQUAL(CORPUS_FREQ["aloe"], 7);
+
+  size_t total_count;
+  read_total_file("./output/corpus", total_count);
+  BOOST_CHECK_EQUAL(total_count, 1993);
+}
+
+// A bounded count of the test corpus must keep the most frequent words, with their true counts
+// no more than freq_error.txt says below the ones we wrote out
+BOOST_AUTO_TEST_CASE(bounded_freq_test) {
+
+  map<string, size_t> FREQ {};
+  map<string, size_t> BOUNDED_FREQ {};
+  vector< pair<string,size_t> > FREQ_FLIPPED {};
+  set<string> WORD_IGNORES {",","-",".","@card@", "<text","<s>xt","</s>SENT", "<s>>SENT", "<s>", "</s>", "<text>", "</text>"};
+  set<string> ALLOWED_BASIS_WORDS;
+  vector<string> filenames;
+  string bounded_dir = "./output/bounded";
+  size_t capacity = 100;
+  size_t top = 20;
+
+  DIR *dir;
+  struct dirent *ent;
+  dir = opendir ("./ukwac");
+
+  while ((ent = readdir (dir)) != NULL) {
+    if (strcmp(ent->d_name,".") == 0 || strcmp(ent->d_name,"..") == 0){
+      continue;
+    }
+    filenames.push_back("./ukwac/" + string(ent->d_name));
+  }
+  closedir(dir);
+
+  boost::filesystem::create_directories(bounded_dir);
+  BOOST_REQUIRE_EQUAL(create_freq(filenames, bounded_dir, FREQ, FREQ_FLIPPED, WORD_IGNORES, ALLOWED_BASIS_WORDS, true), 0);
+  BOOST_REQUIRE(FREQ.size() > capacity);
+
+  ALLOWED_BASIS_WORDS.clear();
+  BOOST_REQUIRE_EQUAL(create_freq(filenames, bounded_dir, BOUNDED_FREQ, FREQ_FLIPPED, WORD_IGNORES, ALLOWED_BASIS_WORDS, true, capacity), 0);
+  BOOST_CHECK_EQUAL(BOUNDED_FREQ.size(), capacity);
+
+  size_t floor = 0;
+  map<string, size_t> errors;
+  std::ifstream error_file (bounded_dir + "/freq_error.txt");
+  BOOST_REQUIRE(error_file.is_open());
+  string line;
+  BOOST_REQUIRE(getline(error_file, line));
+  floor = s9::FromString<size_t>(line);
+  while (getline(error_file, line)) {
+    vector<string> tokens = s9::SplitStringString(line, ", ");
+    BOOST_REQUIRE_EQUAL(tokens.size(), 2);
+    errors[tokens[0]] = s9::FromString<size_t>(tokens[1]);
+  }
+
+  for (auto & it : BOUNDED_FREQ) {
+    size_t exact = FREQ[it.first];
+    BOOST_CHECK(it.second - errors[it.first] <= exact);
+    BOOST_CHECK(exact <= it.second);
+  }
+
+  for (auto & it : FREQ) {
+    if (it.second > floor) { BOOST_CHECK(BOUNDED_FREQ.find(it.first) != BOUNDED_FREQ.end()); }
+  }
+
+  // So the top words at least must all have been kept, with their counts bracketed above
+  vector<size_t> counts;
+  for (auto & it : FREQ) { counts.push_back(it.second); }
+  std::sort(counts.rbegin(), counts.rend());
+  BOOST_CHECK(counts[top - 1] > floor);
+}
+
+// Counts what corpus_scan hands it, checking each thread gets its sentences in order
+class TokenTally : public SentenceConsumer {
+public:
+  TokenTally() : tokens(0), files(0), ordered(true) {}
+
+  int begin_file(const Corpus & corpus, const string & name) override {
+    last.assign(omp_get_max_threads(), 0);
+    files++;
+    return 0;
+  }
+
+  void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) override {
+    if (start < last[thread]) { ordered = false; }
+    last[thread] = end;
+    #pragma omp atomic
+    tokens += end - start;
+  }
+
+  uint64_t tokens;
+  int files;
+  bool ordered;
+  vector<uint64_t> last;
+};
+
+// As TokenTally, but checks each chunk is handed over as one unbroken run
+class RunTally : public TokenTally {
+public:
+  RunTally() : unbroken(true) {}
+
+  int begin_file(const Corpus & corpus, const string & name) override {
+    chunk_last.assign(corpus_scan_chunks(), 0);
+    return TokenTally::begin_file(corpus, name);
+  }
+
+  void sentence(const Corpus & corpus, uint64_t start, uint64_t end, int thread, size_t chunk) override {
+    if (chunk_last[chunk] != 0 && start != chunk_last[chunk]) { unbroken = false; }
+    chunk_last[chunk] = end;
+    TokenTally::sentence(corpus, start, end, thread, chunk);
+  }
+
+  bool unbroken;
+  vector<uint64_t> chunk_last;
+};
+
+// One scan of the text and one of the converted files should see the same tokens
+BOOST_AUTO_TEST_CASE(corpus_scan_test) {
+
+  vector<string> filenames;
+  DIR *dir;
+  struct dirent *ent;
+  dir = opendir ("./ukwac");
+
+  while ((ent = readdir (dir)) != NULL) {
+    if (strcmp(ent->d_name,".") == 0 || strcmp(ent->d_name,"..") == 0){
+      continue;
+    }
+    filenames.push_back("./ukwac/" + string(ent->d_name));
+  }
+
+  BOOST_CHECK_EQUAL(create_corpus(filenames, "./output/corpus"), 0);
+  vector<string> corpus_files = corpus_filenames("./output/corpus");
+
+  TokenTally text, binary, again;
+  RunTally runs;
+  vector<SentenceConsumer*> text_consumers {&text};
+  vector<SentenceConsumer*> binary_consumers {&binary, &again};
+  vector<SentenceConsumer*> run_consumers {&runs};
+
+  BOOST_CHECK_EQUAL(corpus_scan(filenames, text_consumers), 0);
+  BOOST_CHECK_EQUAL(corpus_scan(corpus_files, binary_consumers), 0);
+  BOOST_CHECK_EQUAL(corpus_scan(corpus_files, run_consumers), 0);
+
+  BOOST_CHECK_EQUAL(text.files, filenames.size());
+  BOOST_CHECK(text.tokens > 0);
+  BOOST_CHECK_EQUAL(text.tokens, binary.tokens);
+  BOOST_CHECK_EQUAL(binary.tokens, again.tokens);
+  BOOST_CHECK_EQUAL(binary.tokens, runs.tokens);
+  BOOST_CHECK(text.ordered && binary.ordered && runs.ordered);
+  BOOST_CHECK(runs.unbroken);
+
+  // The chunks cover every sentence, and none is bigger than its share plus one sentence
+  for (string path : corpus_files) {
+    Corpus corpus;
+    BOOST_CHECK_EQUAL(corpus_open(corpus, path), 0);
+    uint64_t num_sentences = corpus.header->num_sentences;
+    uint64_t num_tokens = corpus.header->num_tokens;
+
+    uint64_t longest = 0;
+    for (uint64_t s = 0; s < num_sentences; ++s) {
+      longest = std::max(longest, corpus.sentences[s+1] - corpus.sentences[s]);
+    }
+
+    for (size_t num_chunks : {1, 7, 64}) {
+      vector<uint64_t> chunks = corpus_chunks(corpus, num_chunks);
+      BOOST_CHECK_EQUAL(chunks.size(), num_chunks + 1);
+      BOOST_CHECK_EQUAL(chunks.front(), 0);
+      BOOST_CHECK_EQUAL(chunks.back(), num_sentences);
+      for (size_t c = 0; c < num_chunks; ++c) {
+        BOOST_CHECK(chunks[c] <= chunks[c+1]);
+        BOOST_CHECK(corpus.sentences[chunks[c+1]] - corpus.sentences[chunks[c]] <= num_tokens / num_chunks + longest + 1);
+      }
+    }
+  }
+}
+
+// Parsing a text file in blocks on several threads should give exactly what one block does
+BOOST_AUTO_TEST_CASE(corpus_parse_blocks_test) {
+
+  int max_threads = omp_get_max_threads();
+
+  for (string name : {"ukwac_00", "ukwac_03"}) {
+    string path = "./ukwac/" + name;
+    CorpusData whole, blocks;
+
+    omp_set_num_threads(1);
+    BOOST_CHECK_EQUAL(corpus_parse_text(path, whole), 0);
+    omp_set_num_threads(4);
+    BOOST_CHECK_EQUAL(corpus_parse_text(path, blocks, 512), 0);
+    omp_set_num_threads(max_threads);
+
+    BOOST_CHECK(whole.header.num_sentences > 4);
+    BOOST_CHECK_EQUAL(memcmp(&whole.header, &blocks.header, sizeof(CorpusHeader)), 0);
+    BOOST_CHECK(whole.sentences == blocks.sentences);
+    BOOST_CHECK(whole.strings == blocks.strings);
+    BOOST_CHECK(whole.string_data == blocks.string_data);
+    for (int c = 0; c < 6; ++c) {
+      BOOST_CHECK(whole.cols[c] == blocks.cols[c]);
+    }
+  }
+}
+
+// The basis slot table must give exactly the counts the old linear search of the basis did
+BOOST_AUTO_TEST_CASE(basis_slots_test) {
+  size_t VOCAB_SIZE = 200;
+  size_t BASIS_SIZE = 40;
+  size_t WINDOW_SIZE = 5;
+
+  // A basis with a repeat in it and a word past BASIS_SIZE that must not count
+  vector<int> BASIS_VECTOR;
+  for (int i = 0; i < BASIS_SIZE; ++i) { BASIS_VECTOR.push_back((i * 7) % VOCAB_SIZE); }
+  BASIS_VECTOR[10] = BASIS_VECTOR[3];
+  BASIS_VECTOR.push_back(199);
+
+  vector<int> BASIS_SLOTS = create_basis_slots(BASIS_VECTOR, BASIS_SIZE, VOCAB_SIZE);
+  BOOST_CHECK_EQUAL(BASIS_SLOTS[BASIS_VECTOR[3]], 3);
+  BOOST_CHECK_EQUAL(BASIS_SLOTS[199], -1);
+  BOOST_CHECK_EQUAL(BASIS_SLOTS[VOCAB_SIZE], -1);
+
+  vector< vector<float> > expected (VOCAB_SIZE + 1, vector<float>(BASIS_SIZE, 0.0));
+  vector< vector<float> > counted (VOCAB_SIZE + 1, vector<float>(BASIS_SIZE, 0.0));
+  vector<int> slots;
+  CooccurrenceLog log (counted, 1);
+  srand(42);
+
+  for (int s = 0; s < 100; ++s) {
+    vector<int> sentence;
+    int length = rand() % 30;
+    for (int i = 0; i < length; ++i) { sentence.push_back(rand() % (VOCAB_SIZE + 1)); }
+
+    count_sentence(sentence, BASIS_SLOTS, log, 0, WINDOW_SIZE, slots);
+
+    for (int idw = 0; idw < sentence.size(); ++idw){
+      for (int jdw = idw-1; jdw > idw - WINDOW_SIZE && jdw >= 0; --jdw){
+        for (int bv = 0; bv < BASIS_SIZE; ++bv){
+          if (BASIS_VECTOR[bv] == sentence[jdw]){ expected[sentence[idw]][bv] += 1.0; break; }
+        }
+      }
+      for (int jdw = idw+1; jdw < idw + WINDOW_SIZE && jdw < sentence.size(); ++jdw){
+        for (int bv = 0; bv < BASIS_SIZE; ++bv){
+          if (BASIS_VECTOR[bv] == sentence[jdw]){ expected[sentence[idw]][bv] += 1.0; break; }
+        }
+      }
+    }
+  }
+
+  log.flush();
+  BOOST_CHECK(expected == counted);
+}
+
+// Many threads logging into the shards must add up to the same counts as one thread
+BOOST_AUTO_TEST_CASE(cooccurrence_log_test) {
+  size_t VOCAB_SIZE = 500;
+  size_t BASIS_SIZE = 50;
+  size_t WINDOW_SIZE = 5;
+
+  vector<int> BASIS_VECTOR;
+  for (int i = 0; i < BASIS_SIZE; ++i) { BASIS_VECTOR.push_back(i * 3); }
+  vector<int> BASIS_SLOTS = create_basis_slots(BASIS_VECTOR, BASIS_SIZE, VOCAB_SIZE);
+
+  // Skew the words so the frequent rows are hit by every thread at once
+  vector< vector<int> > sentences (20000);
+  srand(7);
+  for (vector<int> & sentence : sentences) {
+    int length = 5 + rand() % 40;
+    for (int i = 0; i < length; ++i) {
+      int w = rand() % (VOCAB_SIZE + 1);
+      sentence.push_back(rand() % 2 ? w % 20 : w);
+    }
+  }
+
+  vector< vector<float> > serial (VOCAB_SIZE + 1, vector<float>(BASIS_SIZE, 0.0));
+  vector< vector<float> > threaded (VOCAB_SIZE + 1, vector<float>(BASIS_SIZE, 0.0));
+
+  {
+    CooccurrenceLog log (serial, 1);
+    vector<int> slots;
+    for (const vector<int> & sentence : sentences) {
+      count_sentence(sentence, BASIS_SLOTS, log, 0, WINDOW_SIZE, slots);
+    }
+    log.flush();
+  }
+
+  {
+    CooccurrenceLog log (threaded, omp_get_max_threads());
+    #pragma omp parallel
+    {
+      vector<int> slots;
+      #pragma omp for schedule(dynamic, 16)
+      for (int s = 0; s < sentences.size(); ++s) {
+        count_sentence(sentences[s], BASIS_SLOTS, log, omp_get_thread_num(), WINDOW_SIZE, slots);
+      }
+    }
+    log.flush();
+  }
+
+  // Make sure some buffers filled up and were applied before the final flush
+  float busiest = 0;
+  for (const vector<float> & row : serial) {
+    float total = 0;
+    for (float f : row) { total += f; }
+    busiest = std::max(busiest, total);
+  }
+  BOOST_CHECK(busiest > COOCCURRENCE_LOG_SIZE);
+  BOOST_CHECK(serial == threaded);
+}
+
+// The zero copy tokeniser should split exactly as the string versions do
+BOOST_AUTO_TEST_CASE(tokenizer_test) {
+  string text = "<s>\nThe\tthe\tDT\t1\t2\tNMOD\r\n  Dogs  dog NNS\t2\t0 ROOT extra\n\nlast\tline";
+
+  vector<string> lines = s9::SplitStringNewline(text);
+  const char * mem = text.data();
+  const char * mem_end = mem + text.size();
+  s9::StringRef line;
+  s9::StringRef fields[6];
+  size_t n = 0;
+  string lower;
+
+  while (s9::NextLine(mem, mem_end, line)) {
+    BOOST_REQUIRE(n < lines.size());
+    BOOST_CHECK_EQUAL(line.to_string(), lines[n]);
+
+    vector<string> tokens = s9::SplitStringWhitespace(lines[n]);
+    size_t count = s9::SplitFieldsWhitespace(line, fields, 6);
+    BOOST_CHECK_EQUAL(count, tokens.size());
+    for (size_t i = 0; i < count && i < 6; ++i) {
+      BOOST_CHECK_EQUAL(fields[i].to_string(), tokens[i]);
+      BOOST_CHECK_EQUAL(s9::ToLowerInto(fields[i], lower), s9::ToLower(tokens[i]));
+      BOOST_CHECK_EQUAL(s9::ParseInt(fields[i]), s9::FromString<int>(tokens[i]));
+    }
+    n++;
+  }
+  BOOST_CHECK_EQUAL(n, lines.size());
+  BOOST_CHECK(s9::FieldContains(s9::StringRef("NNS"), "NN"));
+  BOOST_CHECK_EQUAL(s9::ParseInt("-12"), -12);
+}
+
+BOOST_AUTO_TEST_CASE(freq_counter_test) {
+  // Spread the same tokens over different numbers of counters and check the merge agrees
+  vector<string> words;
+  unsigned seed = 11;
+  for (int i = 0; i < 20000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    words.push_back("w" + s9::ToString((seed >> 16) % 3000));
+  }
+
+  map<string, pair<size_t,bool> > expected;
+  for (size_t i = 0; i < words.size(); ++i) {
+    auto it = expected.find(words[i]);
+    if (it == expected.end()) {
+      expected[words[i]] = make_pair(1, i % 3 == 0);
+    } else {
+      it->second.first++;
+    }
+  }
+
+  for (size_t num = 1; num <= 5; num += 2) {
+    vector<FreqCounter> counters (num);
+    for (size_t i = 0; i < words.size(); ++i) {
+      counters[i * num / words.size()].add(words[i], i, i % 3 == 0);
+    }
+
+    map<string, pair<size_t,bool> > found;
+    size_t num_parts = 4;
+    for (size_t p = 0; p < num_parts; ++p) {
+      FreqCounter part;
+      for (const FreqCounter & c : counters) { part.merge(c, p, num_parts); }
+      for (const FreqCounter::Entry & e : part.entries()) {
+        BOOST_CHECK(found.find(part.word(e).to_string()) == found.end());
+        found[part.word(e).to_string()] = make_pair(e.count, e.allowed);
+      }
+    }
+    BOOST_CHECK(found == expected);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(freq_counter_bounded_test) {
+  // A skewed stream through bounded counters, merged, must keep every frequent word and
+  // bracket every true count between count - error and count
+  vector<string> words;
+  unsigned seed = 7;
+  for (int i = 0; i < 50000; ++i) {
+    seed = seed * 1103515245 + 12345;
+    double u = ((seed >> 8) & 0xffff) / 65536.0;
+    words.push_back("w" + s9::ToString(static_cast<int>(pow(5000.0, u * u))));
+  }
+
+  map<string, size_t> expected;
+  for (string & w : words) { expected[w]++; }
+
+  size_t capacity = 200;
+  vector<FreqCounter> counters (3, FreqCounter(capacity));
+  for (size_t i = 0; i < words.size(); ++i) {
+    counters[i * 3 / words.size()].add(words[i], i, true);
+  }
+
+  FreqCounter merged (capacity);
+  for (const FreqCounter & c : counters) { merged.merge(c); }
+  merged.shrink();
+  BOOST_CHECK_EQUAL(merged.entries().size(), capacity);
+  BOOST_CHECK_EQUAL(merged.total(), words.size());
+  BOOST_CHECK(merged.floor() > 0);
+
+  set<string> kept;
+  for (const FreqCounter::Entry & e : merged.entries()) {
+    string w = merged.word(e).to_string();
+    kept.insert(w);
+    BOOST_CHECK(e.count - e.error <= expected[w]);
+    BOOST_CHECK(expected[w] <= e.count);
+  }
+  for (auto & it : expected) {
+    if (it.second > merged.floor()) { BOOST_CHECK(kept.find(it.first) != kept.end()); }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(dictionary_lookup_test) {
+  // Enough words to make the index grow a few times
+  Dictionary dictionary;
+  vector<string> words;
+  for (int i = 0; i < 3000; ++i) {
+    words.push_back("word" + s9::ToString(i * 7919 % 10007));
+    BOOST_CHECK(dictionary.insert(words.back()) == i);
+  }
+
+  BOOST_CHECK(dictionary.size() == words.size());
+  BOOST_CHECK(dictionary.insert(words[42]) == 42);
+  BOOST_CHECK(dictionary.size() == words.size());
+
+  string field = "xxWORD" + s9::ToString(5 * 7919 % 10007);
+  string buffer;
+  for (size_t i = 0; i < words.size(); ++i) {
+    BOOST_CHECK(dictionary.find(words[i]) == static_cast<int>(i));
+    BOOST_CHECK(dictionary.word(i) == words[i]);
+  }
+  BOOST_CHECK(dictionary.find(s9::ToLowerInto(s9::StringRef(field).substr(2), buffer)) == 5);
+  BOOST_CHECK(dictionary.find("unseen") == -1);
+  BOOST_CHECK(dictionary["unseen"] == 0);
+}
+
+BOOST_AUTO_TEST_CASE(integer_file_test) {
+  // Sentences can be written in any order and empty ones vanish from the index
+  vector<uint64_t> starts {0, 1, 1, 6, 6, 7};
+  IntegerFile file;
+  BOOST_CHECK(file.open("./output/integers_file_test", starts, 5) == 0);
+  uint32_t * s3 = file.sentence(3);
+  *s3 = 9;
+  uint32_t * s1 = file.sentence(1);
+  for (uint32_t i = 0; i < 5; ++i) { s1[i] = i; }
+  *file.sentence(0) = 7;
+  BOOST_CHECK(file.close() == 0);
+
+  IntegerIndexHeader header;
+  vector<uint64_t> sentences;
+  BOOST_CHECK(integer_index_read("./output/integers_file_test.idx", header, sentences) == 0);
+  BOOST_CHECK(header.num_tokens == 7);
+  BOOST_CHECK(header.num_known == 5);
+  BOOST_CHECK(header.num_sentences == 3);
+  BOOST_CHECK(sentences == (vector<uint64_t> {0, 1, 6, 7}));
+
+  std::ifstream data ("./output/integers_file_test.bin", std::ios::binary);
+  vector<uint32_t> ids (8, 0);
+  data.read(reinterpret_cast<char*>(&ids[0]), ids.size() * sizeof(uint32_t));
+  BOOST_CHECK(data.gcount() == 7 * sizeof(uint32_t));
+  ids.resize(7);
+  BOOST_CHECK(ids == (vector<uint32_t> {7, 0, 1, 2, 3, 4, 9}));
+
+  // A file with no tokens still gets an empty stream and an index
+  vector<uint64_t> none {0, 0};
+  BOOST_CHECK(file.open("./output/integers_file_empty", none, 0) == 0);
+  BOOST_CHECK(file.close() == 0);
+  BOOST_CHECK(integer_index_read("./output/integers_file_empty.idx", header, sentences) == 0);
+  BOOST_CHECK(header.num_tokens == 0);
+  BOOST_CHECK(header.num_sentences == 0);
+  BOOST_CHECK(boost::filesystem::file_size("./output/integers_file_empty.bin") == 0);
+}
+
+BOOST_AUTO_TEST_CASE(text_output_test) {
+  // Numbers must come out exactly as the streams we replaced wrote them
+  TextBuffer text;
+  std::stringstream expected;
+  vector<float> floats {0.0f, -0.0f, 1.0f, 0.1f, 1.0f / 3.0f, -2.5e-7f, 123456789.0f, 0.99999999f};
+  for (float f : floats) {
+    text << f << ',';
+    expected << s9::ToString(f) << ',';
+  }
+  vector<long long> ints {0, 7, -7, 2147483647LL, -2147483648LL, 9007199254740993LL};
+  for (long long v : ints) {
+    text << v << ' ' << static_cast<int>(v) << ' ';
+    expected << v << ' ' << static_cast<int>(v) << ' ';
+  }
+  text << size_t(18446744073709551615ULL);
+  expected << size_t(18446744073709551615ULL);
+  BOOST_CHECK_EQUAL(text.str(), expected.str());
+
+  // Rows from a parallel loop land in loop order, with the skipped ones left out
+  string path = "./output/text_output_test.txt";
+  string order;
+  {
+    TextFile out;
+    BOOST_CHECK(out.open(path));
+    ResultRows rows (out, 1000);
+    #pragma omp parallel for schedule(dynamic, 3)
+    for (int i = 0; i < 1000; ++i) {
+      if (i % 7 == 0) {
+        rows.skip(i);
+      } else {
+        TextBuffer row;
+        row << i << '\n';
+        rows.set(i, row);
+      }
+    }
+    rows.finish();
+    out.close();
+  }
+  for (int i = 0; i < 1000; ++i) {
+    if (i % 7 != 0) { order += s9::ToString(i) + "\n"; }
+  }
+  std::ifstream in (path);
+  std::stringstream written;
+  written << in.rdbuf();
+  BOOST_CHECK(written.str() == order);
+}
+
+BOOST_AUTO_TEST_CASE(stats_stage_test) {
+
+  // Stages nest and take counts from every thread; the first stage opened writes the status
+  string path = "./output/stats_stage_test.json";
+  char arg0[] = "wacky_test_basic";
+  char * argv[] = {arg0};
+  stats_init(path, 1, argv);
+  {
+    StatsStage outer ("stats_outer");
+    StatsStage inner ("stats_inner");
+    stats_total(100);
+    #pragma omp parallel
+    {
+      StatsBusy busy;
+      #pragma omp for nowait
+      for (int i = 0; i < 100; ++i) {
+        stats_count(10, 1, 5);
+        stats_step();
+      }
+    }
+  }
+  stats_count(1, 1, 1);
+  stats_step();
+
+  std::ifstream in (path + ".status");
+  std::stringstream status;
+  status << in.rdbuf();
+  BOOST_CHECK(status.str().find("stage stats_outer\n") != string::npos);
+  BOOST_CHECK(status.str().find("stage_peak_rss_kb ") != string::npos);
+  BOOST_CHECK(status.str().find("\nrss_kb ") != string::npos);
+  BOOST_CHECK(status.str().find("\npeak_rss_kb ") != string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(synth_corpus_test) {
+
+  // A small synthetic corpus, checked line by line for well formed trees
+  SynthOptions options;
+  options.num_tokens = 20000;
+  options.num_files = 3;
+  options.num_nouns = 500;
+  options.num_verbs = 50;
+  options.num_adjectives = 100;
+
+  // Kept apart from ./output so we don't overwrite the frequencies the verb tests read
+  string synth_dir = "./output/synth";
+  boost::filesystem::create_directories(synth_dir);
+
+  vector<string> filenames;
+  SynthCounts counts;
+  BOOST_REQUIRE(synth_corpus(synth_dir, options, filenames, counts) == 0);
+  BOOST_CHECK_EQUAL(filenames.size(), 3);
+  BOOST_CHECK(counts.tokens >= options.num_tokens);
+  BOOST_CHECK(synth_word(0, 0) != synth_word(0, 1));
+
+  uint64_t tokens = 0, sentences = 0, bytes = 0;
+  bool heads_ok = true;
+  for (string path : filenames) {
+    std::ifstream infile (path);
+    string line;
+    vector<int> heads;
+    while (std::getline(infile, line)) {
+      bytes += line.size() + 1;
+      vector<string> fields = s9::SplitStringString(line, "\t");
+      if (line == "</s>") {
+        for (int h : heads) { heads_ok = heads_ok && h >= 0 && h <= heads.size(); }
+        heads.clear();
+        sentences++;
+      } else if (fields.size() == 6) {
+        heads.push_back(s9::FromString<int>(fields[4]));
+        tokens++;
+      }
+    }
+  }
+  BOOST_CHECK(heads_ok);
+  BOOST_CHECK_EQUAL(tokens, counts.tokens);
+  BOOST_CHECK_EQUAL(sentences, counts.sentences);
+  BOOST_CHECK_EQUAL(bytes, counts.bytes);
+
+  // The most frequent noun and verb should be near the top of the frequency list
+  map<string, size_t> freq;
+  vector< pair<string,size_t> > freq_flipped;
+  set<string> ignores {",", ".", "<text", "<s>", "</s>", "</text>"};
+  set<string> allowed;
+  BOOST_REQUIRE(create_freq(filenames, synth_dir, freq, freq_flipped, ignores, allowed, true) == 0);
+  BOOST_CHECK(freq[synth_word(0, 0)] > freq[synth_word(10, 0)]);
+  BOOST_CHECK(freq[synth_word(0, 1)] > freq[synth_word(10, 1)]);
+  BOOST_CHECK(allowed.find(synth_word(0, 1)) != allowed.end());
+}
+
+BOOST_AUTO_TEST_CASE(targeted_vectors_test) {
+
+  // A targeted count says which rows it filled, so its zero rows are never read as real ones
+  string dir = "./output/targeted";
+  boost::filesystem::create_directories(dir);
+
+  size_t vocab = 5, basis = 3;
+  vector<string> dictionary {"a", "b", "c", "d", "e"};
+  vector<int> basis_vector {0, 1, 2};
+  set<int> targets {1, 3};
+  vector< vector<float> > word_vectors;
+  init_word_vectors(word_vectors, vocab, basis, &targets);
+  word_vectors[1][0] = 2;
+  word_vectors[3][2] = 5;
+  BOOST_REQUIRE(write_word_vectors(dir, word_vectors, &targets) == 0);
+  BOOST_CHECK(boost::filesystem::exists(dir + "/" + TARGETS_FILE_NAME));
+
+  SparseVectors read_vectors;
+  BOOST_CHECK_EQUAL(read_count_raw(dir, dictionary, basis_vector, read_vectors, targets), 0);
+  BOOST_CHECK_EQUAL(read_vectors.rows(), vocab);
+  BOOST_CHECK_EQUAL(read_vectors.nnz(), 2);
+  vector<float> row;
+  sparse_row_dense(read_vectors, 3, row);
+  BOOST_CHECK_EQUAL(row[2], 5.0f);
+
+  set<int> more {1, 2, 3};
+  BOOST_CHECK_EQUAL(read_count_raw(dir, dictionary, basis_vector, read_vectors, more), 1);
+
+  // A full count takes the list away again
+  word_vectors.clear();
+  init_word_vectors(word_vectors, vocab, basis);
+  BOOST_REQUIRE(write_word_vectors(dir, word_vectors) == 0);
+  BOOST_CHECK(!boost::filesystem::exists(dir + "/" + TARGETS_FILE_NAME));
+  BOOST_CHECK_EQUAL(read_count_raw(dir, dictionary, basis_vector, read_vectors, more), 0);
+}
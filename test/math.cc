@@ -10,9 +10,17 @@
 #include <fstream>
 #include <vector>
 #include <omp.h>
+#include <thread>
+#include <chrono>
 
 #include "string_utils.hpp"
 #include "wacky_math.hpp"
+#include "wacky_kron.hpp"
+#include "wacky_sketch.hpp"
+#include "wacky_sparse.hpp"
+#include "wacky_verb_cache.hpp"
+#include "wacky_vector_file.hpp"
+#include "wacky_workspace.hpp"
 
 using namespace std;
 
@@ -37,3 +45,578 @@ BOOST_AUTO_TEST_CASE(math_test) {
 
 
 }
+
+// Build the dense tensor a KronSum stands for, so we can check the gram matrix path
+
+static vector<float> dense_krn(const KronSum & k) {
+  vector<float> d (k.basis * k.basis, 0);
+  vector<float> a (k.basis), b (k.basis);
+  for (size_t t = 0; t < k.weight.size(); ++t) {
+    krn_row(k, k.left[t], &a[0]);
+    krn_row(k, k.right[t], &b[0]);
+    for (int i = 0; i < k.basis; ++i) {
+      for (int j = 0; j < k.basis; ++j) {
+        float s = k.scale.empty() ? 1.0f : k.scale[i] * k.scale[j];
+        d[(i * k.basis) + j] += k.weight[t] * a[i] * b[j] * s;
+      }
+    }
+  }
+  return d;
+}
+
+static double dense_dot(const vector<float> & a, const vector<float> & b) {
+  double d = 0;
+  for (size_t i = 0; i < a.size(); ++i) { d += a[i] * b[i]; }
+  return d;
+}
+
+BOOST_AUTO_TEST_CASE(kron_test) {
+  int basis = 5;
+  vector< vector<float> > rows;
+  for (int r = 0; r < 150; ++r) {
+    vector<float> row (basis);
+    for (int i = 0; i < basis; ++i) { row[i] = float((r * 7 + i * 3) % 11) / 11.0f; }
+    rows.push_back(row);
+  }
+  SparseVectors words;
+  sparse_from_dense(rows, basis, words);
+
+  vector<float> ones (basis, 1.0f);
+  vector<float> verb0 = {0.1, 0.5, 0.2, 0.0, 0.9};
+  vector<float> verb1 = {0.3, 0.1, 0.7, 0.4, 0.2};
+
+  // More terms than one tile so we cross tile boundaries
+  KronSum k0, k1, t0, t1;
+  krn_sum_init(k0, words, basis);
+  krn_sum_init(k1, words, basis);
+  krn_sum_add(k0, &ones[0], &ones[0], 1.0f);
+  krn_sum_add(k1, &ones[0], &ones[0], 1.0f);
+  for (int r = 0; r < 140; ++r) { krn_sum_add(k0, r, (r * 13) % 150, 1.0f); }
+  for (int r = 0; r < 70; ++r) { krn_sum_add(k1, r + 50, r, 2.0f); }
+
+  vector<float> d0 = dense_krn(k0);
+  vector<float> d1 = dense_krn(k1);
+  BOOST_CHECK_CLOSE(krn_sum_dot(k0, k1), dense_dot(d0, d1), 0.01);
+  BOOST_CHECK_CLOSE(krn_sum_dot(k0, k0), dense_dot(d0, d0), 0.01);
+
+  float dsim = dense_dot(d0, d1) / (sqrt(dense_dot(d0, d0)) * sqrt(dense_dot(d1, d1)));
+  BOOST_CHECK_CLOSE(krn_cosine_sim(k0, k1), 1.0 - acos(dsim) / M_PI, 0.01);
+
+  // Adding the verb (x) verb term
+  t0 = k0;
+  krn_sum_add(t0, &verb0[0], &verb0[0], 1.0f);
+  t1 = k1;
+  krn_sum_add(t1, &verb1[0], &verb1[0], 1.0f);
+  BOOST_CHECK_CLOSE(krn_sum_dot(t0, t1), dense_dot(dense_krn(t0), dense_krn(t1)), 0.01);
+
+  // Hadamard with verb (x) verb
+  krn_sum_hadamard(t0, k0, &verb0[0]);
+  krn_sum_hadamard(t1, k1, &verb1[0]);
+  BOOST_CHECK_CLOSE(krn_sum_dot(t0, t1), dense_dot(dense_krn(t0), dense_krn(t1)), 0.01);
+
+  // Symmetric sums, like subject (x) subject
+  krn_sum_init(t0, words, basis);
+  krn_sum_init(t1, words, basis);
+  for (int r = 0; r < 100; ++r) { krn_sum_add(t0, r, r, 1.0f); }
+  for (int r = 40; r < 149; ++r) { krn_sum_add(t1, r, r, 1.0f); }
+  BOOST_CHECK_CLOSE(krn_sum_dot(t0, t1), dense_dot(dense_krn(t0), dense_krn(t1)), 0.01);
+
+  // An empty sum has no length
+  KronSum e;
+  krn_sum_init(e, words, basis);
+  BOOST_CHECK_EQUAL(krn_cosine_sim(e, k0), 2.0f);
+}
+
+// Long sums are dotted dense and short ones through grams. Splitting a long sum into short
+// chunks and adding up the chunk dots should give the same answer either way.
+static KronSum krn_chunk(const KronSum & k, size_t start, size_t count) {
+  KronSum c;
+  krn_sum_init(c, *k.rows, k.basis);
+  for (size_t t = start; t < start + count && t < k.weight.size(); ++t) {
+    krn_sum_add(c, k.left[t], k.right[t], k.weight[t]);
+  }
+  c.scale = k.scale;
+  return c;
+}
+
+static double krn_chunk_dot(const KronSum & k0, const KronSum & k1, size_t chunk) {
+  vector<KronSum> c0, c1;
+  for (size_t i = 0; i < k0.weight.size(); i += chunk) { c0.push_back(krn_chunk(k0, i, chunk)); }
+  for (size_t i = 0; i < k1.weight.size(); i += chunk) { c1.push_back(krn_chunk(k1, i, chunk)); }
+  double dot = 0;
+  for (size_t i = 0; i < c0.size(); ++i) {
+    for (size_t j = 0; j < c1.size(); ++j) {
+      dot += krn_sum_dot(c0[i], c1[j]);
+    }
+  }
+  return dot;
+}
+
+BOOST_AUTO_TEST_CASE(kron_crossover_test) {
+  int basis = 120;
+  vector< vector<float> > rows;
+  for (int r = 0; r < 400; ++r) {
+    vector<float> row (basis, 0.0f);
+    for (int i = 0; i < basis; ++i) {
+      if ((r + i) % 3 != 0) { row[i] = float((r * 7 + i * 3) % 11) / 11.0f; }
+    }
+    rows.push_back(row);
+  }
+  SparseVectors words;
+  sparse_from_dense(rows, basis, words);
+
+  KronSum k0, k1, s0, s1;
+  krn_sum_init(k0, words, basis);
+  krn_sum_init(k1, words, basis);
+  krn_sum_init(s0, words, basis);
+  krn_sum_init(s1, words, basis);
+  for (int r = 0; r < 300; ++r) { krn_sum_add(k0, r, (r * 13) % 400, float(r % 3 + 1)); }
+  for (int r = 0; r < 250; ++r) { krn_sum_add(k1, r + 100, r, 1.0f); }
+  for (int r = 0; r < 280; ++r) { krn_sum_add(s0, r, r, 1.0f); }
+  for (int r = 90; r < 400; ++r) { krn_sum_add(s1, r, r, 2.0f); }
+
+  // Chunks of 70 go through the grams, crossing a tile, the whole sums go dense
+  BOOST_CHECK_CLOSE(krn_sum_dot(k0, k1), krn_chunk_dot(k0, k1, 70), 0.01);
+  BOOST_CHECK_CLOSE(krn_sum_dot(k0, k0), krn_chunk_dot(k0, k0, 70), 0.01);
+  BOOST_CHECK_CLOSE(krn_sum_dot(s0, s1), krn_chunk_dot(s0, s1, 70), 0.01);
+  BOOST_CHECK_CLOSE(krn_sum_dot(s0, s0), krn_chunk_dot(s0, s0, 70), 0.01);
+  BOOST_CHECK_CLOSE(krn_sum_dot(k0, k1), dense_dot(dense_krn(k0), dense_krn(k1)), 0.01);
+
+  vector<float> verb (rows[7]);
+  KronSum m0, m1;
+  krn_sum_hadamard(m0, k0, &verb[0]);
+  krn_sum_hadamard(m1, s1, &verb[0]);
+  BOOST_CHECK_CLOSE(krn_sum_dot(m0, m1), krn_chunk_dot(m0, m1, 70), 0.01);
+
+  // The dense path builds its tensors a band at a time in the room the grams take, so a
+  // dense pair never runs over the workspace and the next reset leaves it the same size
+  Workspace work (krn_workspace_floats(basis));
+  BOOST_CHECK_EQUAL(work.capacity(), krn_workspace_floats(basis));
+  BOOST_CHECK_CLOSE(krn_cosine_sim(k0, k1, krn_sum_dot(k0, k0, &work), krn_sum_dot(k1, k1, &work), &work), krn_cosine_sim(k0, k1), 0.001);
+  BOOST_CHECK_EQUAL(work.mark(), 0);
+  BOOST_CHECK(work.peak() <= krn_workspace_floats(basis));
+  work.reset();
+  BOOST_CHECK_EQUAL(work.capacity(), krn_workspace_floats(basis));
+
+  // A sum with itself can round just past a cosine of 1, which must not come out as nan
+  BOOST_CHECK_CLOSE(krn_cosine_sim(k0, k0, krn_sum_dot(k0, k0) * 0.999, krn_sum_dot(k0, k0) * 0.999, &work), 1.0f, 0.001);
+}
+
+BOOST_AUTO_TEST_CASE(kron_dense_test) {
+  int basis = 7;
+  vector< vector<float> > rows;
+  for (int r = 0; r < 300; ++r) {
+    vector<float> row (basis);
+    for (int i = 0; i < basis; ++i) { row[i] = float((r * 5 + i * 2) % 13) / 13.0f; }
+    rows.push_back(row);
+  }
+  SparseVectors words;
+  sparse_from_dense(rows, basis, words);
+
+  // More terms than one GEMM block, with weights and a scale
+  KronSum k, h;
+  krn_sum_init(k, words, basis);
+  for (int r = 0; r < 300; ++r) { krn_sum_add(k, r, (r * 17) % 300, float(r % 3 + 1)); }
+  vector<float> v = {0.2, 0.4, 0.6, 0.8, 1.0, 0.5, 0.1};
+  krn_sum_hadamard(h, k, &v[0]);
+
+  vector<float> d (basis * basis);
+  krn_sum_dense(h, &d[0]);
+  vector<float> e = dense_krn(h);
+
+  for (int i = 0; i < basis * basis; ++i) {
+    BOOST_CHECK_CLOSE(d[i], e[i], 0.01);
+  }
+}
+
+// Packed upper triangles of self products should match the dense tensors
+BOOST_AUTO_TEST_CASE(kron_packed_test) {
+  int basis = 70;
+  vector< vector<float> > rows;
+  for (int r = 0; r < 300; ++r) {
+    vector<float> row (basis);
+    for (int i = 0; i < basis; ++i) { row[i] = float((r * 5 + i * 2) % 13) / 13.0f; }
+    rows.push_back(row);
+  }
+  SparseVectors words;
+  sparse_from_dense(rows, basis, words);
+
+  // More terms than one GEMM block and more rows than one band
+  KronSum k0, k1;
+  krn_sum_init(k0, words, basis);
+  krn_sum_init(k1, words, basis);
+  for (int r = 0; r < 300; ++r) { krn_sum_add(k0, r, r, float(r % 3 + 1)); }
+  for (int r = 20; r < 90; ++r) { krn_sum_add(k1, r, r, 2.0f); }
+
+  vector<float> p0 (krn_packed_size(basis)), p1 (krn_packed_size(basis));
+  krn_sum_packed(k0, &p0[0]);
+  krn_sum_packed(k1, &p1[0]);
+
+  vector<float> d0 = dense_krn(k0);
+  vector<float> d1 = dense_krn(k1);
+  size_t p = 0;
+  for (int i = 0; i < basis; ++i) {
+    for (int j = i; j < basis; ++j, ++p) {
+      BOOST_CHECK_CLOSE(p0[p], d0[(i * basis) + j], 0.01);
+    }
+  }
+  BOOST_CHECK_EQUAL(p, p0.size());
+
+  // Tiles from a Workspace give the same triangle and are handed back
+  Workspace work (krn_packed_workspace_floats(basis));
+  vector<float> w0 (p0.size());
+  size_t mark = work.mark();
+  krn_sum_packed(k0, &w0[0], &work);
+  BOOST_CHECK_EQUAL(work.mark(), mark);
+  BOOST_CHECK(w0 == p0);
+  work.reset();
+  BOOST_CHECK_EQUAL(work.capacity(), Workspace::slice(krn_packed_workspace_floats(basis)));
+
+  float dsim = dense_dot(d0, d1) / (sqrt(dense_dot(d0, d0)) * sqrt(dense_dot(d1, d1)));
+  BOOST_CHECK_CLOSE(krn_packed_cosine_sim(&p0[0], &p1[0], basis), 1.0 - acos(dsim) / M_PI, 0.01);
+  BOOST_CHECK_CLOSE(krn_packed_cosine_sim(&p0[0], &p1[0], basis), krn_cosine_sim(k0, k1), 0.01);
+
+  // The verb (x) verb term, added and multiplied in
+  vector<float> verb = rows[7];
+  vector<float> td (krn_packed_size(basis));
+  krn_packed_self(&verb[0], basis, &td[0]);
+  KronSum t0, t1;
+  t0 = k0;
+  krn_sum_add(t0, &verb[0], &verb[0], 1.0f);
+  krn_sum_hadamard(t1, k0, &verb[0]);
+
+  vector<float> add (td.size()), mul (td.size());
+  for (size_t i = 0; i < td.size(); ++i) {
+    add[i] = p0[i] + td[i];
+    mul[i] = p0[i] * td[i];
+  }
+  BOOST_CHECK_CLOSE(krn_packed_cosine_sim(&add[0], &mul[0], basis), krn_cosine_sim(t0, t1), 0.01);
+
+  vector<float> zero (td.size(), 0.0f);
+  BOOST_CHECK_EQUAL(krn_packed_cosine_sim(&zero[0], &p0[0], basis), 2.0f);
+}
+
+// Sketched similarities should land within the error we asked for
+BOOST_AUTO_TEST_CASE(tensor_sketch_test) {
+  SketchOptions options;
+  options.epsilon = 0.1f;
+  BOOST_CHECK_EQUAL(tensor_sketch_dim(0.05f, 0.1f), 65536);
+  BOOST_CHECK_EQUAL(tensor_sketch_dim(0.5f, 0.5f), 128);
+
+  int basis = 60;
+  vector< vector<float> > rows;
+  for (int r = 0; r < 200; ++r) {
+    vector<float> row (basis, 0.0f);
+    for (int i = 0; i < basis; ++i) {
+      if ((r * 3 + i * 7) % 4 != 0) { row[i] = float((r * 5 + i * 2) % 13) / 13.0f - 0.3f; }
+    }
+    rows.push_back(row);
+  }
+  SparseVectors words;
+  sparse_from_dense(rows, basis, words);
+
+  TensorSketch ts;
+  tensor_sketch_init(ts, basis, options);
+
+  vector<float> verb0 (rows[3]);
+  vector<float> verb1 (rows[150]);
+  KronSum k0, k1, m0, m1;
+  krn_sum_init(k0, words, basis);
+  krn_sum_init(k1, words, basis);
+  for (int r = 0; r < 40; ++r) { krn_sum_add(k0, r, (r * 13) % 200, float(r % 3 + 1)); }
+  for (int r = 20; r < 80; ++r) { krn_sum_add(k1, r, r, 1.0f); }
+  krn_sum_hadamard(m0, k0, &verb0[0]);
+  krn_sum_hadamard(m1, k1, &verb1[0]);
+
+  Sketch s0, s1;
+  tensor_sketch_krn(ts, k0, s0);
+  tensor_sketch_krn(ts, k1, s1);
+  BOOST_CHECK_EQUAL(s0.size(), ts.dim / 2 + 1);
+  BOOST_CHECK_SMALL(tensor_sketch_cosine_sim(s0, s1) - krn_cosine_sim(k0, k1), 0.05f);
+  BOOST_CHECK_CLOSE(tensor_sketch_cosine_sim(s0, s0), 1.0f, 0.01);
+
+  // Adding a term to the sketch is the same as sketching the bigger sum
+  KronSum a0 = k0;
+  krn_sum_add(a0, &verb0[0], &verb0[0], 1.0f);
+  Sketch sa, sb;
+  tensor_sketch_krn(ts, a0, sa);
+  sb = s0;
+  tensor_sketch_add(ts, &verb0[0], &verb0[0], 1.0f, sb);
+  BOOST_CHECK_CLOSE(tensor_sketch_cosine_sim(sa, sb), 1.0f, 0.01);
+  BOOST_CHECK_SMALL(tensor_sketch_cosine_sim(sa, s1) - krn_cosine_sim(a0, k1), 0.05f);
+
+  Sketch h0, h1;
+  tensor_sketch_krn(ts, m0, h0);
+  tensor_sketch_krn(ts, m1, h1);
+  BOOST_CHECK_SMALL(tensor_sketch_cosine_sim(h0, h1) - krn_cosine_sim(m0, m1), 0.05f);
+
+  KronSum e;
+  krn_sum_init(e, words, basis);
+  Sketch se;
+  tensor_sketch_krn(ts, e, se);
+  BOOST_CHECK_EQUAL(tensor_sketch_cosine_sim(se, s0), 2.0f);
+
+  options.only = true;
+  BOOST_CHECK_EQUAL(sketch_columns({"a", "b"}, options), ",a_approx,b_approx");
+  options.only = false;
+  BOOST_CHECK_EQUAL(sketch_columns({"a", "b"}, options), ",a,b,a_approx,b_approx");
+  options.epsilon = 0;
+  BOOST_CHECK_EQUAL(sketch_columns({"a", "b"}, options), ",a,b");
+}
+
+// Workspace slices should be aligned, handed back on reset and grow the block when we run over
+BOOST_AUTO_TEST_CASE(workspace_test) {
+  Workspace work (64);
+  BOOST_CHECK_EQUAL(Workspace::slice(1), 16);
+  BOOST_CHECK_EQUAL(Workspace::slice(32), 32);
+  BOOST_CHECK_EQUAL(work.capacity(), 64);
+
+  float * a = work.take(10);
+  float * b = work.take(20);
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(a) % 64, 0);
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(b) % 64, 0);
+  BOOST_CHECK_EQUAL(b - a, 16);
+
+  size_t mark = work.mark();
+  float * c = work.take(5);
+  work.rewind(mark);
+  BOOST_CHECK_EQUAL(work.take(5), c);
+
+  work.reset();
+  BOOST_CHECK_EQUAL(work.take(10), a);
+
+  // Running over hands out a block of its own, and the next reset makes room for it
+  float * d = work.take(100);
+  d[99] = 1.0f;
+  BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(d) % 64, 0);
+  BOOST_CHECK_EQUAL(work.peak(), 128);
+  work.reset();
+  BOOST_CHECK_EQUAL(work.capacity(), 128);
+  work.take(10);
+  work.take(100);
+  BOOST_CHECK_EQUAL(work.capacity(), 128);
+
+  // krn_sum_dot gives the same answer with its tiles from a workspace, and gives them back
+  int basis = 20;
+  vector< vector<float> > rows;
+  for (int r = 0; r < 50; ++r) {
+    vector<float> row (basis);
+    for (int i = 0; i < basis; ++i) { row[i] = float((r * 7 + i * 3) % 11) / 11.0f; }
+    rows.push_back(row);
+  }
+  SparseVectors words;
+  sparse_from_dense(rows, basis, words);
+  KronSum k0, k1;
+  krn_sum_init(k0, words, basis);
+  krn_sum_init(k1, words, basis);
+  for (int r = 0; r < 40; ++r) { krn_sum_add(k0, r, 49 - r, 1.0f); }
+  for (int r = 10; r < 50; ++r) { krn_sum_add(k1, r, r, 0.5f); }
+
+  Workspace tiles (krn_workspace_floats(basis));
+  BOOST_CHECK_EQUAL(krn_sum_dot(k0, k1, &tiles), krn_sum_dot(k0, k1));
+  BOOST_CHECK_EQUAL(tiles.mark(), 0);
+  BOOST_CHECK(tiles.peak() <= krn_workspace_floats(basis));
+}
+
+// The verb cache should evict the least recently used, never keep what can't fit and hand
+// every thread the same entry for a verb
+BOOST_AUTO_TEST_CASE(verb_cache_test) {
+  typedef VerbCache< vector<float> > Cache;
+  size_t quarter = (256 * 1024) / sizeof(float);  // floats in a quarter of a megabyte
+  int builds = 0;
+
+  auto sized = [&](size_t floats, float fill) {
+    return [&builds, floats, fill](VerbTensor< vector<float> > & t) {
+      #pragma omp atomic
+      builds++;
+      t.base.assign(floats, fill);
+    };
+  };
+
+  // Room for two 0.4MB entries in a budget of 1MB
+  Cache cache (1);
+  size_t big = (quarter * 8) / 5;
+  Cache::Entry a = cache.get(0, MODEL_SBJ, sized(big, 1.0f));
+  Cache::Entry b = cache.get(1, MODEL_SBJ, sized(big, 2.0f));
+  BOOST_CHECK_EQUAL(cache.get(0, MODEL_SBJ, sized(big, 9.0f)), a);
+  BOOST_CHECK_EQUAL(builds, 2);
+
+  // A third evicts 1, which was used least recently, and keeps 0
+  cache.get(2, MODEL_SBJ, sized(big, 3.0f));
+  BOOST_CHECK_EQUAL(cache.get(0, MODEL_SBJ, sized(big, 9.0f)), a);
+  BOOST_CHECK_EQUAL(builds, 3);
+  Cache::Entry b2 = cache.get(1, MODEL_SBJ, sized(big, 2.0f));
+  BOOST_CHECK(b2 != b);
+  BOOST_CHECK_EQUAL(b->base[0], 2.0f);
+  BOOST_CHECK_EQUAL(builds, 4);
+
+  // The same verb under another model is another entry
+  BOOST_CHECK(cache.get(1, MODEL_SBJ_OBJ, sized(16, 4.0f)) != b2);
+  BOOST_CHECK_EQUAL(builds, 5);
+
+  // Bigger than the budget - handed back whole but not kept, and nothing is evicted for it
+  Cache::Entry huge = cache.get(3, MODEL_SBJ, sized(quarter * 5, 5.0f));
+  BOOST_CHECK_EQUAL(huge->base.size(), quarter * 5);
+  BOOST_CHECK(cache.get(3, MODEL_SBJ, sized(quarter * 5, 5.0f)) != huge);
+  BOOST_CHECK_EQUAL(cache.get(1, MODEL_SBJ, sized(big, 9.0f)), b2);
+  BOOST_CHECK_EQUAL(builds, 7);
+  BOOST_CHECK_EQUAL(cache.hits() + cache.misses(), 10);
+  BOOST_CHECK_EQUAL(cache.misses(), 7);
+
+  // Threads asking for the same verb at once may each build it, but all get the first one in
+  Cache shared (1);
+  int threads = 8;
+  vector<Cache::Entry> got (threads);
+  #pragma omp parallel for num_threads(threads)
+  for (int i = 0; i < threads; ++i) {
+    got[i] = shared.get(7, MODEL_SBJ, [&](VerbTensor< vector<float> > & t) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      t.base.assign(16, float(i));
+    });
+  }
+  for (int i = 0; i < threads; ++i) { BOOST_CHECK_EQUAL(got[i], got[0]); }
+  BOOST_CHECK_EQUAL(shared.get(7, MODEL_SBJ, sized(16, 9.0f)), got[0]);
+  BOOST_CHECK_EQUAL(shared.hits() + shared.misses(), threads + 1);
+}
+
+// Dense rows should pack and unpack unchanged, and the sparse kernels should agree with
+// working on the dense rows
+BOOST_AUTO_TEST_CASE(sparse_test) {
+  int basis = 40;
+  vector< vector<float> > rows;
+  for (int r = 0; r < 30; ++r) {
+    vector<float> row (basis, 0.0f);
+    for (int i = 0; i < basis; ++i) {
+      if ((r * 7 + i * 3) % 5 == 0) { row[i] = float((r + i) % 9) - 3.0f; }
+    }
+    rows.push_back(row);
+  }
+  rows.push_back(vector<float>(basis, 0.0f));
+
+  SparseVectors sparse;
+  sparse_from_dense(rows, basis, sparse);
+  BOOST_CHECK_EQUAL(sparse.rows(), rows.size());
+  BOOST_CHECK(sparse.nnz() < basis * rows.size() / 3);
+
+  vector<float> sum (basis, 0.0f), expected (basis, 0.0f);
+  vector<float> pair (basis, 0.0f), pair_expected (basis, 0.0f);
+  for (int r = 0; r < rows.size(); ++r) {
+    vector<float> back;
+    sparse_row_dense(sparse, r, back);
+    BOOST_CHECK(back == rows[r]);
+
+    sparse_axpy(sparse, r, 2.0f, &sum[0]);
+    for (int i = 0; i < basis; ++i) { expected[i] += 2.0f * rows[r][i]; }
+
+    int o = (r * 11) % rows.size();
+    sparse_axpy(sparse, r, o, 3.0f, &pair[0]);
+    for (int i = 0; i < basis; ++i) { pair_expected[i] += 3.0f * (rows[r][i] + rows[o][i]); }
+
+    for (int q = 0; q < rows.size() - 1; ++q) {
+      double dd = dense_dot(rows[r], rows[q]);
+      BOOST_CHECK_CLOSE(sparse_dot(sparse, r, sparse, q) + 1.0, dd + 1.0, 0.01);
+
+      float dist = 0;
+      for (int i = 0; i < basis; ++i) { dist += (rows[r][i] - rows[q][i]) * (rows[r][i] - rows[q][i]); }
+      BOOST_CHECK_EQUAL(sparse_dist2(sparse, r, sparse, q), dist);
+
+      if (r == rows.size() - 1) {
+        BOOST_CHECK_EQUAL(sparse_cosine_sim(sparse, r, sparse, q), 2.0f);
+        continue;
+      }
+
+      float dsim = dd / (sqrt(dense_dot(rows[r], rows[r])) * sqrt(dense_dot(rows[q], rows[q])));
+      dsim = std::max(-1.0f, std::min(1.0f, dsim));
+      BOOST_CHECK_CLOSE(sparse_cosine_sim(sparse, r, sparse, q), 1.0 - acos(dsim) / M_PI, 0.1);
+      BOOST_CHECK_CLOSE(sparse_cosine_sim(sparse, r, rows[q]), sparse_cosine_sim(sparse, r, sparse, q), 0.01);
+    }
+  }
+  BOOST_CHECK(sum == expected);
+  BOOST_CHECK(pair == pair_expected);
+}
+
+// Hits added to the sorted runs in small batches, in any order, should pack into the same
+// rows as counting them densely
+BOOST_AUTO_TEST_CASE(sparse_counts_test) {
+  int num_rows = 300;
+  int basis = 50;
+  vector< vector<float> > dense (num_rows, vector<float>(basis, 0.0f));
+  vector< vector<int> > batches (SPARSE_COUNT_SHARDS);
+
+  SparseCounts counts;
+  sparse_counts_init(counts, num_rows, basis);
+
+  unsigned int seed = 7;
+  for (int h = 0; h < 40000; ++h) {
+    seed = seed * 1103515245 + 12345;
+    int row = (seed >> 8) % num_rows;
+    // Skew the columns so some cells take many hits and most take none
+    int col = ((seed >> 20) % basis) * ((seed >> 16) % 3 == 0 ? 1 : 0);
+    if (row % 7 == 3) { continue; }
+    dense[row][col] += 1.0f;
+
+    vector<int> & batch = batches[row % SPARSE_COUNT_SHARDS];
+    batch.push_back(row);
+    batch.push_back(col);
+    if (batch.size() >= 2 * (5 + row % 40)) {
+      sparse_counts_add(counts, row % SPARSE_COUNT_SHARDS, batch);
+      batch.clear();
+    }
+  }
+  for (int s = 0; s < SPARSE_COUNT_SHARDS; ++s) {
+    sparse_counts_add(counts, s, batches[s]);
+  }
+
+  // Each shard keeps only a handful of runs, each smaller than the one below
+  for (const vector<SparseRun> & runs : counts.shards) {
+    BOOST_CHECK(runs.size() <= 12);
+    for (size_t k = 1; k < runs.size(); ++k) {
+      BOOST_CHECK(runs[k].keys.size() < runs[k-1].keys.size());
+    }
+  }
+
+  SparseVectors from_counts, from_dense;
+  sparse_from_counts(counts, from_counts);
+  sparse_from_dense(dense, basis, from_dense);
+  BOOST_CHECK_EQUAL(from_counts.rows(), num_rows);
+  BOOST_CHECK(from_counts.nnz() > 0);
+  BOOST_CHECK(from_counts.row_ptr == from_dense.row_ptr);
+  BOOST_CHECK(from_counts.col_idx == from_dense.col_idx);
+  BOOST_CHECK(from_counts.vals == from_dense.vals);
+}
+
+// Both encodings of the binary vector file should give back the rows we wrote
+BOOST_AUTO_TEST_CASE(vector_file_test) {
+  int basis = 24;
+  vector< vector<float> > sparse_rows, dense_rows;
+  for (int r = 0; r < 20; ++r) {
+    vector<float> srow (basis, 0.0f), drow (basis, 0.0f);
+    for (int i = 0; i < basis; ++i) {
+      if ((r + i) % 6 == 0) { srow[i] = float(r * basis + i); }
+      drow[i] = float((r * 5 + i) % 7);
+    }
+    sparse_rows.push_back(srow);
+    dense_rows.push_back(drow);
+  }
+
+  SparseVectors sparse;
+  sparse_from_dense(sparse_rows, basis, sparse);
+  BOOST_CHECK_EQUAL(vector_file_write("./test_sparse.wbv", sparse), 0);
+  BOOST_CHECK_EQUAL(vector_file_write("./test_dense.wbv", dense_rows, basis), 0);
+
+  VectorFile sf, df;
+  BOOST_CHECK_EQUAL(vector_file_open(sf, "./test_sparse.wbv"), 0);
+  BOOST_CHECK_EQUAL(vector_file_open(df, "./test_dense.wbv"), 0);
+  BOOST_CHECK_EQUAL(sf.header->sparse, 1);
+  BOOST_CHECK_EQUAL(df.header->sparse, 0);
+  BOOST_CHECK_EQUAL(sf.header->num_rows, 20);
+  BOOST_CHECK_EQUAL(sf.header->nnz, sparse.nnz());
+
+  for (int r = 19; r >= 0; --r) {
+    vector<float> row;
+    vector_file_row(sf, r, row);
+    BOOST_CHECK(row == sparse_rows[r]);
+    vector_file_row(df, r, row);
+    BOOST_CHECK(row == dense_rows[r]);
+  }
+}
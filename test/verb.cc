@@ -25,6 +25,12 @@
 
 using namespace std;
 
+// Two sets of sparse rows hold the same values in the same places
+
+static bool same_rows(const SparseVectors & a, const SparseVectors & b) {
+  return a.num_cols == b.num_cols && a.row_ptr == b.row_ptr && a.col_idx == b.col_idx && a.vals == b.vals;
+}
+
 // Now lets test to make sure we can read everything back in correctly and also that the numbers we
 // read in are correct
 // TODO - this test is too long and also, there are not any representitive sentences to make for a proper
@@ -35,7 +41,7 @@ BOOST_AUTO_TEST_CASE(verb_create_test) {
   map<string, size_t> FREQ {};
   vector< pair<string,size_t> > FREQ_FLIPPED {};
   set<string> WORD_IGNORES {",","-",".","@card@", "<text","<s>xt","</s>SENT", "<s>>SENT", "<s>", "</s>", "<text>", "</text>"};
-  map<string,int> DICTIONARY_FAST {};
+  Dictionary DICTIONARY_FAST;
   vector<string> DICTIONARY {};
   set<string> ALLOWED_BASIS_WORDS;
   set<string> INSIST_BASIS_WORDS;
@@ -103,6 +109,17 @@ BOOST_AUTO_TEST_CASE(verb_create_test) {
   int r7 = create_word_vectors(filenames, "./output", FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, BASIS_VECTOR, WORD_IGNORES, WORD_VECTORS, ALLOWED_BASIS_WORDS, VOCAB_SIZE, 250, 5, true);
   BOOST_CHECK_EQUAL(r7, 0);
 
+  // Counting into sparse rows must write exactly the same file
+  std::ifstream dense_file ("./output/word_vectors.txt");
+  string dense_text ((std::istreambuf_iterator<char>(dense_file)), std::istreambuf_iterator<char>());
+  vector< vector<float> > UNUSED_VECTORS;
+  int r7s = create_word_vectors(filenames, "./output", FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, BASIS_VECTOR, WORD_IGNORES, UNUSED_VECTORS, ALLOWED_BASIS_WORDS, VOCAB_SIZE, 250, 5, true, true);
+  BOOST_CHECK_EQUAL(r7s, 0);
+  BOOST_CHECK(UNUSED_VECTORS.empty());
+  std::ifstream sparse_file ("./output/word_vectors.txt");
+  string sparse_text ((std::istreambuf_iterator<char>(sparse_file)), std::istreambuf_iterator<char>());
+  BOOST_CHECK(dense_text == sparse_text);
+
   // Initialise our verb to subject/object maps
   for (int i = 0; i <= VOCAB_SIZE; ++i) {
     VERB_SUBJECTS.push_back( vector<int>() );
@@ -125,9 +142,144 @@ BOOST_AUTO_TEST_CASE(verb_create_test) {
   BOOST_CHECK_EQUAL(r9, 0);
 
   generate_words_to_check(WORDS_TO_CHECK, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, VERBS_TO_CHECK,DICTIONARY_FAST);
-	read_count("./output", FREQ, DICTIONARY, BASIS_VECTOR, WORD_VECTORS, TOTAL_COUNT, WORDS_TO_CHECK);
-  intrans_count("./output/intrans_results.txt", VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, 250, DICTIONARY_FAST, VERB_SUBJECTS, WORD_VECTORS);
+  SparseVectors CHECK_VECTORS;
+	read_count("./output", FREQ, DICTIONARY, BASIS_VECTOR, CHECK_VECTORS, TOTAL_COUNT, WORDS_TO_CHECK);
+  BOOST_CHECK_EQUAL(CHECK_VECTORS.num_cols, 250);
+
+  // Only the words we check have anything in their rows
+  for (size_t r = 0; r < CHECK_VECTORS.rows(); ++r) {
+    if (WORDS_TO_CHECK.find(r) == WORDS_TO_CHECK.end()) {
+      BOOST_CHECK_EQUAL(CHECK_VECTORS.row_ptr[r], CHECK_VECTORS.row_ptr[r+1]);
+    }
+  }
+
+  // Those came from the binary vectors; the text file must give the same rows
+  boost::filesystem::rename("./output/" VECTOR_FILE_NAME, "./output/word_vectors.wbv.hold");
+  SparseVectors TEXT_VECTORS;
+  read_count("./output", FREQ, DICTIONARY, BASIS_VECTOR, TEXT_VECTORS, TOTAL_COUNT, WORDS_TO_CHECK);
+  boost::filesystem::rename("./output/word_vectors.wbv.hold", "./output/" VECTOR_FILE_NAME);
+  BOOST_CHECK(same_rows(TEXT_VECTORS, CHECK_VECTORS));
+
+  // Counting only the rows we check must give those rows exactly
+  vector< vector<float> > TARGET_COUNTS;
+  int r7t = create_word_vectors(filenames, "./output", FREQ, FREQ_FLIPPED, DICTIONARY_FAST, DICTIONARY, BASIS_VECTOR, WORD_IGNORES, TARGET_COUNTS, ALLOWED_BASIS_WORDS, VOCAB_SIZE, 250, 5, true, false, &WORDS_TO_CHECK);
+  BOOST_CHECK_EQUAL(r7t, 0);
+  SparseVectors TARGET_VECTORS;
+  read_count("./output", FREQ, DICTIONARY, BASIS_VECTOR, TARGET_VECTORS, TOTAL_COUNT, WORDS_TO_CHECK);
+  BOOST_CHECK(same_rows(TARGET_VECTORS, CHECK_VECTORS));
+  intrans_count("./output/intrans_results.txt", VERBS_TO_CHECK, VERB_TRANSITIVE, VERB_INTRANSITIVE, 250, DICTIONARY_FAST, VERB_SUBJECTS, CHECK_VECTORS);
 
   // Trans
   
 }
+
+// Repeated subjects and (subject, object) pairs should fold into one entry with a count
+BOOST_AUTO_TEST_CASE(verb_collapse_test) {
+  int sbj[] = {5,1, 3,1, 5,1, 5,2};
+  vector<int> subjects (sbj, sbj + 8);
+  collapse_counts(subjects, 2, false);
+
+  BOOST_CHECK_EQUAL(subjects.size(), 4);
+  BOOST_CHECK_EQUAL(subjects[0], 3);
+  BOOST_CHECK_EQUAL(subjects[1], 1);
+  BOOST_CHECK_EQUAL(subjects[2], 5);
+  BOOST_CHECK_EQUAL(subjects[3], 4);
+
+  int so[] = {7,2,1, 7,3,1, 7,2,1, 2,7,1};
+  vector<int> sbj_obj (so, so + 12);
+  collapse_counts(sbj_obj, 3, false);
+
+  BOOST_CHECK_EQUAL(sbj_obj.size(), 9);
+  BOOST_CHECK_EQUAL(sbj_obj[0], 2);
+  BOOST_CHECK_EQUAL(sbj_obj[1], 7);
+  BOOST_CHECK_EQUAL(sbj_obj[2], 1);
+  BOOST_CHECK_EQUAL(sbj_obj[3], 7);
+  BOOST_CHECK_EQUAL(sbj_obj[4], 2);
+  BOOST_CHECK_EQUAL(sbj_obj[5], 2);
+
+  collapse_counts(sbj_obj, 3, true);
+  BOOST_CHECK_EQUAL(sbj_obj[5], 1);
+}
+
+BOOST_AUTO_TEST_CASE(verb_list_header_test) {
+
+  // Verb lists carry a header so files from before the counts were added are refused
+  string dir = "./output/verb_lists";
+  boost::filesystem::create_directories(dir);
+
+  vector< vector<int> > sbj_obj (4), subjects (4), objects (4);
+  subjects[1] = {2, 5, 3, 1};
+  objects[2] = {0, 2};
+  sbj_obj[1] = {2, 0, 4};
+  BOOST_REQUIRE(write_verb_subject_object(dir, sbj_obj, subjects, objects) == 0);
+
+  vector< vector<int> > read_subjects (4), read_sbj_obj (4);
+  BOOST_CHECK_EQUAL(read_subject_file(dir, read_subjects), 0);
+  BOOST_CHECK(read_subjects[1] == subjects[1]);
+  BOOST_CHECK_EQUAL(read_subject_object_file(dir, read_sbj_obj), 0);
+  BOOST_CHECK(read_sbj_obj[1] == sbj_obj[1]);
+
+  // An old file where every verb has an even number of subjects passes the stride check
+  std::ofstream legacy (dir + "/verb_subjects.txt");
+  legacy << "1 2 3 \n2 0 1 \n";
+  legacy.close();
+  vector< vector<int> > legacy_subjects (4);
+  BOOST_CHECK_EQUAL(read_subject_file(dir, legacy_subjects), 1);
+
+  // Nor will a subject list pass for a subject object one
+  boost::filesystem::copy_file(dir + "/verb_objects.txt", dir + "/verb_sbj_obj.txt", boost::filesystem::copy_option::overwrite_if_exists);
+  BOOST_CHECK_EQUAL(read_subject_object_file(dir, read_sbj_obj), 1);
+}
+
+// Walking up the heads should find the direct verb, and a sentence whose heads loop must not hang
+BOOST_AUTO_TEST_CASE(verb_heads_test) {
+  Dictionary DICTIONARY_FAST;
+  DICTIONARY_FAST.insert("dog");
+  DICTIONARY_FAST.insert("chase");
+  DICTIONARY_FAST.insert("cat");
+  vector< vector<int> > VERB_SBJ_OBJ (3), VERB_SUBJECTS (3), VERB_OBJECTS (3);
+
+  string path = "./output/heads_test";
+  std::ofstream text (path);
+  text << "<text id=\"heads\">\n"
+    "<s>\n"
+    "The\tthe\tDT\t1\t2\tNMOD\n"
+    "dog\tdog\tNN\t2\t3\tSBJ\n"
+    "chased\tchase\tVVD\t3\t0\tROOT\n"
+    "the\tthe\tDT\t4\t6\tNMOD\n"
+    "big\tbig\tJJ\t5\t6\tNMOD\n"
+    "cat\tcat\tNN\t6\t3\tOBJ\n"
+    "</s>\n"
+    "<s>\n"
+    "dog\tdog\tNN\t1\t2\tSBJ\n"
+    "ran\trun\tRB\t2\t3\tNMOD\n"
+    "off\toff\tRB\t3\t2\tNMOD\n"
+    "</s>\n"
+    "</text>\n";
+  text.close();
+
+  CorpusData data;
+  BOOST_REQUIRE_EQUAL(corpus_parse_text(path, data), 0);
+  Corpus corpus;
+  corpus_view(data, corpus);
+  BOOST_REQUIRE_EQUAL(corpus.header->num_sentences, 2);
+
+  HeadIndex heads;
+  heads.build(corpus.id + corpus.sentences[0], corpus.sentences[1] - corpus.sentences[0]);
+  BOOST_CHECK(heads.unique());
+  BOOST_CHECK_EQUAL(heads.find(3), 2);
+  BOOST_CHECK_EQUAL(heads.find(9), -1);
+
+  // The looped sentence adds nothing, so chase has the one subject and object
+  DependencyExtractor extractor (DICTIONARY_FAST, VERB_SBJ_OBJ, VERB_SUBJECTS, VERB_OBJECTS, false, false, true);
+  BOOST_REQUIRE_EQUAL(extractor.begin_file(corpus, path), 0);
+  for (uint64_t s = 0; s < corpus.header->num_sentences; ++s) {
+    extractor.sentence(corpus, corpus.sentences[s], corpus.sentences[s+1], 0, 0);
+  }
+  BOOST_REQUIRE_EQUAL(extractor.end_file(corpus), 0);
+
+  BOOST_CHECK(VERB_SUBJECTS[1] == vector<int>({0, 1}));
+  BOOST_CHECK(VERB_OBJECTS[1] == vector<int>({2, 1}));
+  BOOST_CHECK(VERB_SBJ_OBJ[1] == vector<int>({0, 2, 1}));
+  BOOST_CHECK(VERB_SUBJECTS[0].empty() && VERB_SUBJECTS[2].empty());
+}